@@ -4,6 +4,7 @@ QT += network
 QT += websockets
 QT += multimedia
 QT += widgets
+QT += concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -14,42 +15,83 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    binarydelta.cpp \
     button.cpp \
     cameratab.cpp \
+    chunkcache.cpp \
+    chunkheader.cpp \
+    chunkreader.cpp \
     clientlistdialog.cpp \
     connection.cpp \
+    crc32c.cpp \
     directorytab.cpp \
     edit.cpp \
+    filehandlecache.cpp \
     fileserver.cpp \
     generalsetuparguments.cpp \
     generalsetupdialog.cpp \
+    hashindexer.cpp \
+    httpmediaserver.cpp \
+    httprange.cpp \
     main.cpp \
+    manifestframe.cpp \
+    mappedfilecache.cpp \
+    mediacatalog.cpp \
+    mediaserver.cpp \
+    multicastsender.cpp \
     netServer.cpp \
     panelconfigurator.cpp \
     paneltab.cpp \
     scorecontroller.cpp \
+    slidebundler.cpp \
+    slidepreprocessor.cpp \
+    tokenbucket.cpp \
+    transferslots.cpp \
+    updatedeltabuilder.cpp \
     utility.cpp \
     volleycontroller.cpp \
-    volleytab.cpp
+    volleytab.cpp \
+    xxhash64.cpp
 
 HEADERS += \
+    binarydelta.h \
     button.h \
     cameratab.h \
+    chunkcache.h \
+    chunkheader.h \
+    chunkreader.h \
     clientlistdialog.h \
     connection.h \
+    crc32c.h \
     directorytab.h \
     edit.h \
+    filehandlecache.h \
     fileserver.h \
     generalsetuparguments.h \
     generalsetupdialog.h \
+    hashindexer.h \
+    httpmediaserver.h \
+    httprange.h \
+    manifestframe.h \
+    mappedfilecache.h \
+    mediacatalog.h \
+    mediaserver.h \
+    multicastsender.h \
     netServer.h \
     panelconfigurator.h \
     paneldirection.h \
     paneltab.h \
     scorecontroller.h \
+    slidebundler.h \
+    slidepreprocessor.h \
+    tokenbucket.h \
+    transferslots.h \
+    updatedeltabuilder.h \
     utility.h \
+    varint.h \
     volleycontroller.h \
-    volleytab.h
+    volleytab.h \
+    xxhash64.h
 
 TRANSLATIONS += \
     VolleyController_en_US.ts
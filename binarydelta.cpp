@@ -0,0 +1,241 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#include "binarydelta.h"
+#include "varint.h"
+#include "xxhash64.h"
+
+#include <QVector>
+#include <QtEndian>
+#include <cstring>
+#include <climits>
+
+
+// The base is indexed by blocks of this size: the shorter matches are not found
+#define DELTA_BLOCK_SIZE        64
+// Blocks of the base kept for each bucket of the index
+#define DELTA_MAX_PROBES        4
+// zlib level: a delta is built once and sent to many panels
+#define DELTA_COMPRESSION_LEVEL 9
+
+
+// Rolling checksum of a block (as in rsync): it can be moved
+// one byte forward without reading the whole block again
+struct RollingSum {
+    quint32 a;
+    quint32 b;
+};
+
+
+static RollingSum
+blockSum(const uchar* pData) {
+    RollingSum sum = { 0, 0 };
+    for(int i=0; i<DELTA_BLOCK_SIZE; i++) {
+        sum.a += pData[i];
+        sum.b += quint32(DELTA_BLOCK_SIZE-i) * pData[i];
+    }
+    return sum;
+}
+
+
+static void
+rollSum(RollingSum* pSum, uchar out, uchar in) {
+    pSum->a += quint32(in) - quint32(out);
+    pSum->b += pSum->a - quint32(DELTA_BLOCK_SIZE) * out;
+}
+
+
+static quint32
+sumBucket(const RollingSum& sum, quint32 mask) {
+    quint32 h = (sum.a & 0xFFFF) | (sum.b << 16);
+    h ^= h >> 15;
+    h *= 0x2C1B3C6D;
+    h ^= h >> 12;
+    return h & mask;
+}
+
+
+static void
+appendAdd(QByteArray* pInstructions, const uchar* pData, qint64 length) {
+    if(length <= 0)
+        return;
+    pInstructions->append(char(BINARY_DELTA_ADD));
+    appendVarint(pInstructions, quint64(length));
+    pInstructions->append(reinterpret_cast<const char*>(pData), int(length));
+}
+
+
+static void
+appendCopy(QByteArray* pInstructions, qint64 offset, qint64 length) {
+    pInstructions->append(char(BINARY_DELTA_COPY));
+    appendVarint(pInstructions, quint64(offset));
+    appendVarint(pInstructions, quint64(length));
+}
+
+
+/*!
+ * \brief encodeBinaryDelta
+ * The blocks of the base are indexed by their rolling checksum; the
+ * checksum is then moved along the target one byte at a time and every
+ * block found in the base is extended in both directions as far as
+ * the two files agree.
+ * \param base The file the panel already has
+ * \param target The file the panel needs
+ * \return The delta (see binarydelta.h)
+ */
+QByteArray
+encodeBinaryDelta(const QByteArray& base, const QByteArray& target) {
+    auto* pBase   = reinterpret_cast<const uchar*>(base.constData());
+    auto* pTarget = reinterpret_cast<const uchar*>(target.constData());
+    const qint64 baseSize   = base.size();
+    const qint64 targetSize = target.size();
+
+    // Index of the base blocks (block number + 1, 0 = empty slot)
+    qint64 nBlocks = baseSize / DELTA_BLOCK_SIZE;
+    int tableSize = 1024;
+    while(tableSize < 2*nBlocks)
+        tableSize *= 2;
+    const quint32 mask = quint32(tableSize-1);
+    QVector<qint32> table(tableSize, 0);
+    for(qint64 block=0; block<nBlocks; block++) {
+        quint32 bucket = sumBucket(blockSum(pBase+block*DELTA_BLOCK_SIZE), mask);
+        for(int probe=0; probe<DELTA_MAX_PROBES; probe++) {
+            qint32& slot = table[int((bucket+quint32(probe)) & mask)];
+            if(slot == 0) {
+                slot = qint32(block+1);
+                break;
+            }
+        }
+    }
+
+    QByteArray instructions;
+    qint64 literalStart = 0;
+    qint64 pos = 0;
+    RollingSum sum = { 0, 0 };
+    if((nBlocks > 0) && (targetSize >= DELTA_BLOCK_SIZE))
+        sum = blockSum(pTarget);
+    while((nBlocks > 0) && (pos+DELTA_BLOCK_SIZE <= targetSize)) {
+        qint64 matchOffset = -1;
+        quint32 bucket = sumBucket(sum, mask);
+        for(int probe=0; probe<DELTA_MAX_PROBES; probe++) {
+            qint32 slot = table.at(int((bucket+quint32(probe)) & mask));
+            if(slot == 0)
+                break;
+            qint64 offset = qint64(slot-1) * DELTA_BLOCK_SIZE;
+            if(memcmp(pBase+offset, pTarget+pos, DELTA_BLOCK_SIZE) == 0) {
+                matchOffset = offset;
+                break;
+            }
+        }
+        if(matchOffset < 0) {
+            if(pos+DELTA_BLOCK_SIZE < targetSize)
+                rollSum(&sum, pTarget[pos], pTarget[pos+DELTA_BLOCK_SIZE]);
+            pos++;
+            continue;
+        }
+        // Extend the match backward over the pending literals...
+        qint64 targetStart = pos;
+        qint64 baseStart   = matchOffset;
+        while((targetStart > literalStart) && (baseStart > 0) &&
+              (pBase[baseStart-1] == pTarget[targetStart-1]))
+        {
+            targetStart--;
+            baseStart--;
+        }
+        // ...and forward
+        qint64 length = pos - targetStart + DELTA_BLOCK_SIZE;
+        while((baseStart+length < baseSize) && (targetStart+length < targetSize) &&
+              (pBase[baseStart+length] == pTarget[targetStart+length]))
+            length++;
+        appendAdd(&instructions, pTarget+literalStart, targetStart-literalStart);
+        appendCopy(&instructions, baseStart, length);
+        pos = targetStart + length;
+        literalStart = pos;
+        if(pos+DELTA_BLOCK_SIZE <= targetSize)
+            sum = blockSum(pTarget+pos);
+    }
+    appendAdd(&instructions, pTarget+literalStart, targetSize-literalStart);
+
+    QByteArray delta(BINARY_DELTA_HEADER_SIZE, Qt::Uninitialized);
+    auto* pData = reinterpret_cast<uchar*>(delta.data());
+    qToBigEndian(quint32(BINARY_DELTA_MAGIC),                   pData);
+    qToBigEndian(quint64(baseSize),                             pData+4);
+    qToBigEndian(XxHash64::hash(pBase, baseSize),               pData+12);
+    qToBigEndian(quint64(targetSize),                           pData+20);
+    qToBigEndian(XxHash64::hash(pTarget, targetSize),           pData+28);
+    delta.append(qCompress(instructions, DELTA_COMPRESSION_LEVEL));
+    return delta;
+}
+
+
+/*!
+ * \brief applyBinaryDelta
+ * \param base The file the delta was computed from
+ * \param delta The delta (see binarydelta.h)
+ * \param pTarget Where to store the rebuilt file
+ * \return false if the delta is corrupted or was not computed
+ * from this base, or if the rebuilt file is not the expected one
+ */
+bool
+applyBinaryDelta(const QByteArray& base, const QByteArray& delta, QByteArray* pTarget) {
+    if(delta.size() < BINARY_DELTA_HEADER_SIZE)
+        return false;
+    auto* pData = reinterpret_cast<const uchar*>(delta.constData());
+    if(qFromBigEndian<quint32>(pData) != BINARY_DELTA_MAGIC)
+        return false;
+    if((qFromBigEndian<quint64>(pData+4) != quint64(base.size())) ||
+       (qFromBigEndian<quint64>(pData+12) != XxHash64::hash(base.constData(), base.size())))
+        return false;
+    quint64 targetSize = qFromBigEndian<quint64>(pData+20);
+    quint64 targetHash = qFromBigEndian<quint64>(pData+28);
+    if(targetSize > quint64(INT_MAX))
+        return false;
+    QByteArray instructions = qUncompress(delta.mid(BINARY_DELTA_HEADER_SIZE));
+    if(instructions.isEmpty() && (targetSize > 0))
+        return false;
+
+    pTarget->clear();
+    pTarget->reserve(int(targetSize));
+    int pos = 0;
+    while(pos < instructions.size()) {
+        quint8 op = quint8(instructions.at(pos++));
+        quint64 offset = 0, length = 0;
+        if(op == BINARY_DELTA_COPY) {
+            if(!readVarint(instructions, &pos, &offset) || !readVarint(instructions, &pos, &length))
+                return false;
+            if((offset > quint64(base.size())) || (length > quint64(base.size())-offset))
+                return false;
+            pTarget->append(base.constData()+offset, int(length));
+        }
+        else if(op == BINARY_DELTA_ADD) {
+            if(!readVarint(instructions, &pos, &length) ||
+               (length > quint64(instructions.size()-pos)))
+                return false;
+            pTarget->append(instructions.constData()+pos, int(length));
+            pos += int(length);
+        }
+        else {
+            return false;
+        }
+        if(quint64(pTarget->size()) > targetSize)
+            return false;
+    }
+    return (quint64(pTarget->size()) == targetSize) &&
+           (XxHash64::hash(pTarget->constData(), pTarget->size()) == targetHash);
+}
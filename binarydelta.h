@@ -0,0 +1,51 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef BINARYDELTA_H
+#define BINARYDELTA_H
+
+#include <QByteArray>
+
+// A binary delta rebuilds a target file from a base file: the parts
+// of the target found in the base are copied, the rest is carried
+// by the delta. The fixed size fields are stored in network
+// (big endian) order:
+//
+//  0  quint32 magic ('V','C','D','1')
+//  4  quint64 size of the base
+// 12  quint64 xxHash64 of the base
+// 20  quint64 size of the target
+// 28  quint64 xxHash64 of the target
+// 36  the instructions compressed with qCompress()
+//
+// Instructions (varints as in varint.h):
+//     BINARY_DELTA_COPY  varint offset in the base, varint length
+//     BINARY_DELTA_ADD   varint length, the bytes to append
+#define BINARY_DELTA_MAGIC          0x56434431
+#define BINARY_DELTA_HEADER_SIZE    36
+
+// Instructions
+#define BINARY_DELTA_COPY           0x01
+#define BINARY_DELTA_ADD            0x02
+
+
+QByteArray encodeBinaryDelta(const QByteArray& base, const QByteArray& target);
+bool       applyBinaryDelta(const QByteArray& base, const QByteArray& delta, QByteArray* pTarget);
+
+#endif // BINARYDELTA_H
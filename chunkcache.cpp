@@ -0,0 +1,151 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#include "chunkcache.h"
+
+#include <QMutexLocker>
+#include <climits>
+
+
+/*!
+ * \brief ChunkCache::ChunkCache
+ * A bounded in-memory cache of the file chunks served to the panels.
+ * When many panels ask for the same byte range at nearly the same time
+ * only the first request reads the disk: the concurrent requests for a
+ * chunk that is already being read wait for that read to complete.
+ * \param maxBytes The maximum amount of memory used by the cached chunks
+ * (0 disables the cache)
+ */
+ChunkCache::ChunkCache(qint64 maxBytes)
+    : nHits(0)
+    , nMisses(0)
+    , nMerged(0)
+{
+    setMaxSize(maxBytes);
+}
+
+
+/*!
+ * \brief ChunkCache::setMaxSize
+ * \param maxBytes The maximum amount of memory used by the cached chunks
+ */
+void
+ChunkCache::setMaxSize(qint64 maxBytes) {
+    QMutexLocker locker(&mutex);
+    // QCache costs are int
+    cache.setMaxCost(int(qBound(qint64(0), maxBytes, qint64(INT_MAX))));
+}
+
+
+qint64
+ChunkCache::maxSize() const {
+    QMutexLocker locker(&mutex);
+    return cache.maxCost();
+}
+
+
+/*!
+ * \brief ChunkCache::chunk
+ * \param key The chunk identifier (file, offset, length, modification time)
+ * \param loader Invoked, without holding any lock, to read the chunk on a miss
+ * \return The chunk data (empty on read errors)
+ */
+QByteArray
+ChunkCache::chunk(const ChunkKey& key, const std::function<QByteArray()>& loader) {
+    QMutexLocker locker(&mutex);
+    if(cache.maxCost() == 0) {
+        nMisses++;
+        locker.unlock();
+        return loader();
+    }
+    forever {
+        QByteArray* pData = cache.object(key);
+        if(pData) {
+            nHits++;
+            return *pData;
+        }
+        if(!inFlight.contains(key))
+            break;
+        // Someone else is reading the very same chunk: wait for it
+        nMerged++;
+        chunkLoaded.wait(&mutex);
+    }
+    nMisses++;
+    inFlight.insert(key);
+    locker.unlock();
+
+    QByteArray data = loader();
+
+    locker.relock();
+    inFlight.remove(key);
+    if(!data.isEmpty() && (data.size() <= cache.maxCost()))
+        cache.insert(key, new QByteArray(data), data.size());
+    chunkLoaded.wakeAll();
+    return data;
+}
+
+
+/*!
+ * \brief ChunkCache::invalidate Remove all the chunks of a file
+ * \param sFilePath The full path of the file
+ */
+void
+ChunkCache::invalidate(const QString& sFilePath) {
+    QMutexLocker locker(&mutex);
+    const QList<ChunkKey> keys = cache.keys();
+    for(const ChunkKey& key : keys) {
+        if(key.sFilePath == sFilePath)
+            cache.remove(key);
+    }
+}
+
+
+void
+ChunkCache::clear() {
+    QMutexLocker locker(&mutex);
+    cache.clear();
+}
+
+
+quint64
+ChunkCache::hits() const {
+    QMutexLocker locker(&mutex);
+    return nHits;
+}
+
+
+quint64
+ChunkCache::misses() const {
+    QMutexLocker locker(&mutex);
+    return nMisses;
+}
+
+
+quint64
+ChunkCache::merged() const {
+    QMutexLocker locker(&mutex);
+    return nMerged;
+}
+
+
+qint64
+ChunkCache::size() const {
+    QMutexLocker locker(&mutex);
+    return cache.totalCost();
+}
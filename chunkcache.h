@@ -0,0 +1,85 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef CHUNKCACHE_H
+#define CHUNKCACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QCache>
+#include <QSet>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QHash>
+#include <functional>
+
+
+struct ChunkKey {
+    QString sFilePath;
+    qint64  startPos;
+    qint64  length;
+    qint64  lastModified; // msecs since epoch
+};
+
+
+inline bool
+operator==(const ChunkKey& a, const ChunkKey& b) {
+    return (a.startPos     == b.startPos)     &&
+           (a.length       == b.length)       &&
+           (a.lastModified == b.lastModified) &&
+           (a.sFilePath    == b.sFilePath);
+}
+
+
+inline uint
+qHash(const ChunkKey& key, uint seed = 0) {
+    return qHash(key.sFilePath, seed) ^
+           qHash(key.startPos, seed)  ^
+           qHash(key.length << 1, seed) ^
+           qHash(key.lastModified, seed);
+}
+
+
+class ChunkCache
+{
+public:
+    explicit ChunkCache(qint64 maxBytes = 64*1024*1024);
+
+    void       setMaxSize(qint64 maxBytes);
+    qint64     maxSize() const;
+    QByteArray chunk(const ChunkKey& key, const std::function<QByteArray()>& loader);
+    void       invalidate(const QString& sFilePath);
+    void       clear();
+
+    quint64    hits() const;
+    quint64    misses() const;
+    quint64    merged() const;
+    qint64     size() const;
+
+private:
+    mutable QMutex               mutex;
+    QWaitCondition               chunkLoaded;
+    QCache<ChunkKey, QByteArray> cache;
+    QSet<ChunkKey>               inFlight;
+    quint64                      nHits;
+    quint64                      nMisses;
+    quint64                      nMerged;
+};
+
+#endif // CHUNKCACHE_H
@@ -0,0 +1,139 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#include "chunkheader.h"
+#include "crc32c.h"
+#include "xxhash64.h"
+
+#include <QtEndian>
+#include <cstring>
+
+
+/*!
+ * \brief encodeChunkHeader
+ * \param header The header fields
+ * \return The CHUNK_HEADER_SIZE bytes of the encoded header
+ */
+QByteArray
+encodeChunkHeader(const ChunkHeader& header) {
+    QByteArray ba(CHUNK_HEADER_SIZE, Qt::Uninitialized);
+    auto* pData = reinterpret_cast<uchar*>(ba.data());
+    qToBigEndian(quint16(CHUNK_HEADER_MAGIC), pData);
+    pData[2] = quint8(CHUNK_HEADER_VERSION);
+    pData[3] = header.flags;
+    qToBigEndian(header.requestId, pData+4);
+    qToBigEndian(header.offset,    pData+8);
+    qToBigEndian(header.length,    pData+16);
+    qToBigEndian(header.fileSize,  pData+20);
+    return ba;
+}
+
+
+/*!
+ * \brief decodeChunkHeader
+ * \param frame A binary frame starting with a chunk header
+ * \param pHeader Where to store the decoded fields
+ * \return false if the frame does not start with a valid header
+ */
+bool
+decodeChunkHeader(const QByteArray& frame, ChunkHeader* pHeader) {
+    if(frame.size() < CHUNK_HEADER_SIZE)
+        return false;
+    auto* pData = reinterpret_cast<const uchar*>(frame.constData());
+    if(qFromBigEndian<quint16>(pData) != CHUNK_HEADER_MAGIC)
+        return false;
+    if(pData[2] != CHUNK_HEADER_VERSION)
+        return false;
+    pHeader->flags     = pData[3];
+    pHeader->requestId = qFromBigEndian<quint32>(pData+4);
+    pHeader->offset    = qFromBigEndian<quint64>(pData+8);
+    pHeader->length    = qFromBigEndian<quint32>(pData+16);
+    pHeader->fileSize  = qFromBigEndian<quint64>(pData+20);
+    return frame.size() >= CHUNK_HEADER_SIZE+int(pHeader->length);
+}
+
+
+/*!
+ * \brief encodeChunkFrameV2
+ * Build the whole binary frame (version 2 header and payload)
+ * with a single allocation
+ * \param header The header fields (the length is the payload size)
+ * \param payload The chunk data
+ * \return The frame to send
+ */
+QByteArray
+encodeChunkFrameV2(const ChunkHeader& header, const QByteArray& payload) {
+    QByteArray frame(CHUNK_HEADER_V2_SIZE+payload.size(), Qt::Uninitialized);
+    auto* pData = reinterpret_cast<uchar*>(frame.data());
+    qToBigEndian(quint16(CHUNK_HEADER_MAGIC), pData);
+    pData[2] = quint8(CHUNK_HEADER_V2_VERSION);
+    pData[3] = header.flags;
+    qToBigEndian(header.requestId,         pData+4);
+    qToBigEndian(header.fileId,            pData+8);
+    qToBigEndian(quint32(payload.size()),  pData+12);
+    qToBigEndian(header.offset,            pData+16);
+    qToBigEndian(header.fileSize,          pData+24);
+    memcpy(pData+CHUNK_HEADER_V2_SIZE, payload.constData(), size_t(payload.size()));
+    quint32 crc = crc32c(pData, 32);
+    crc = crc32c(payload.constData(), payload.size(), crc);
+    qToBigEndian(crc, pData+32);
+    return frame;
+}
+
+
+/*!
+ * \brief decodeChunkFrameV2
+ * \param frame A binary frame starting with a version 2 chunk header
+ * \param pHeader Where to store the decoded fields
+ * \return false if the header is not valid or the frame is
+ * truncated or corrupted
+ */
+bool
+decodeChunkFrameV2(const QByteArray& frame, ChunkHeader* pHeader) {
+    if(frame.size() < CHUNK_HEADER_V2_SIZE)
+        return false;
+    auto* pData = reinterpret_cast<const uchar*>(frame.constData());
+    if(qFromBigEndian<quint16>(pData) != CHUNK_HEADER_MAGIC)
+        return false;
+    if(pData[2] != CHUNK_HEADER_V2_VERSION)
+        return false;
+    pHeader->flags     = pData[3];
+    pHeader->requestId = qFromBigEndian<quint32>(pData+4);
+    pHeader->fileId    = qFromBigEndian<quint32>(pData+8);
+    pHeader->length    = qFromBigEndian<quint32>(pData+12);
+    pHeader->offset    = qFromBigEndian<quint64>(pData+16);
+    pHeader->fileSize  = qFromBigEndian<quint64>(pData+24);
+    if(quint64(frame.size()) != quint64(CHUNK_HEADER_V2_SIZE)+pHeader->length)
+        return false;
+    quint32 crc = crc32c(pData, 32);
+    crc = crc32c(pData+CHUNK_HEADER_V2_SIZE, pHeader->length, crc);
+    return crc == qFromBigEndian<quint32>(pData+32);
+}
+
+
+/*!
+ * \brief chunkFileId
+ * \param sFileName The file name
+ * \return The file ID of the version 2 chunk headers
+ */
+quint32
+chunkFileId(const QString& sFileName) {
+    QByteArray name = sFileName.toUtf8();
+    return quint32(XxHash64::hash(name.constData(), name.size()));
+}
@@ -0,0 +1,79 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef CHUNKHEADER_H
+#define CHUNKHEADER_H
+
+#include <QByteArray>
+#include <QString>
+
+// Compact header prepended to the binary replies of the
+// <get>fileName,startPos,length,requestId</get> requests.
+// All the fields are stored in network (big endian) order:
+//
+//  0  quint16 magic ('V','C')
+//  2  quint8  version
+//  3  quint8  flags
+//  4  quint32 request ID
+//  8  quint64 offset of the chunk in the file
+// 16  quint32 length of the chunk payload
+// 20  quint64 total size of the file
+#define CHUNK_HEADER_MAGIC      0x5643
+#define CHUNK_HEADER_VERSION    1
+#define CHUNK_HEADER_SIZE       28
+
+// Version 2 of the header, sent with every chunk to the clients
+// that asked for it with <framing>2</framing>:
+//
+//  0  quint16 magic ('V','C')
+//  2  quint8  version (2)
+//  3  quint8  flags
+//  4  quint32 request ID (0 for the untagged and streamed chunks)
+//  8  quint32 file ID (the low 32 bits of the xxHash64 of the UTF-8 file name)
+// 12  quint32 length of the chunk payload
+// 16  quint64 offset of the chunk in the file
+// 24  quint64 total size of the file
+// 32  quint32 CRC-32C of the bytes 0-31 followed by the payload
+#define CHUNK_HEADER_V2_VERSION 2
+#define CHUNK_HEADER_V2_SIZE    36
+
+// Header flags
+#define CHUNK_FLAG_LAST         0x01 // The chunk contains the last byte of the file
+// Multicast datagrams only (see MulticastSender)
+#define CHUNK_FLAG_ANNOUNCE     0x02 // The payload is the UTF-8 file name, the offset its modification time
+#define CHUNK_FLAG_PASS_END     0x04 // A transmission pass of the file is over (no payload)
+
+
+struct ChunkHeader {
+    quint8  flags;
+    quint32 requestId;
+    quint64 offset;
+    quint32 length;
+    quint64 fileSize;
+    quint32 fileId; // Version 2 only
+};
+
+
+QByteArray encodeChunkHeader(const ChunkHeader& header);
+bool       decodeChunkHeader(const QByteArray& frame, ChunkHeader* pHeader);
+QByteArray encodeChunkFrameV2(const ChunkHeader& header, const QByteArray& payload);
+bool       decodeChunkFrameV2(const QByteArray& frame, ChunkHeader* pHeader);
+quint32    chunkFileId(const QString& sFileName);
+
+#endif // CHUNKHEADER_H
@@ -0,0 +1,70 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#include "chunkreader.h"
+#include "fileserver.h"
+
+
+/*!
+ * \brief ChunkReader::ChunkReader
+ * Reads a chunk in one of the FileServer reader threads and posts
+ * the result back to the FileServer thread.
+ * \param pFileServer The server that will send the chunk
+ * \param chunkRequest The chunk to read
+ */
+ChunkReader::ChunkReader(FileServer* pFileServer, const ChunkRequest& chunkRequest)
+    : pServer(pFileServer)
+    , request(chunkRequest)
+{
+    setAutoDelete(true);
+}
+
+
+void
+ChunkReader::run() {
+    // A closing server drops its queued reads: the pool may be shared
+    // with other servers, so they are not removed from it
+    if(!pServer->bClosing)
+        read();
+    pServer->readerDone(); // The server may be gone after this
+}
+
+
+void
+ChunkReader::read() {
+    request.data = pServer->readChunk(request.sFilePath,
+                                      request.lastModified,
+                                      request.startPos,
+                                      request.length);
+    if(request.bPrefetch) {
+        // The chunk is now in the cache: get the kernel
+        // reading the next one from the disk
+        pServer->adviseWillNeed(request.sFilePath,
+                                request.startPos+request.length,
+                                request.length);
+        return;
+    }
+    FileServer*  pFileServer = pServer;
+    ChunkRequest readRequest = request;
+    QMetaObject::invokeMethod(pFileServer,
+                              [pFileServer, readRequest]() {
+                                  pFileServer->onChunkRead(readRequest);
+                              },
+                              Qt::QueuedConnection);
+}
@@ -0,0 +1,64 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef CHUNKREADER_H
+#define CHUNKREADER_H
+
+#include <QRunnable>
+#include <QPointer>
+#include <QWebSocket>
+#include <QByteArray>
+
+QT_FORWARD_DECLARE_CLASS(FileServer)
+
+
+// A chunk read to be done out of the socket thread
+struct ChunkRequest {
+    QPointer<QWebSocket> pClient;
+    QString              sFileName;
+    QString              sFilePath;
+    qint64               fileSize;
+    qint64               lastModified; // msecs since epoch
+    qint64               startPos;
+    qint64               length;
+    quint32              requestId;
+    bool                 bTagged;  // <get> with a request ID
+    bool                 bStream;  // Chunk of a <stream>
+    int                  playRank; // Position in the play order (0 = needed first)
+    bool                 bPrefetch; // Read ahead into the chunk cache (nothing to send)
+    bool                 bMulticast; // A block for the MulticastSender
+    QByteArray           data;     // Filled by the reader (empty on errors)
+};
+
+
+class ChunkReader : public QRunnable
+{
+public:
+    ChunkReader(FileServer* pFileServer, const ChunkRequest& chunkRequest);
+    void run() override;
+
+private:
+    void read();
+
+private:
+    FileServer*  pServer;
+    ChunkRequest request;
+};
+
+#endif // CHUNKREADER_H
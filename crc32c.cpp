@@ -0,0 +1,103 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+
+#include "crc32c.h"
+
+#include <cstring>
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+
+#define CRC32C_POLY 0x82F63B78 // Reversed Castagnoli polynomial
+
+
+#if !defined(__SSE4_2__)
+namespace {
+
+// Slice-by-8 tables
+struct Crc32cTables {
+    quint32 table[8][256];
+    Crc32cTables() {
+        for(quint32 i=0; i<256; i++) {
+            quint32 crc = i;
+            for(int j=0; j<8; j++)
+                crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+            table[0][i] = crc;
+        }
+        for(quint32 i=0; i<256; i++) {
+            for(int k=1; k<8; k++)
+                table[k][i] = (table[k-1][i] >> 8) ^ table[0][table[k-1][i] & 0xFF];
+        }
+    }
+};
+
+const Crc32cTables&
+tables() {
+    static const Crc32cTables crcTables;
+    return crcTables;
+}
+
+} // namespace
+#endif
+
+
+/*!
+ * \brief crc32c
+ * Uses the SSE 4.2 instruction when the build targets it and
+ * the slice-by-8 algorithm otherwise.
+ * \param pData The data
+ * \param length The number of bytes
+ * \param crc The CRC of the preceding data (0 at the start)
+ * \return The CRC-32C of the data
+ */
+quint32
+crc32c(const void* pData, qint64 length, quint32 crc) {
+    auto* p = static_cast<const quint8*>(pData);
+    crc = ~crc;
+#if defined(__SSE4_2__)
+#if defined(__x86_64__) || defined(_M_X64)
+    quint64 crc64 = crc;
+    for(; length >= 8; p += 8, length -= 8) {
+        quint64 word;
+        memcpy(&word, p, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = quint32(crc64);
+#endif
+    for(; length > 0; p++, length--)
+        crc = _mm_crc32_u8(crc, *p);
+#else
+    const Crc32cTables& t = tables();
+    for(; length >= 8; p += 8, length -= 8) {
+        quint32 low  = crc ^ (quint32(p[0])       | (quint32(p[1]) << 8) |
+                             (quint32(p[2]) << 16) | (quint32(p[3]) << 24));
+        quint32 high = quint32(p[4])       | (quint32(p[5]) << 8) |
+                       (quint32(p[6]) << 16) | (quint32(p[7]) << 24);
+        crc = t.table[7][low & 0xFF]         ^ t.table[6][(low >> 8) & 0xFF]  ^
+              t.table[5][(low >> 16) & 0xFF] ^ t.table[4][low >> 24]          ^
+              t.table[3][high & 0xFF]        ^ t.table[2][(high >> 8) & 0xFF] ^
+              t.table[1][(high >> 16) & 0xFF] ^ t.table[0][high >> 24];
+    }
+    for(; length > 0; p++, length--)
+        crc = (crc >> 8) ^ t.table[0][(crc ^ *p) & 0xFF];
+#endif
+    return ~crc;
+}
@@ -0,0 +1,30 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <QtGlobal>
+
+// CRC-32C (Castagnoli polynomial, the one of iSCSI and ext4).
+// To compute the CRC of data split in several blocks pass the
+// value returned for the previous block as crc.
+quint32 crc32c(const void* pData, qint64 length, quint32 crc = 0);
+
+#endif // CRC32C_H
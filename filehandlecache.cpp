@@ -0,0 +1,248 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#include "filehandlecache.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QList>
+
+#if defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+
+#define FILE_HANDLE_MAX_HANDLES     1024 // All the caches together, never more than this
+#define FILE_HANDLE_MIN_HANDLES     8    // For each cache
+#define FILE_HANDLE_LIMIT_SHARE     4    // Fraction of the descriptor limit used by all the caches
+#define FILE_HANDLE_MAX_CHUNK       (1 << 30) // Largest read (a QByteArray holds less than 2 GB)
+
+
+namespace {
+
+// All the caches of the process share the descriptor budget
+QMutex                  registryMutex;
+QList<FileHandleCache*> caches;
+
+} // namespace
+
+
+/*!
+ * \brief FileHandleCache::FileHandleCache
+ * Keeps the recently read files open so that the chunks are read without
+ * an open/close cycle for each request. It is used for the files that are
+ * not memory mapped. An open file is closed as soon as it is evicted
+ * or its size or modification time change.
+ * The cache can be used concurrently by several reader threads.
+ * \param maxHandles The files kept open (0 = from the descriptor limit)
+ */
+FileHandleCache::FileHandleCache(int maxHandles)
+    : requestedHandles(qMax(0, maxHandles))
+{
+    {
+        QMutexLocker locker(&registryMutex);
+        caches.append(this);
+    }
+    shareBudget();
+}
+
+
+FileHandleCache::~FileHandleCache() {
+    {
+        QMutexLocker locker(&registryMutex);
+        caches.removeOne(this);
+    }
+    shareBudget();
+}
+
+
+/*!
+ * \brief FileHandleCache::setMaxHandles
+ * \param maxHandles The files kept open (0 = from the descriptor limit).
+ * It is never more than the share of descriptorBudget() of the cache.
+ */
+void
+FileHandleCache::setMaxHandles(int maxHandles) {
+    {
+        QMutexLocker locker(&mutex);
+        requestedHandles = qMax(0, maxHandles);
+    }
+    shareBudget();
+}
+
+
+/*!
+ * \brief FileHandleCache::shareBudget
+ * Split descriptorBudget() evenly between the caches of the process.
+ * Called when a cache is created or destroyed or changes its limit.
+ */
+void
+FileHandleCache::shareBudget() {
+    QMutexLocker registryLocker(&registryMutex);
+    if(caches.isEmpty())
+        return;
+    int share = qMax(FILE_HANDLE_MIN_HANDLES, descriptorBudget()/caches.count());
+    for(FileHandleCache* pCache : qAsConst(caches)) {
+        QMutexLocker locker(&pCache->mutex);
+        int maxHandles = share;
+        if(pCache->requestedHandles > 0)
+            maxHandles = qMin(pCache->requestedHandles, share);
+        pCache->openFiles.setMaxCost(maxHandles);
+    }
+}
+
+
+int
+FileHandleCache::maxHandles() const {
+    QMutexLocker locker(&mutex);
+    return openFiles.maxCost();
+}
+
+
+/*!
+ * \brief FileHandleCache::descriptorBudget
+ * \return The files all the caches of the process together can keep
+ * open without getting close to the process limit (ulimit -n): the
+ * sockets of the servers and the files sent over HTTP need their
+ * descriptors too
+ */
+int
+FileHandleCache::descriptorBudget() {
+#if defined(Q_OS_UNIX)
+    struct rlimit limit;
+    if((getrlimit(RLIMIT_NOFILE, &limit) == 0) && (limit.rlim_cur != RLIM_INFINITY)) {
+        rlim_t budget = limit.rlim_cur / FILE_HANDLE_LIMIT_SHARE;
+        return int(qBound(rlim_t(FILE_HANDLE_MIN_HANDLES), budget, rlim_t(FILE_HANDLE_MAX_HANDLES)));
+    }
+#endif
+    return FILE_HANDLE_MAX_HANDLES;
+}
+
+
+/*!
+ * \brief FileHandleCache::chunk
+ * \param sFilePath The full path of the file
+ * \param startPos The first byte requested
+ * \param length The number of bytes requested
+ * \return The requested bytes (at most FILE_HANDLE_MAX_CHUNK)
+ * or an empty QByteArray on errors
+ */
+QByteArray
+FileHandleCache::chunk(const QString& sFilePath, qint64 startPos, qint64 length) {
+    OpenFilePtr pOpen = openFile(sFilePath);
+    if(!pOpen)
+        return QByteArray();
+    if(startPos < 0 || startPos >= pOpen->size || length <= 0)
+        return QByteArray();
+    qint64 available = qMin(qMin(length, pOpen->size-startPos), qint64(FILE_HANDLE_MAX_CHUNK));
+    QByteArray ba(int(available), Qt::Uninitialized);
+    // The read is done without holding the lock of the cache
+#if defined(Q_OS_UNIX)
+    qint64 nRead = 0;
+    while(nRead < available) {
+        ssize_t n = pread(pOpen->pFile->handle(), ba.data()+nRead,
+                          size_t(available-nRead), off_t(startPos+nRead));
+        if(n <= 0)
+            break;
+        nRead += n;
+    }
+#else
+    QMutexLocker fileLocker(&pOpen->mutex);
+    qint64 nRead = -1;
+    if(pOpen->pFile->seek(startPos))
+        nRead = pOpen->pFile->read(ba.data(), available);
+#endif
+    if(nRead <= 0)
+        return QByteArray();
+    ba.truncate(int(nRead));
+    return ba;
+}
+
+
+/*!
+ * \brief FileHandleCache::invalidate Close a file (if open)
+ * \param sFilePath The full path of the file
+ */
+void
+FileHandleCache::invalidate(const QString& sFilePath) {
+    QMutexLocker locker(&mutex);
+    openFiles.remove(sFilePath);
+}
+
+
+/*!
+ * \brief FileHandleCache::clear Close all the files
+ */
+void
+FileHandleCache::clear() {
+    QMutexLocker locker(&mutex);
+    openFiles.clear();
+}
+
+
+int
+FileHandleCache::count() const {
+    QMutexLocker locker(&mutex);
+    return openFiles.count();
+}
+
+
+/*!
+ * \brief FileHandleCache::openFile
+ * Returns the open file, opening it if needed.
+ * A stale file (changed on disk) is opened again.
+ * \param sFilePath The full path of the file
+ * \return The open file or a null pointer on errors
+ */
+FileHandleCache::OpenFilePtr
+FileHandleCache::openFile(const QString& sFilePath) {
+    QFileInfo fileInfo(sFilePath);
+    QMutexLocker locker(&mutex);
+    if(!fileInfo.exists() || fileInfo.size() <= 0) {
+        openFiles.remove(sFilePath);
+        return OpenFilePtr();
+    }
+    OpenFilePtr* pCached = openFiles.object(sFilePath);
+    if(pCached) {
+        if(((*pCached)->size == fileInfo.size()) &&
+           ((*pCached)->lastModified == fileInfo.lastModified()))
+            return *pCached;
+        openFiles.remove(sFilePath);
+    }
+    auto* pFile = new QFile(sFilePath);
+    if(!pFile->open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        delete pFile;
+        return OpenFilePtr();
+    }
+    OpenFilePtr pOpen(new OpenFile);
+    pOpen->pFile        = pFile;
+    pOpen->size         = fileInfo.size();
+    pOpen->lastModified = fileInfo.lastModified();
+    // The least recently used file is closed if the budget is exceeded
+    openFiles.insert(sFilePath, new OpenFilePtr(pOpen));
+    return pOpen;
+}
+
+
+FileHandleCache::OpenFile::~OpenFile() {
+    pFile->close();
+    delete pFile;
+}
@@ -0,0 +1,67 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef FILEHANDLECACHE_H
+#define FILEHANDLECACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QDateTime>
+#include <QCache>
+#include <QMutex>
+#include <QSharedPointer>
+
+QT_FORWARD_DECLARE_CLASS(QFile)
+
+
+class FileHandleCache
+{
+public:
+    explicit FileHandleCache(int maxHandles = 0);
+    ~FileHandleCache();
+
+    void       setMaxHandles(int maxHandles);
+    int        maxHandles() const;
+    QByteArray chunk(const QString& sFilePath, qint64 startPos, qint64 length);
+    void       invalidate(const QString& sFilePath);
+    void       clear();
+    int        count() const;
+    static int descriptorBudget();
+
+private:
+    // Closed when the last reference goes away: a reader thread
+    // still reading from an evicted file keeps it open
+    struct OpenFile {
+        ~OpenFile();
+        QFile*    pFile;
+        QMutex    mutex; // Seek and read are not atomic without pread()
+        qint64    size;
+        QDateTime lastModified;
+    };
+    typedef QSharedPointer<OpenFile> OpenFilePtr;
+    OpenFilePtr openFile(const QString& sFilePath);
+    static void shareBudget();
+
+private:
+    mutable QMutex               mutex;
+    QCache<QString, OpenFilePtr> openFiles; // Least recently used first out
+    int                          requestedHandles; // 0 = the whole share
+};
+
+#endif // FILEHANDLECACHE_H
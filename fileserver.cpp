@@ -20,15 +20,106 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "netServer.h"
 #include "fileserver.h"
 #include "utility.h"
+#include "chunkheader.h"
+#include "hashindexer.h"
+#include "chunkreader.h"
+#include "slidepreprocessor.h"
+#include "slidebundler.h"
+#include "httpmediaserver.h"
+#include "tokenbucket.h"
+#include "multicastsender.h"
+#include "manifestframe.h"
+#include "updatedeltabuilder.h"
 
 #include <QFile>
+#include <QFileInfo>
 #include <QDir>
+#include <QDirIterator>
 #include <QThread>
+#include <QThreadPool>
 #include <QWebSocket>
 #include <QImage>
 #include <QBuffer>
+#include <QStandardPaths>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QSet>
+#include <QTextStream>
 #include <utility>
+#include <numeric>
+#include <algorithm>
 
+#if defined(Q_OS_LINUX)
+#include <fcntl.h>
+#endif
+
+
+// Server push (<stream>) parameters
+#define STREAM_CHUNK_SIZE           (256*1024)
+#define STREAM_MIN_CHUNK            (16*1024)
+#define STREAM_MAX_CHUNK            (4*1024*1024)
+#define STREAM_MAX_WINDOW           (64*1024*1024)
+#define STREAM_MAX_BUFFERED_CHUNKS  2
+
+// Most <get> transfers in progress for each client
+#define MAX_PINNED_FILES            64
+
+// Time to wait for the watched directory to settle down (ms)
+#define WATCH_SETTLE_TIME           1000
+// Only the directories are watched: the files written in place
+// are noticed by a periodic check (ms)
+#define WATCH_RESCAN_TIME           15000
+
+// Accepted panel resolutions
+#define MIN_PANEL_SIDE              16
+#define MAX_PANEL_SIDE              8192
+
+// The <get> of a client being read or waiting for the rate limiter:
+// the requests beyond are refused with a <chunk_error>
+#define MAX_QUEUED_CHUNKS           16
+
+// Longest wait of the rate limiter before checking again (ms)
+#define SHAPING_MAX_WAIT            100
+// Interval of the transfer rate measurement (ms)
+#define TRANSFER_STATS_INTERVAL     1000
+
+// The name used by the clients to get the slide bundle
+#define SLIDE_BUNDLE_NAME           "slides.vcb"
+
+// The optional list of the files in play order (one name per line)
+#define PLAYLIST_FILE_NAME          "playlist.txt"
+
+// Link estimation for the chunk size advice
+#define LINK_MIN_SAMPLE             (32*1024) // bytes written in a statistics interval
+#define LINK_CHUNK_TIME             250       // Time to send a chunk at the estimated goodput (ms)
+#define LINK_HIGH_RTT               150       // Above this round trip time (ms) the chunks are halved
+
+// Read-ahead of the sequential requests
+#define PREFETCH_DEFAULT_DEPTH      2   // Chunks read ahead
+#define PREFETCH_MIN_RUN            1   // Sequential reads before reading ahead
+#define PREFETCH_PRIORITY           (-(1 << 20)) // Below all the requested reads
+
+// A transfer with no requests and nothing to send for this time (ms)
+// leaves its place to the clients waiting
+#define ADMISSION_IDLE_TIME         2000
+// Requests kept for a client waiting its turn (the others are dropped)
+#define ADMISSION_MAX_DEFERRED      32
+
+// Manifest changes remembered for the <send_file_list>V</send_file_list> deltas
+#define MANIFEST_MAX_CHANGES        1024
+#define MANIFEST_PAGE_SIZE          256  // Entries in a <file_page>
+
+// Peer distribution
+#define PEER_DEFAULT_REDIRECTS      8    // Per peer and statistics interval
+#define PEER_MIN_PORT               1024 // The panels never serve on a privileged port
+
+// Manifest encodings (see <manifest_encoding>)
+#define MANIFEST_ENCODING_TEXT      0
+#define MANIFEST_ENCODING_BINARY    1    // See manifestframe.h
+
+// Most ranges accepted in a <multicast_nack>
+#define MULTICAST_MAX_NACK_RANGES   64
 
 /*!
  * \brief FileServer::FileServer It implements a Server for Slides or Spots file transfer
@@ -41,9 +132,69 @@ FileServer::FileServer(const QString& sName, QFile* myLogFile, QObject *parent)
     , serverName(sName)
 {
     port      = 0;
+    httpPort  = 0;
+    pHttpServer = nullptr;
+    pMulticast    = nullptr;
+    multicastPort = 0;
+    multicastRate = 0;
+    minChunkSize  = STREAM_MIN_CHUNK;
+    prefetchDepth = PREFETCH_DEFAULT_DEPTH;
+    pTransferSlots = &localSlots;
+    // The versions grow across the restarts: a panel never
+    // gets a delta computed from a manifest of another run
+    manifestVersion  = quint64(QDateTime::currentMSecsSinceEpoch());
+    deltaBaseVersion = manifestVersion;
+    playOrderVersion = manifestVersion;
+    admissionClock.start();
+    maxChunkSize  = STREAM_MAX_CHUNK;
+    pGlobalBucket  = nullptr;
+    clientRate     = 0;
+    pShapingTimer  = nullptr;
+    pStatsTimer    = nullptr;
+    sentBytes      = 0;
+    redirectedRequests = 0;
+    peerMaxRedirects   = PEER_DEFAULT_REDIRECTS;
+    bPeerLoopback      = false;
+    lastSentBytes  = 0;
+    currentRate    = 0;
+    queuedFrames   = 0;
+    queuedBytes    = 0;
+    bMapFiles = false; // See setMappedMode()
+    bClosing  = false;
+    nReaders  = 0;
+    bListedUnhashed = false;
+    bHosted   = false;
+    pChunkCache = &localChunkCache;
     sFileDir  = QString();
-    fileList  = QList<QFileInfo>();
+    pWatcher    = nullptr;
+    pWatchTimer = nullptr;
+    pRescanTimer = nullptr;
+    bScaleSlides       = false;
+    pSlidePreprocessor = nullptr;
+    pSlideBundler      = nullptr;
+    bundle.size        = 0;
+    bUpdateDeltas      = false;
+    pDeltaBuilder      = nullptr;
     connections.clear();
+
+    // The disk reads are done by a small pool of threads so that
+    // a slow read does not block the transfers to the other clients
+    pReaderPool = new QThreadPool(this);
+    pReaderPool->setMaxThreadCount(2);
+
+    // The content hashes are computed in a background thread
+    QString sIndexFile = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+                         QString("/hashindex_%1.txt").arg(serverName);
+    pHashIndexer = new HashIndexer(sIndexFile, myLogFile);
+    pHashThread  = new QThread();
+    pHashIndexer->moveToThread(pHashThread);
+    connect(this, SIGNAL(hashFiles(QStringList)),
+            pHashIndexer, SLOT(onHashFiles(QStringList)));
+    connect(pHashIndexer, SIGNAL(fileHashed(QString,qint64,qint64,quint64)),
+            this, SLOT(onFileHashed(QString,qint64,qint64,quint64)));
+    connect(pHashIndexer, SIGNAL(hashingDone()),
+            this, SLOT(onHashingDone()));
+    pHashThread->start(QThread::IdlePriority);
 }
 
 
@@ -57,330 +208,3168 @@ FileServer::setServerPort(quint16 myPort) {
 }
 
 
+/*!
+ * \brief FileServer::setHttpPort
+ * \param myPort The port of the HTTP server for the same files (0 = no HTTP server)
+ */
+void
+FileServer::setHttpPort(quint16 myPort) {
+    httpPort = myPort;
+}
+
+
+/*!
+ * \brief FileServer::setMulticast
+ * Enable the distribution of the files to a multicast group.
+ * To be called before the server starts
+ * \param groupAddress The multicast group
+ * \param groupPort The port the panels listen to
+ * \param bytesPerSecond The sending rate (0 means unlimited)
+ */
+void
+FileServer::setMulticast(const QHostAddress& groupAddress, quint16 groupPort, qint64 bytesPerSecond) {
+    multicastGroup = groupAddress;
+    multicastPort  = groupPort;
+    multicastRate  = bytesPerSecond;
+}
+
+
+/*!
+ * \brief FileServer::setChunkBounds
+ * The limits of the chunk size advised to the clients
+ * \param minBytes The smallest chunk
+ * \param maxBytes The largest chunk
+ */
+void
+FileServer::setChunkBounds(qint64 minBytes, qint64 maxBytes) {
+    minChunkSize = qBound(qint64(STREAM_MIN_CHUNK), minBytes, qint64(STREAM_MAX_CHUNK));
+    maxChunkSize = qBound(minChunkSize, maxBytes, qint64(STREAM_MAX_CHUNK));
+}
+
+
+/*!
+ * \brief FileServer::setPrefetchDepth
+ * \param nChunks The chunks read ahead of a client reading a file
+ * sequentially (0 disables the read-ahead)
+ */
+void
+FileServer::setPrefetchDepth(int nChunks) {
+    prefetchDepth = qMax(0, nChunks);
+}
+
+
+/*!
+ * \brief FileServer::setMaxTransfers
+ * \param nTransfers The clients served at the same time (0 = unlimited).
+ * The others wait in a queue, in order of arrival.
+ * A hosted server shares the limit with the other namespaces:
+ * use MediaServer::setMaxTransfers() instead.
+ */
+void
+FileServer::setMaxTransfers(int nTransfers) {
+    pTransferSlots->setLimit(nTransfers);
+}
+
+
+/*!
+ * \brief FileServer::setPeerRedirects
+ * \param nRedirects The <get> requests that can be redirected to each
+ * panel every second (0 = the chunks are always sent by the server)
+ */
+void
+FileServer::setPeerRedirects(int nRedirects) {
+    peerMaxRedirects = qMax(0, nRedirects);
+}
+
+
+/*!
+ * \brief FileServer::setPeerLoopback
+ * Meant for testing the peer distribution on a single host: the panels
+ * connected from the loopback address are not taken for duplicates of
+ * each other and they are redirected to each other at 127.0.0.1.
+ * To simulate several panels:
+ *  - set fileserver/peerLoopback to true in the settings and restart;
+ *  - start each simulated panel on the same host with its own storage
+ *    directory and its own peer port, connecting to ws://127.0.0.1;
+ *  - let the first panel download the files, then start the others:
+ *    the transfer statistics count the redirected requests and each
+ *    panel log shows the chunks received from its peers;
+ *  - stop a panel during a transfer: the others report <peer_failed>
+ *    and get the chunks from the server again.
+ * Never enable it on a real installation: a panel reconnecting
+ * through a local proxy would leave its old connection behind.
+ * \param bEnable Allow several panels on the loopback address
+ */
+void
+FileServer::setPeerLoopback(bool bEnable) {
+    bPeerLoopback = bEnable;
+}
+
+
+/*!
+ * \brief FileServer::setMaxOpenFiles
+ * \param nFiles The files kept mapped and the files not mapped kept open
+ * between the reads (0 = a share of the process descriptor limit)
+ */
+void
+FileServer::setMaxOpenFiles(int nFiles) {
+    mappedFiles.setMaxFiles(nFiles);
+    openFiles.setMaxHandles(nFiles);
+}
+
+
 /*!
  * \brief FileServer::setDir To set the destination directory
+ * The files are searched in the whole directory tree and are named by
+ * their path relative to the directory.
+ * The directories of the tree are then watched for changes (the files
+ * are not, to spare the watch descriptors): the added, removed or
+ * modified files update the file list incrementally and the changes
+ * are pushed to the connected clients with <file_added> and <file_removed>.
+ * The play order is taken from the playlist file in the same directory.
  * \param sDirectory The selected directory
  * \param sExtensions The file extensions it manipulate
  * \return true if the directory can be used
  */
 bool
 FileServer::setDir(QString sDirectory, const QString& sExtensions) {
-    sFileDir = std::move(sDirectory);
+    if(pWatcher) {
+        const QStringList watchedDirs = pWatcher->directories();
+        if(!watchedDirs.isEmpty())
+            pWatcher->removePaths(watchedDirs);
+    }
+    else {
+        pWatcher = new QFileSystemWatcher(this);
+        connect(pWatcher, SIGNAL(directoryChanged(QString)),
+                this, SLOT(onDirectoryChanged(QString)));
+        pWatchTimer = new QTimer(this);
+        pWatchTimer->setSingleShot(true);
+        pWatchTimer->setInterval(WATCH_SETTLE_TIME);
+        connect(pWatchTimer, SIGNAL(timeout()),
+                this, SLOT(onUpdateFileList()));
+        pRescanTimer = new QTimer(this);
+        pRescanTimer->setInterval(WATCH_RESCAN_TIME);
+        connect(pRescanTimer, SIGNAL(timeout()),
+                this, SLOT(onUpdateFileList()));
+    }
+    pWatchTimer->stop();
+    pRescanTimer->start();
+
+    sFileDir = QDir(sDirectory).absolutePath();
     if(!sFileDir.endsWith(QString("/")))  sFileDir+= QString("/");
+    nameFilters = sExtensions.split(" ", Qt::SkipEmptyParts);
+    mappedFiles.clear();
+    openFiles.clear();
+    // The chunk cache may be shared with other servers
+    for(int i=0; i<catalog.count(); i++)
+        pChunkCache->invalidate(catalog.filePath(i));
+    // The same directory set again keeps the hashes of the unchanged files
+    MediaCatalog previous;
+    if(catalog.root() == sFileDir)
+        previous = catalog;
+    catalog.setRoot(sFileDir);
+    announcedUnhashed.clear();
+    bListedUnhashed = false;
 
-    QDir sDir(sFileDir);
-    if(sDir.exists()) {
-        QStringList nameFilter(sExtensions.split(" "));
-        sDir.setNameFilters(nameFilter);
-        sDir.setFilter(QDir::Files);
-        fileList = sDir.entryInfoList();
+    QStringList directories;
+    const QStringList names = scanDirectory(&directories);
+    QStringList filePaths;
+    QStringList filesToHash;
+    filePaths.reserve(names.count());
+    for(const QString& sName : names) {
+        QFileInfo fileInfo(sFileDir + sName);
+        int i = catalog.insert(sName, fileInfo.size(), fileInfo.lastModified().toMSecsSinceEpoch());
+        filePaths.append(catalog.filePath(i));
+        int j = previous.indexOf(sName);
+        if((j >= 0) && previous.isHashed(j)        &&
+           (previous.size(j) == catalog.size(i))    &&
+           (previous.lastModified(j) == catalog.lastModified(i)))
+            catalog.setHash(i, previous.hash(j));
+        else
+            filesToHash.append(catalog.filePath(i));
+    }
+    if(!directories.isEmpty())
+        pWatcher->addPaths(directories);
+    updatePlayOrder();
+    resetManifest();
+    if(!filesToHash.isEmpty())
+        emit hashFiles(filesToHash);
+    if(bScaleSlides) {
+        if(!pSlidePreprocessor) {
+            QString sCacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+                                QString("/%1").arg(serverName);
+            pSlidePreprocessor = new SlidePreprocessor(sCacheDir, logFile, this);
+            connect(pSlidePreprocessor, SIGNAL(variantReady(QString,QSize)),
+                    this, SLOT(onSlideVariantReady(QString,QSize)));
+            for(auto it=clientResolutions.constBegin(); it!=clientResolutions.constEnd(); ++it)
+                pSlidePreprocessor->addResolution(it.value());
+        }
+        pSlidePreprocessor->setSlides(filePaths);
+    }
+    if(pSlideBundler) {
+        bundle.size = 0; // Not available until rebuilt
+        emit buildBundle(sFileDir, filePaths);
     }
 #ifdef LOG_VERBOSE
     logMessage(logFile,
                Q_FUNC_INFO,
                serverName +
                QString(" Found %1 files in %2")
-               .arg(fileList.count())
+               .arg(catalog.count())
                .arg(sFileDir));
+#endif
+    // The clients already connected get the new list
+    for(int i=0; i<connections.count(); i++) {
+        if(connections.at(i)->isValid()) {
+            sendFileList(connections.at(i));
+            SendToOne(connections.at(i), playOrderMessage());
+        }
+    }
+    return true;
+}
+
+
+/*!
+ * \brief FileServer::onSetDir
+ * To change the served directory from another thread
+ */
+void
+FileServer::onSetDir(QString sDirectory, QString sExtensions) {
+    setDir(std::move(sDirectory), sExtensions);
+}
+
+
+/*!
+ * \brief FileServer::onDirectoryChanged
+ * Files have been added, removed, renamed or replaced. The update is
+ * delayed until the directory settles down (e.g. while a file is being copied).
+ */
+void
+FileServer::onDirectoryChanged(const QString& sPath) {
+    Q_UNUSED(sPath)
+    pWatchTimer->start();
+}
+
+
+/*!
+ * \brief FileServer::onUpdateFileList
+ * Update the file list incrementally: the names in the directory tree
+ * are listed, the known files are checked by size and modification time
+ * and only the new or changed files are examined.
+ */
+void
+FileServer::onUpdateFileList() {
+    QStringList directories;
+    const QStringList names = scanDirectory(&directories);
+    QSet<QString> presentNames(names.begin(), names.end());
+    QSet<QString> knownNames;
+    bool bListChanged = false;
+
+    // Watch the new subdirectories (the removed ones are dropped)
+    const QStringList watchedDirs = pWatcher->directories();
+    QSet<QString> presentDirs(directories.begin(), directories.end());
+    QSet<QString> knownDirs(watchedDirs.begin(), watchedDirs.end());
+    for(const QString& sDir : qAsConst(watchedDirs)) {
+        if(!presentDirs.contains(sDir))
+            pWatcher->removePath(sDir);
+    }
+    for(const QString& sDir : qAsConst(directories)) {
+        if(!knownDirs.contains(sDir))
+            pWatcher->addPath(sDir);
+    }
+
+    // Removed files
+    for(int i=catalog.count()-1; i>=0; i--) {
+        const QString sName = catalog.name(i);
+        if(presentNames.contains(sName)) {
+            knownNames.insert(sName);
+            continue;
+        }
+        const QString sFilePath = catalog.filePath(i);
+        forgetFile(sFilePath);
+        catalog.removeAt(i);
+        bListChanged = true;
+        SendToAll(QString("<file_removed>%1</file_removed>").arg(sName));
+        noteManifestChange(sName);
+#ifdef LOG_VERBOSE
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   serverName +
+                   QString(" Removed %1").arg(sName));
+#endif
+    }
+
+    QStringList filesToHash;
+    // Modified files
+    for(int i=0; i<catalog.count(); i++) {
+        const QString sFilePath = catalog.filePath(i);
+        QFileInfo fileInfo(sFilePath);
+        qint64 lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+        if((fileInfo.size() == catalog.size(i)) &&
+           (lastModified == catalog.lastModified(i)))
+            continue;
+        forgetFile(sFilePath);
+        catalog.update(i, fileInfo.size(), lastModified);
+        filesToHash.append(sFilePath);
+        noteManifestChange(catalog.name(i));
+        SendFileAdded(i);
+    }
+
+    // Added files
+    for(const QString& sName : qAsConst(names)) {
+        if(knownNames.contains(sName))
+            continue;
+        QFileInfo fileInfo(sFileDir + sName);
+        int i = catalog.insert(sName, fileInfo.size(), fileInfo.lastModified().toMSecsSinceEpoch());
+        bListChanged = true;
+        filesToHash.append(catalog.filePath(i));
+        noteManifestChange(sName);
+        SendFileAdded(i);
+#ifdef LOG_VERBOSE
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   serverName +
+                   QString(" Added %1").arg(sName));
+#endif
+    }
+    if(!filesToHash.isEmpty()) {
+        emit hashFiles(filesToHash);
+        if(pSlidePreprocessor)
+            pSlidePreprocessor->updateSlides(filesToHash);
+    }
+    if(pSlideBundler && (bListChanged || !filesToHash.isEmpty())) {
+        QStringList filePaths;
+        filePaths.reserve(catalog.count());
+        for(int i=0; i<catalog.count(); i++)
+            filePaths.append(catalog.filePath(i));
+        emit buildBundle(sFileDir, filePaths);
+    }
+    bool bOrderChanged = updatePlayOrder();
+    if(bOrderChanged) {
+        manifestVersion++;
+        playOrderVersion = manifestVersion;
+        manifestCache.clear();
+        manifestFrames.clear();
+        manifestRows.clear();
+        budgetRows.clear();
+        SendToAll(playOrderMessage());
+    }
+    if(bListChanged || !filesToHash.isEmpty() || bOrderChanged)
+        SendBudgetedLists();
+}
+
+
+/*!
+ * \brief FileServer::scanDirectory
+ * List the served files in the whole directory tree. The symbolic links
+ * to directories are not followed and the files whose name could not
+ * travel in the messages are skipped.
+ * \param pDirectories Where to store the directories to watch
+ * \return The file names relative to the root, sorted as in the catalog
+ */
+QStringList
+FileServer::scanDirectory(QStringList* pDirectories) {
+    QStringList names;
+    pDirectories->clear();
+    QDir rootDir(sFileDir);
+    if(!rootDir.exists())
+        return names;
+    pDirectories->append(sFileDir);
+    QDirIterator dirIterator(sFileDir,
+                             QDir::Dirs | QDir::NoDotAndDotDot,
+                             QDirIterator::Subdirectories);
+    while(dirIterator.hasNext())
+        pDirectories->append(dirIterator.next());
+    QDirIterator fileIterator(sFileDir,
+                              nameFilters,
+                              QDir::Files,
+                              QDirIterator::Subdirectories);
+    while(fileIterator.hasNext()) {
+        QString sName = rootDir.relativeFilePath(fileIterator.next());
+        if(!MediaCatalog::isValidName(sName)) {
+            logMessage(logFile,
+                       Q_FUNC_INFO,
+                       serverName +
+                       QString(" Skipped %1: invalid name").arg(sName));
+            continue;
+        }
+        names.append(sName);
+    }
+    std::sort(names.begin(), names.end(), [](const QString& a, const QString& b) {
+        return QString::compare(a, b, Qt::CaseInsensitive) < 0;
+    });
+    return names;
+}
+
+
+/*!
+ * \brief FileServer::resetManifest
+ * The whole manifest has changed: no delta can be computed
+ * from the previous versions
+ */
+void
+FileServer::resetManifest() {
+    manifestVersion++;
+    deltaBaseVersion = manifestVersion;
+    playOrderVersion = manifestVersion;
+    manifestChanges.clear();
+    manifestCache.clear();
+    manifestFrames.clear();
+    manifestRows.clear();
+    budgetRows.clear();
+}
+
+
+/*!
+ * \brief FileServer::noteManifestChange
+ * An entry of the manifest has been added, changed or removed:
+ * a new version of the manifest begins
+ * \param sFileName The file whose entry has changed
+ * \param bHashOnly Only its hash is new: the play order and the subsets
+ * of the budgeted panels stay the same
+ */
+void
+FileServer::noteManifestChange(const QString& sFileName, bool bHashOnly) {
+    manifestVersion++;
+    ManifestChange change;
+    change.version   = manifestVersion;
+    change.sFileName = sFileName;
+    manifestChanges.append(change);
+    if(manifestChanges.count() > MANIFEST_MAX_CHANGES) {
+        // The deltas from the older versions can no more be computed
+        deltaBaseVersion = manifestChanges.first().version;
+        manifestChanges.removeFirst();
+    }
+    manifestCache.clear();
+    manifestFrames.clear();
+    if(bHashOnly)
+        return;
+    manifestRows.clear();
+    budgetRows.clear();
+}
+
+
+/*!
+ * \brief FileServer::updatePlayOrder
+ * Rebuild the play order: the files listed in the playlist come first,
+ * in the listed order, followed by the others in name order.
+ * The playlist lists the files by their path relative to the root.
+ * The changes of the playlist file are noticed with the other files.
+ * \return true if the play order has changed
+ */
+bool
+FileServer::updatePlayOrder() {
+    QStringList newOrder;
+    QSet<QString> listedNames;
+
+    QString sPlaylistPath = sFileDir + QString(PLAYLIST_FILE_NAME);
+    QFile playlistFile(sPlaylistPath);
+    if(playlistFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        QTextStream playlist(&playlistFile);
+        QString sLine;
+        while(playlist.readLineInto(&sLine)) {
+            sLine = sLine.trimmed();
+            if(sLine.isEmpty() || sLine.startsWith(QString("#")))
+                continue;
+            if(listedNames.contains(sLine) || (catalog.indexOf(sLine) < 0))
+                continue;
+            listedNames.insert(sLine);
+            newOrder.append(sLine);
+        }
+        playlistFile.close();
+    }
+    for(int i=0; i<catalog.count(); i++) {
+        const QString sName = catalog.name(i);
+        if(!listedNames.contains(sName))
+            newOrder.append(sName);
+    }
+    if(newOrder == playOrder)
+        return false;
+    playOrder = newOrder;
+    playRanks.clear();
+    for(int i=0; i<playOrder.count(); i++)
+        playRanks.insert(playOrder.at(i), i);
+#ifdef LOG_VERBOSE
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               serverName +
+               QString(" New play order: %1 files, %2 from the playlist")
+               .arg(playOrder.count())
+               .arg(listedNames.count()));
 #endif
     return true;
 }
 
 
 /*!
- * \brief FileServer::onStartServer Invoked to start listening for connections
+ * \brief FileServer::playRank
+ * \param sFileName The requested file
+ * \return The position of the file in the play order (0 = needed first).
+ * The slide bundle holds the whole show so it comes first.
+ */
+int
+FileServer::playRank(const QString& sFileName) const {
+    if(sFileName == QString(SLIDE_BUNDLE_NAME))
+        return 0;
+    return playRanks.value(sFileName, playOrder.count());
+}
+
+
+/*!
+ * \brief FileServer::playOrderMessage
+ * \return The message with the file names in play order
+ */
+QString
+FileServer::playOrderMessage() {
+    return QString("<play_order>%1</play_order>").arg(playOrder.join(QString(",")));
+}
+
+
+/*!
+ * \brief FileServer::forgetFile
+ * Drop everything known about a file that changed or has been removed
+ * \param sFilePath The full path of the file
+ */
+void
+FileServer::forgetFile(const QString& sFilePath) {
+    if(!updateDeltas.isEmpty() || pDeltaBuilder)
+        forgetUpdateDeltas(sFilePath);
+    mappedFiles.invalidate(sFilePath);
+    openFiles.invalidate(sFilePath);
+    pChunkCache->invalidate(sFilePath);
+    const QString sName = catalog.nameOf(sFilePath);
+    if(pMulticast)
+        pMulticast->forgetFile(sName);
+    // What was sent before the change no longer vouches for a panel
+    for(auto it=peers.begin(); it!=peers.end(); ++it) {
+        it->sent.remove(sName);
+        it->files.remove(sName);
+    }
+    if(pSlidePreprocessor)
+        pSlidePreprocessor->removeSlide(sFilePath);
+}
+
+
+/*!
+ * \brief FileServer::forgetClient
+ * Drop the state kept for a client that is going away
+ * \param pClient The client
+ */
+void
+FileServer::forgetClient(QWebSocket* pClient) {
+    streams.remove(pClient);
+    pinnedFiles.remove(pClient);
+    clientResolutions.remove(pClient);
+    clientBudgets.remove(pClient);
+    budgetChanged.remove(pClient);
+    clientFraming.remove(pClient);
+    clientManifestEncoding.remove(pClient);
+    links.remove(pClient);
+    sequences.remove(pClient);
+    peers.remove(pClient);
+    // The place left goes to the first client waiting in any namespace
+    if(activeTransfers.remove(pClient) > 0)
+        pTransferSlots->release();
+    for(int i=0; i<waitingClients.count(); i++) {
+        if(waitingClients.at(i).pClient == pClient) {
+            waitingClients.removeAt(i);
+            pTransferSlots->cancel(this, pClient);
+            break;
+        }
+    }
+    delete clientBuckets.take(pClient);
+    pendingReads.remove(pClient);
+    for(auto waiters=updateWaiters.begin(); waiters!=updateWaiters.end(); ++waiters) {
+        for(int i=waiters->count()-1; i>=0; i--) {
+            if(waiters->at(i).pClient == pClient)
+                waiters->removeAt(i);
+        }
+    }
+    auto it = pendingFrames.find(pClient);
+    if(it != pendingFrames.end()) {
+        for(const PendingFrame& pending : qAsConst(*it))
+            queuedBytes -= pending.frame.size();
+        queuedFrames -= it->count();
+        pendingFrames.erase(it);
+    }
+}
+
+
+/*!
+ * \brief FileServer::notePeerHolding
+ * <have>name;hash</have>: the panel has the whole file and its content
+ * matches the manifest hash; <have>name;hash;pos,len;pos,len...</have>:
+ * it has these verified ranges of the file. The announcements that do
+ * not match the current manifest are ignored.
+ * The hash is only echoed back by the panel, so it is not trusted on
+ * its own: only the ranges this server has sent to the panel, from the
+ * file with that hash, are recorded (see notePeerSent()). A panel that
+ * got a range from a peer cannot pass it on.
+ * \param pClient The panel
+ * \param sHolding The text of the announcement
+ */
+void
+FileServer::notePeerHolding(QWebSocket* pClient, const QString& sHolding) {
+    auto itPeer = peers.find(pClient);
+    if(itPeer == peers.end())
+        return; // Not taking part in the peer distribution
+    QStringList fields = sHolding.split(QChar(';'));
+    if(fields.count() < 2)
+        return;
+    const QString& sFileName = fields.at(0);
+    bool bOk;
+    quint64 hash = fields.at(1).toULongLong(&bOk, 16);
+    int i = catalog.indexOf(sFileName);
+    if(!bOk || (i < 0) || !catalog.isHashed(i) || (catalog.hash(i) != hash))
+        return;
+    auto itSent = itPeer->sent.constFind(sFileName);
+    if((itSent == itPeer->sent.constEnd()) || (itSent->hash != hash))
+        return; // Not received from this server
+
+    QVector<QPair<qint64, qint64>> announced;
+    if(fields.count() == 2) {
+        announced.append(qMakePair(qint64(0), catalog.size(i))); // The whole file
+    }
+    else {
+        for(int j=2; j<fields.count(); j++) {
+            QStringList range = fields.at(j).split(QChar(','));
+            if(range.count() != 2)
+                continue;
+            qint64 startPos = range.at(0).toLongLong();
+            qint64 length   = range.at(1).toLongLong();
+            if((startPos < 0) || (length <= 0))
+                continue;
+            announced.append(qMakePair(startPos, length));
+        }
+    }
+
+    bool bKnown = itPeer->files.contains(sFileName);
+    PeerHolding& holding = itPeer->files[sFileName];
+    if(!bKnown || (holding.hash != hash)) {
+        holding.hash = hash;
+        holding.ranges.clear();
+        holding.ranges.append(qMakePair(qint64(0), qint64(0))); // Start from no range
+    }
+    if(holding.ranges.isEmpty())
+        return; // Already has the whole file
+    // Only the part of each range that this server has sent
+    for(const auto& range : qAsConst(announced)) {
+        for(const auto& sent : itSent->ranges) {
+            qint64 startPos = qMax(range.first, sent.first);
+            qint64 endPos   = qMin(range.first+range.second, sent.first+sent.second);
+            if(endPos > startPos)
+                addRange(&holding.ranges, startPos, endPos-startPos);
+        }
+    }
+    if((holding.ranges.count() == 1) && (holding.ranges.first().first == 0) &&
+       (holding.ranges.first().second >= catalog.size(i)))
+        holding.ranges.clear(); // The whole file
+}
+
+
+/*!
+ * \brief FileServer::notePeerSent
+ * Record a chunk of a manifest file sent to a panel taking part in the
+ * peer distribution: its announcements are checked against these ranges
+ * \param pClient The panel
+ * \param request The request with the data sent
+ */
+void
+FileServer::notePeerSent(QWebSocket* pClient, const ChunkRequest& request) {
+    auto itPeer = peers.find(pClient);
+    if(itPeer == peers.end())
+        return;
+    int i = catalog.indexOf(request.sFileName);
+    // Only the files of the manifest, read from the hashed file
+    if((i < 0) || !catalog.isHashed(i) || (request.sFilePath != catalog.filePath(i)))
+        return;
+    bool bKnown = itPeer->sent.contains(request.sFileName);
+    PeerHolding& sent = itPeer->sent[request.sFileName];
+    if(!bKnown || (sent.hash != catalog.hash(i))) {
+        sent.hash = catalog.hash(i);
+        sent.ranges.clear();
+    }
+    addRange(&sent.ranges, request.startPos, request.data.size());
+}
+
+
+/*!
+ * \brief FileServer::addRange
+ * Add a range to a list of ranges kept sorted and merged. The empty
+ * ranges in the list (e.g. the "no range yet" marker) are dropped.
+ * \param pRanges The list of startPos, length
+ * \param startPos The first byte of the range
+ * \param length The range length
+ */
+void
+FileServer::addRange(QVector<QPair<qint64, qint64>>* pRanges, qint64 startPos, qint64 length) {
+    if(length > 0)
+        pRanges->append(qMakePair(startPos, length));
+    std::sort(pRanges->begin(), pRanges->end());
+    QVector<QPair<qint64, qint64>> merged;
+    for(const auto& range : qAsConst(*pRanges)) {
+        if(range.second <= 0)
+            continue;
+        if(!merged.isEmpty() && (range.first <= merged.last().first+merged.last().second)) {
+            qint64 endPos = qMax(merged.last().first+merged.last().second, range.first+range.second);
+            merged.last().second = endPos - merged.last().first;
+        }
+        else {
+            merged.append(range);
+        }
+    }
+    if(merged.isEmpty()) // Still nothing
+        merged.append(qMakePair(qint64(0), qint64(0)));
+    *pRanges = merged;
+}
+
+
+/*!
+ * \brief FileServer::peerFor
+ * The server acts as a tracker: a chunk already verified by another
+ * panel is sent by that panel, so that the uplink of the server is
+ * left for the chunks nobody has yet. The least loaded peer is chosen
+ * and each peer gets at most peerMaxRedirects requests per second.
+ * The <get> is then answered with
+ * <redirect>name,start,length[,id];host;port</redirect>: the whole
+ * argument of the <get> (so that a tagged request keeps its id) followed
+ * by the endpoint returned here. The panel asks the peer for the same
+ * chunk and, if the peer cannot be reached, it tells us with
+ * <peer_failed>host;port</peer_failed> and sends the <get> again.
+ * \param pClient The requesting panel
+ * \param sFileName The requested file
+ * \param fileInfo The file that would be sent
+ * \param startPos The first byte requested
+ * \param length The bytes requested
+ * \return "address;port" of the peer or an empty string
+ * when the chunk has to be sent by the server
+ */
+QString
+FileServer::peerFor(QWebSocket* pClient, const QString& sFileName, const QFileInfo& fileInfo,
+                    qint64 startPos, qint64 length) {
+    if((peerMaxRedirects == 0) || !peers.contains(pClient))
+        return QString();
+    int i = catalog.indexOf(sFileName);
+    // Only the files of the manifest (e.g. not the scaled slides)
+    if((i < 0) || !catalog.isHashed(i) || (fileInfo.absoluteFilePath() != catalog.filePath(i)))
+        return QString();
+    qint64 endPos = qMin(startPos+length, catalog.size(i));
+    QWebSocket* pBest = nullptr;
+    int bestLoad = peerMaxRedirects;
+    for(auto it=peers.constBegin(); it!=peers.constEnd(); ++it) {
+        if((it.key() == pClient) || (it->port == 0) || (it->load >= bestLoad) || !it.key()->isValid())
+            continue;
+        auto holding = it->files.constFind(sFileName);
+        if((holding == it->files.constEnd()) || (holding->hash != catalog.hash(i)))
+            continue;
+        bool bHas = holding->ranges.isEmpty();
+        for(const auto& range : holding->ranges) {
+            if((range.first <= startPos) && (range.first+range.second >= endPos)) {
+                bHas = true;
+                break;
+            }
+        }
+        if(!bHas)
+            continue;
+        pBest    = it.key();
+        bestLoad = it->load;
+    }
+    if(!pBest)
+        return QString();
+    PeerState& peer = peers[pBest];
+    peer.load++;
+    redirectedRequests++;
+    return QString("%1;%2").arg(peerHost(pBest->peerAddress())).arg(peer.port);
+}
+
+
+/*!
+ * \brief FileServer::dropPeer
+ * A panel could not reach a peer: no more requests are redirected to it
+ * until it announces its files again
+ * \param sEndpoint "address;port" of the peer, as in the <redirect>
+ */
+void
+FileServer::dropPeer(const QString& sEndpoint) {
+    for(auto it=peers.begin(); it!=peers.end(); ++it) {
+        if(QString("%1;%2").arg(peerHost(it.key()->peerAddress())).arg(it->port) != sEndpoint)
+            continue;
+        it->files.clear();
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   serverName +
+                   QString(" Peer %1 unreachable").arg(sEndpoint));
+    }
+}
+
+
+/*!
+ * \brief FileServer::peerHost
+ * \return The address the other panels use to reach a peer
+ * (IPv4 when possible, also for the IPv4 mapped addresses)
+ */
+QString
+FileServer::peerHost(const QHostAddress& address) {
+    bool bIPv4;
+    quint32 ipv4 = address.toIPv4Address(&bIPv4);
+    if(bIPv4)
+        return QHostAddress(ipv4).toString();
+    return address.toString();
+}
+
+
+/*!
+ * \brief FileServer::servedFile
+ * \param pClient The requesting client
+ * \param sFileName The requested file
+ * \return The file to send: the slide bundle, the slide scaled to the
+ * client resolution when it is ready, the original file otherwise.
+ * Only the files in the catalog can be sent.
+ */
+QFileInfo
+FileServer::servedFile(QWebSocket* pClient, const QString& sFileName) {
+    if(pSlideBundler && (sFileName == QString(SLIDE_BUNDLE_NAME))) {
+        if(bundle.size > 0)
+            return QFileInfo(bundle.sFilePath);
+        return QFileInfo();
+    }
+    auto itDelta = updateDeltas.constFind(sFileName);
+    if(itDelta != updateDeltas.constEnd())
+        return QFileInfo(itDelta.value());
+    int i = catalog.indexOf(sFileName);
+    if(i < 0)
+        return QFileInfo();
+    QFileInfo fileInfo(catalog.filePath(i));
+    if(!pSlidePreprocessor || !fileInfo.exists())
+        return fileInfo;
+    auto it = clientResolutions.constFind(pClient);
+    if(it == clientResolutions.constEnd())
+        return fileInfo;
+    SlideVariant slideVariant;
+    if(!pSlidePreprocessor->variant(fileInfo, it.value(), &slideVariant))
+        return fileInfo;
+    QFileInfo variantInfo(slideVariant.sFilePath);
+    if(!variantInfo.exists())
+        return fileInfo;
+    return variantInfo;
+}
+
+
+/*!
+ * \brief FileServer::pinnedFile
+ * The file chosen by servedFile() for the first chunk of a <get> transfer
+ * is kept until the transfer ends: a scaled slide that becomes ready
+ * meanwhile does not mix its bytes with those of the original.
+ * \param pClient The requesting client
+ * \param sFileName The requested file
+ * \param bRestart true when the transfer starts (again) from the beginning
+ * \param pChanged Set to true when the pinned file has changed or disappeared:
+ * the transfer has to start again
+ * \return The file to send (not existing when there is none)
+ */
+QFileInfo
+FileServer::pinnedFile(QWebSocket* pClient, const QString& sFileName, bool bRestart, bool* pChanged) {
+    *pChanged = false;
+    QHash<QString, PinnedFile>& pins = pinnedFiles[pClient];
+    auto it = pins.find(sFileName);
+    if(bRestart || (it == pins.end())) {
+        QFileInfo fileInfo = servedFile(pClient, sFileName);
+        if(!fileInfo.exists()) {
+            pins.remove(sFileName);
+            return fileInfo;
+        }
+        if(!pins.contains(sFileName) && (pins.count() >= MAX_PINNED_FILES))
+            pins.erase(pins.begin()); // A transfer abandoned by the client
+        PinnedFile pin;
+        pin.sFilePath    = fileInfo.absoluteFilePath();
+        pin.size         = fileInfo.size();
+        pin.lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+        pins.insert(sFileName, pin);
+        return fileInfo;
+    }
+    QFileInfo fileInfo(it->sFilePath);
+    if(!fileInfo.exists()                                                  ||
+       (fileInfo.size() != it->size)                                       ||
+       (fileInfo.lastModified().toMSecsSinceEpoch() != it->lastModified))
+    {
+        pins.erase(it);
+        *pChanged = true;
+        return QFileInfo();
+    }
+    return fileInfo;
+}
+
+
+/*!
+ * \brief FileServer::notePinnedRange
+ * Record a range of the pinned file as read (or redirected to a peer):
+ * the pin is released when the whole file has been covered, so that the
+ * file can be deleted when it is a scaled slide no longer current.
+ * \param pClient The requesting client
+ * \param sFileName The requested file
+ * \param sFilePath The file actually read
+ * \param startPos The first byte of the range
+ * \param length The range length
+ */
+void
+FileServer::notePinnedRange(QWebSocket* pClient, const QString& sFileName, const QString& sFilePath,
+                            qint64 startPos, qint64 length) {
+    auto itClient = pinnedFiles.find(pClient);
+    if(itClient == pinnedFiles.end())
+        return;
+    auto it = itClient->find(sFileName);
+    if((it == itClient->end()) || (it->sFilePath != sFilePath))
+        return; // A transfer started again in the meantime
+    QVector<QPair<qint64, qint64>>& done = it->done;
+    qint64 endPos = startPos+length;
+    int i = 0;
+    while((i < done.count()) && (done.at(i).second < startPos))
+        i++;
+    while((i < done.count()) && (done.at(i).first <= endPos)) {
+        startPos = qMin(startPos, done.at(i).first);
+        endPos   = qMax(endPos, done.at(i).second);
+        done.remove(i);
+    }
+    done.insert(i, qMakePair(startPos, endPos));
+    if((done.count() == 1) && (done.first().first <= 0) && (done.first().second >= it->size)) {
+        itClient->erase(it);
+        if(itClient->isEmpty())
+            pinnedFiles.erase(itClient);
+    }
+}
+
+
+/*!
+ * \brief FileServer::purgeVariants
+ * Delete the scaled slides no longer current, unless a transfer
+ * (pinned or streamed) is still reading them
+ */
+void
+FileServer::purgeVariants() {
+    if(!pSlidePreprocessor || !pSlidePreprocessor->hasRetired())
+        return;
+    QSet<QString> inUse;
+    for(auto itClient=pinnedFiles.constBegin(); itClient!=pinnedFiles.constEnd(); ++itClient) {
+        for(auto it=itClient->constBegin(); it!=itClient->constEnd(); ++it)
+            inUse.insert(it->sFilePath);
+    }
+    for(auto it=streams.constBegin(); it!=streams.constEnd(); ++it)
+        inUse.insert(it->sFilePath);
+    pSlidePreprocessor->purgeRetired(inUse);
+}
+
+
+/*!
+ * \brief FileServer::httpResource
+ * Used by the HttpMediaServer: only the files in the manifest
+ * (and the slide bundle) can be requested.
+ * \param sFileName The requested file
+ * \param resolution The panel resolution: a slide scaled to it is sent
+ * when ready (with its own entity tag), the original otherwise
+ * \param pFileInfo Where to store the file to send
+ * \param pETag Where to store the entity tag of the file
+ * \return false if the file is not served
+ */
+bool
+FileServer::httpResource(const QString& sFileName, QSize resolution, QFileInfo* pFileInfo, QString* pETag) {
+    if(pSlideBundler && (sFileName == QString(SLIDE_BUNDLE_NAME))) {
+        if(bundle.size <= 0)
+            return false;
+        *pFileInfo = QFileInfo(bundle.sFilePath);
+        *pETag = QString("\"%1\"").arg(bundle.hash, 16, 16, QChar('0'));
+        return pFileInfo->exists();
+    }
+    int i = catalog.indexOf(sFileName);
+    if(i < 0)
+        return false;
+    *pFileInfo = QFileInfo(catalog.filePath(i));
+    if(!pFileInfo->exists())
+        return false;
+    SlideVariant slideVariant;
+    if(pSlidePreprocessor && resolution.isValid() &&
+       pSlidePreprocessor->variant(*pFileInfo, resolution, &slideVariant) &&
+       QFileInfo::exists(slideVariant.sFilePath))
+    {
+        *pFileInfo = QFileInfo(slideVariant.sFilePath);
+        *pETag = QString("\"%1\"").arg(slideVariant.hash, 16, 16, QChar('0'));
+        return true;
+    }
+    if(catalog.isHashed(i)                            &&
+       (catalog.size(i) == pFileInfo->size())        &&
+       (catalog.lastModified(i) == pFileInfo->lastModified().toMSecsSinceEpoch()))
+        *pETag = QString("\"%1\"").arg(catalog.hash(i), 16, 16, QChar('0'));
+    else // Not hashed yet
+        *pETag = QString("W/\"%1-%2\"")
+                 .arg(pFileInfo->size())
+                 .arg(pFileInfo->lastModified().toMSecsSinceEpoch());
+    return true;
+}
+
+
+/*!
+ * \brief FileServer::peerResolution
+ * \param address The address of an HTTP client
+ * \return The resolution declared by the panel connected from the
+ * same address (not valid if there is none)
+ */
+QSize
+FileServer::peerResolution(const QHostAddress& address) {
+    for(auto it=clientResolutions.constBegin(); it!=clientResolutions.constEnd(); ++it) {
+        if(it.key()->peerAddress().isEqual(address, QHostAddress::TolerantConversion))
+            return it.value();
+    }
+    return QSize();
+}
+
+
+/*!
+ * \brief FileServer::onSlideVariantReady
+ * A slide has been scaled: the panels with that resolution are
+ * told to fetch the new (smaller) version
+ */
+void
+FileServer::onSlideVariantReady(QString sSlidePath, QSize resolution) {
+    int i = catalog.indexOf(catalog.nameOf(sSlidePath));
+    if(i < 0) // Removed meanwhile
+        return;
+    noteManifestChange(catalog.name(i));
+    for(auto it=clientResolutions.constBegin(); it!=clientResolutions.constEnd(); ++it) {
+        if((it.value() != resolution) || !it.key()->isValid())
+            continue;
+        if(clientBudgets.contains(it.key())) // The new size may change its subset
+            sendFileList(it.key());
+        else
+            SendToOne(it.key(), QString("<file_added>%1</file_added>")
+                                .arg(manifestEntry(i, it.key())));
+    }
+}
+
+
+/*!
+ * \brief FileServer::onBundleReady
+ * Invoked by the SlideBundler when the bundle is up to date:
+ * the connected clients are told where to get it
+ */
+void
+FileServer::onBundleReady(QString sBundlePath, qint64 size, quint64 hash, qint64 tocOffset, int count) {
+    mappedFiles.invalidate(sBundlePath);
+    openFiles.invalidate(sBundlePath);
+    pChunkCache->invalidate(sBundlePath);
+    if(pMulticast)
+        pMulticast->forgetFile(QString(SLIDE_BUNDLE_NAME));
+    bundle.sFilePath = sBundlePath;
+    bundle.size      = size;
+    bundle.hash      = hash;
+    bundle.tocOffset = tocOffset;
+    bundle.count     = count;
+    SendToAll(bundleMessage());
+}
+
+
+/*!
+ * \brief FileServer::onBundleFailed
+ * Invoked by the SlideBundler when the bundle could not be updated:
+ * it no more matches the slides and is withdrawn until the next build
+ */
+void
+FileServer::onBundleFailed(QString sBundlePath) {
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               QString("%1 is not available").arg(sBundlePath));
+    if(bundle.size <= 0)
+        return;
+    bundle.size = 0;
+    SendToAll(bundleMessage());
+}
+
+
+/*!
+ * \brief FileServer::bundleMessage
+ * \return The <bundle>name;size;hash;tocOffset;count</bundle> message
+ * or <bundle>0</bundle> when the bundle is not (yet) available.
+ * The bundle is transferred with <stream> or <get> as any other file and
+ * a single slide can be read with a <get> of the byte range listed
+ * in the table of contents (see slidebundler.h).
+ */
+QString
+FileServer::bundleMessage() {
+    if(bundle.size <= 0)
+        return QString("<bundle>0</bundle>");
+    return QString("<bundle>%1;%2;%3;%4;%5</bundle>")
+           .arg(SLIDE_BUNDLE_NAME)
+           .arg(bundle.size)
+           .arg(bundle.hash, 16, 16, QChar('0'))
+           .arg(bundle.tocOffset)
+           .arg(bundle.count);
+}
+
+
+/*!
+ * \brief FileServer::setUpdateDeltas
+ * When enabled the served files are builds of the panel application and
+ * a panel can ask for the delta from the build it runs (see requestUpdate())
+ * \param bEnable Enable the deltas
+ */
+void
+FileServer::setUpdateDeltas(bool bEnable) {
+    bUpdateDeltas = bEnable;
+}
+
+
+/*!
+ * \brief FileServer::requestUpdate
+ * <send_update>name;hash</send_update>: the panel needs the build "name"
+ * and runs the build whose xxHash64 is "hash" (hex). When that build is
+ * still in the catalog the panel is told where to get the binary delta
+ * between the two, as soon as it is ready. The delta is built once
+ * for each pair of builds and shared by all the panels.
+ * \param pClient The requesting client
+ * \param sRequest The text of the request
+ */
+void
+FileServer::requestUpdate(QWebSocket* pClient, const QString& sRequest) {
+    QStringList fields = sRequest.split(QChar(';'));
+    QString sTarget = fields.at(0);
+    bool bBase = false;
+    quint64 baseHash = (fields.count() > 1) ? fields.at(1).toULongLong(&bBase, 16) : 0;
+    int target = catalog.indexOf(sTarget);
+    if(target < 0) {
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   serverName +
+                   QString(" Unknown build: %1").arg(sTarget));
+        return;
+    }
+    int base = bBase ? catalog.indexOfHash(baseHash) : -1;
+    if(!bUpdateDeltas || !catalog.isHashed(target) || (base < 0) || (base == target)) {
+        // The whole build
+        SendToOne(pClient, updateMessage(sTarget, baseHash, 0));
+        return;
+    }
+    quint64 targetHash = catalog.hash(target);
+    if(!pDeltaBuilder) {
+        QString sCacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+                            QString("/%1/deltas").arg(serverName);
+        pDeltaBuilder = new UpdateDeltaBuilder(sCacheDir, logFile, this);
+        connect(pDeltaBuilder, SIGNAL(deltaReady(quint64,quint64)),
+                this, SLOT(onUpdateDeltaReady(quint64,quint64)));
+    }
+    UpdateDelta delta;
+    if(pDeltaBuilder->delta(baseHash, targetHash, &delta)) {
+        SendToOne(pClient, updateMessage(sTarget, baseHash, targetHash));
+        return;
+    }
+    UpdateWaiter waiter;
+    waiter.pClient = pClient;
+    waiter.sTarget = sTarget;
+    updateWaiters[qMakePair(baseHash, targetHash)].append(waiter);
+    pDeltaBuilder->request(catalog.filePath(base), baseHash, catalog.filePath(target), targetHash);
+}
+
+
+/*!
+ * \brief FileServer::updateMessage
+ * \param sTarget The requested build
+ * \param baseHash The build the panel runs
+ * \param targetHash The hash of the requested build (0 = no delta)
+ * \return <update>name;baseHash;deltaName;deltaSize</update> where deltaName
+ * is requested with <get> or <stream> as any other file, or
+ * <update>name;baseHash;0</update> when the whole build has to be sent
+ */
+QString
+FileServer::updateMessage(const QString& sTarget, quint64 baseHash, quint64 targetHash) {
+    UpdateDelta delta;
+    if((targetHash == 0) || !pDeltaBuilder  ||
+       !pDeltaBuilder->delta(baseHash, targetHash, &delta) ||
+       delta.sFilePath.isEmpty())
+    {
+        return QString("<update>%1;%2;0</update>")
+               .arg(sTarget)
+               .arg(baseHash, 16, 16, QChar('0'));
+    }
+    QString sDeltaName = QString("%1.%2.vcdelta")
+                         .arg(sTarget)
+                         .arg(baseHash, 16, 16, QChar('0'));
+    updateDeltas.insert(sDeltaName, delta.sFilePath);
+    return QString("<update>%1;%2;%3;%4</update>")
+           .arg(sTarget)
+           .arg(baseHash, 16, 16, QChar('0'))
+           .arg(sDeltaName)
+           .arg(delta.size);
+}
+
+
+/*!
+ * \brief FileServer::forgetUpdateDeltas
+ * The deltas to or from a build that changed or has been removed
+ * are no longer served: the panels ask again for the new build
+ * \param sFilePath The full path of the build
+ */
+void
+FileServer::forgetUpdateDeltas(const QString& sFilePath) {
+    const QString sName = catalog.nameOf(sFilePath);
+    int i = catalog.indexOf(sName);
+    bool bHashed = (i >= 0) && catalog.isHashed(i);
+    quint64 hash = bHashed ? catalog.hash(i) : 0;
+    // <target>.<base hash>.vcdelta
+    QString sBaseSuffix = QString(".%1.vcdelta").arg(hash, 16, 16, QChar('0'));
+    int deltaNameLength = sName.length() + sBaseSuffix.length();
+    for(auto it=updateDeltas.begin(); it!=updateDeltas.end(); ) {
+        const QString& sDeltaName = it.key();
+        bool bTarget = (sDeltaName.length() == deltaNameLength) && sDeltaName.startsWith(sName + QString("."));
+        bool bBase   = bHashed && sDeltaName.endsWith(sBaseSuffix);
+        if(bTarget || bBase)
+            it = updateDeltas.erase(it);
+        else
+            ++it;
+    }
+    if(!bHashed || !pDeltaBuilder)
+        return;
+    // The same build may still be served with another name
+    for(int j=0; j<catalog.count(); j++) {
+        if((j != i) && catalog.isHashed(j) && (catalog.hash(j) == hash))
+            return;
+    }
+    pDeltaBuilder->forgetBuild(hash);
+}
+
+
+/*!
+ * \brief FileServer::onUpdateDeltaReady
+ * A delta has been built (or has failed): the panels waiting
+ * for it are told what to download
+ */
+void
+FileServer::onUpdateDeltaReady(quint64 baseHash, quint64 targetHash) {
+    const QList<UpdateWaiter> waiters = updateWaiters.take(qMakePair(baseHash, targetHash));
+    for(const UpdateWaiter& waiter : waiters) {
+        int target = catalog.indexOf(waiter.sTarget);
+        bool bCurrent = (target >= 0) && catalog.isHashed(target) && (catalog.hash(target) == targetHash);
+        // The build may have been replaced meanwhile: the panel will ask again
+        SendToOne(waiter.pClient, updateMessage(waiter.sTarget, baseHash, bCurrent ? targetHash : 0));
+    }
+}
+
+
+/*!
+ * \brief FileServer::setSlideBundle
+ * When enabled the slides are packed in a bundle that
+ * the clients can get with a single transfer.
+ * To be called before setDir()
+ * \param bEnable Enable the bundle
+ */
+void
+FileServer::setSlideBundle(bool bEnable) {
+    if(!bEnable || pSlideBundler)
+        return;
+    QString sBundleFile = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+                          QString("/%1/%2").arg(serverName, SLIDE_BUNDLE_NAME);
+    pSlideBundler = new SlideBundler(sBundleFile, logFile);
+    // The bundle is built by the same (low priority) thread of the hashes
+    pSlideBundler->moveToThread(pHashThread);
+    connect(this, SIGNAL(buildBundle(QString,QStringList)),
+            pSlideBundler, SLOT(onBuildBundle(QString,QStringList)));
+    connect(pSlideBundler, SIGNAL(bundleReady(QString,qint64,quint64,qint64,int)),
+            this, SLOT(onBundleReady(QString,qint64,quint64,qint64,int)));
+    connect(pSlideBundler, SIGNAL(bundleFailed(QString)),
+            this, SLOT(onBundleFailed(QString)));
+}
+
+
+/*!
+ * \brief FileServer::setHost
+ * Called by the MediaServer hosting this server as one of its namespaces:
+ * the clients are handed over by the MediaServer, the disk reads
+ * share its threads and its chunk cache and the transfers its slots.
+ * \param pSharedPool The reader threads of the MediaServer
+ * \param pSharedCache The chunk cache of the MediaServer
+ * \param pSharedSlots The transfer slots of the MediaServer
+ */
+void
+FileServer::setHost(QThreadPool* pSharedPool, ChunkCache* pSharedCache, TransferSlots* pSharedSlots) {
+    bHosted = true;
+    if(pReaderPool->parent() == this)
+        delete pReaderPool;
+    pReaderPool = pSharedPool;
+    pChunkCache = pSharedCache;
+    localChunkCache.setMaxSize(0);
+    pTransferSlots = pSharedSlots;
+}
+
+
+/*!
+ * \brief FileServer::setMappedMode
+ * Off by default. A mapped file truncated while a chunk is being copied
+ * out of the mapping (e.g. replaced in place with cp, which truncates
+ * the file before writing it) raises SIGBUS and the whole controller
+ * is killed: the size check done before the copy cannot prevent it.
+ * Enable it only when the media are replaced by renaming the new files
+ * over the old ones. Even then the files modified in the last
+ * MAPPED_MIN_AGE seconds are read and not mapped (see MappedFileCache).
+ * \param bMapped When true the files are memory mapped once and the
+ * requested chunks are sliced out of the mapping. When false every
+ * chunk is read from the file, that is kept open between the reads.
+ */
+void
+FileServer::setMappedMode(bool bMapped) {
+    bMapFiles = bMapped;
+    if(!bMapFiles)
+        mappedFiles.clear();
+}
+
+
+/*!
+ * \brief FileServer::setChunkCacheSize
+ * \param maxBytes The memory reserved to the chunks shared among the clients
+ * (0 disables the chunk cache)
+ */
+void
+FileServer::setChunkCacheSize(qint64 maxBytes) {
+    pChunkCache->setMaxSize(maxBytes);
+}
+
+
+/*!
+ * \brief FileServer::chunkCacheStatistics
+ * \return A human readable summary of the chunk cache counters
+ */
+QString
+FileServer::chunkCacheStatistics() const {
+    return QString("Chunk cache: %1 hits, %2 misses, %3 merged reads, %4/%5 bytes")
+           .arg(pChunkCache->hits())
+           .arg(pChunkCache->misses())
+           .arg(pChunkCache->merged())
+           .arg(pChunkCache->size())
+           .arg(pChunkCache->maxSize());
+}
+
+
+/*!
+ * \brief FileServer::setReaderThreads
+ * \param nThreads The number of threads reading the files for the clients
+ */
+void
+FileServer::setReaderThreads(int nThreads) {
+    pReaderPool->setMaxThreadCount(qMax(1, nThreads));
+}
+
+
+/*!
+ * \brief FileServer::setSlideScaling
+ * When enabled the slides are scaled to the resolution declared
+ * by each panel with <resolution>WxH</resolution>.
+ * To be called before setDir()
+ * \param bScale Enable the scaling
+ */
+void
+FileServer::setSlideScaling(bool bScale) {
+    bScaleSlides = bScale;
+}
+
+
+/*!
+ * \brief FileServer::readChunk
+ * The chunk is looked up in the chunk cache first. On a miss it is
+ * copied out of the file mapping or, when the file cannot be mapped,
+ * read from the file.
+ * It is called from the reader threads.
+ * \param sFilePath The full path of the requested file
+ * \param lastModified The file modification time (msecs since epoch)
+ * \param startPos The first byte requested
+ * \param length The number of bytes requested
+ * \return The requested data or an empty QByteArray on errors
+ */
+QByteArray
+FileServer::readChunk(const QString& sFilePath, qint64 lastModified, qint64 startPos, qint64 length) {
+    ChunkKey key;
+    key.sFilePath    = sFilePath;
+    key.startPos     = startPos;
+    key.length       = length;
+    key.lastModified = lastModified;
+    return pChunkCache->chunk(key, [this, sFilePath, startPos, length]() {
+        if(bMapFiles) {
+            QByteArray ba = mappedFiles.chunk(sFilePath, startPos, length);
+            if(!ba.isEmpty())
+                return ba;
+            // Unable to map the file: fall back to a plain read
+        }
+        return openFiles.chunk(sFilePath, startPos, length);
+    });
+}
+
+
+/*!
+ * \brief FileServer::readChunkAsync
+ * Dispatch the read of a chunk to the reader threads.
+ * The result is delivered to onChunkRead() in the FileServer thread.
+ * The reads of the files needed sooner are done first.
+ * \param request The chunk to read
+ */
+void
+FileServer::readChunkAsync(const ChunkRequest& request) {
+    startReader(request, -request.playRank);
+    prefetchChunks(request);
+}
+
+
+/*!
+ * \brief FileServer::startReader
+ * Queue a read in the reader threads, that may be shared with the
+ * other namespaces of a MediaServer: the reads of this server are
+ * counted so that it can wait for them alone when it closes.
+ * \param request The chunk to read
+ * \param priority The priority in the reader pool
+ */
+void
+FileServer::startReader(const ChunkRequest& request, int priority) {
+    readerMutex.lock();
+    nReaders++;
+    readerMutex.unlock();
+    pReaderPool->start(new ChunkReader(this, request), priority);
+}
+
+
+/*!
+ * \brief FileServer::readerDone
+ * Called by a reader thread when one of our reads has ended (or has been
+ * dropped because the server is closing)
+ */
+void
+FileServer::readerDone() {
+    QMutexLocker locker(&readerMutex);
+    if(--nReaders == 0)
+        readersDone.wakeAll();
+}
+
+
+/*!
+ * \brief FileServer::waitForReaders
+ * Drop the reads still queued and wait for the running ones.
+ * There is no time limit: a reader uses the caches and the
+ * FileServer itself until it ends.
+ */
+void
+FileServer::waitForReaders() {
+    bClosing = true;
+    QMutexLocker locker(&readerMutex);
+    while(nReaders > 0)
+        readersDone.wait(&readerMutex);
+}
+
+
+/*!
+ * \brief FileServer::prefetchChunks
+ * When a client reads a file sequentially the next chunks are read
+ * ahead into the chunk cache, after all the requested reads, so that
+ * the next requests do not wait for the disk.
+ * \param request The chunk just requested
+ */
+void
+FileServer::prefetchChunks(const ChunkRequest& request) {
+    if((prefetchDepth == 0) || (pChunkCache->maxSize() == 0))
+        return;
+    QWebSocket* pClient = request.pClient.data();
+    if(!pClient)
+        return;
+    SequentialState& sequence = sequences[pClient];
+    if((sequence.sFilePath == request.sFilePath) && (sequence.nextPos == request.startPos)) {
+        sequence.runLength++;
+    }
+    else {
+        sequence.sFilePath    = request.sFilePath;
+        sequence.runLength    = 0;
+        sequence.prefetchedTo = request.startPos+request.length;
+    }
+    sequence.nextPos = request.startPos+request.length;
+    if(sequence.runLength < PREFETCH_MIN_RUN)
+        return;
+
+    qint64 endPos = qMin(request.fileSize, sequence.nextPos+prefetchDepth*request.length);
+    qint64 startPos = qMax(sequence.prefetchedTo, sequence.nextPos);
+    while(startPos < endPos) {
+        ChunkRequest prefetch = request;
+        prefetch.pClient   = nullptr;
+        prefetch.startPos  = startPos;
+        prefetch.requestId = 0;
+        prefetch.bTagged   = false;
+        prefetch.bStream   = false;
+        prefetch.bPrefetch = true;
+        // The same length of the requests so that they hit the cache
+        startReader(prefetch, PREFETCH_PRIORITY-request.playRank);
+        startPos += request.length;
+    }
+    sequence.prefetchedTo = startPos;
+}
+
+
+/*!
+ * \brief FileServer::adviseWillNeed
+ * Ask the kernel to read a range of a file in background.
+ * Called by the reader threads.
+ */
+void
+FileServer::adviseWillNeed(const QString& sFilePath, qint64 startPos, qint64 length) {
+    if(bMapFiles && mappedFiles.willNeed(sFilePath, startPos, length))
+        return;
+#if defined(Q_OS_LINUX)
+    QFile file(sFilePath);
+    if(!file.open(QIODevice::ReadOnly))
+        return;
+    // The pages stay in the page cache after the file is closed
+    posix_fadvise(file.handle(), startPos, length, POSIX_FADV_WILLNEED);
+    file.close();
+#else
+    Q_UNUSED(sFilePath)
+    Q_UNUSED(startPos)
+    Q_UNUSED(length)
+#endif
+}
+
+
+/*!
+ * \brief FileServer::onChunkRead
+ * Invoked in the FileServer thread when a reader thread has done its job
+ * \param request The request with the data read
+ */
+void
+FileServer::onChunkRead(const ChunkRequest& request) {
+    if(request.bMulticast) {
+        if(pMulticast)
+            pMulticast->onBlockRead(request);
+        return;
+    }
+    QWebSocket* pClient = request.pClient.data();
+    if(!pClient || !connections.contains(pClient))
+        return; // The client has gone in the meantime
+    if(request.bStream) {
+        onStreamChunkRead(pClient, request);
+        return;
+    }
+    auto itReads = pendingReads.find(pClient);
+    if((itReads != pendingReads.end()) && (--itReads.value() <= 0))
+        pendingReads.erase(itReads);
+    if(request.data.isEmpty()) {// Read error !
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("Error reading %1 at %2")
+                   .arg(request.sFileName)
+                   .arg(request.startPos));
+        if(request.bTagged)
+            SendToOne(pClient, QString("<chunk_error>%1,%2,%3,%4</chunk_error>")
+                               .arg(request.sFileName)
+                               .arg(request.startPos)
+                               .arg(request.length)
+                               .arg(request.requestId));
+        return;
+    }
+    notePinnedRange(pClient, request.sFileName, request.sFilePath,
+                    request.startPos, request.data.size());
+    notePeerSent(pClient, request);
+    if(pClient->isValid()) {
+        sendFrame(pClient, frameChunk(pClient, request), request.playRank);
+    }
+    else { // Client disconnected
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("Client disconnected while sending %1")
+                   .arg(request.sFileName));
+    }
+}
+
+
+/*!
+ * \brief FileServer::sendFrame
+ * Send a binary message through the rate limiters: when the client or
+ * the global limit is exceeded the message is queued and sent later
+ * \param pClient The destination
+ * \param frame The message
+ * \param rank The position of the file in the play order
+ */
+void
+FileServer::sendFrame(QWebSocket* pClient, const QByteArray& frame, int rank) {
+    PendingFrame pending;
+    pending.frame    = frame;
+    pending.playRank = rank;
+    pendingFrames[pClient].enqueue(pending);
+    queuedFrames++;
+    queuedBytes += frame.size();
+    onFlushFrames();
+}
+
+
+/*!
+ * \brief FileServer::onFlushFrames
+ * Send the queued binary messages allowed by the rate limiters.
+ * The clients are served in turn, one message each, starting from
+ * those waiting for the files that will be played sooner.
+ */
+void
+FileServer::onFlushFrames() {
+    qint64 wait = -1;
+    QVector<QWebSocket*> servedClients;
+    QVector<QPair<int, QWebSocket*>> turns;
+    bool bProgress = true;
+    while(bProgress) {
+        bProgress = false;
+        turns.clear();
+        for(auto it=pendingFrames.constBegin(); it!=pendingFrames.constEnd(); ++it) {
+            if(!it->isEmpty())
+                turns.append(qMakePair(it->head().playRank, it.key()));
+        }
+        std::stable_sort(turns.begin(), turns.end(),
+                         [](const QPair<int, QWebSocket*>& a, const QPair<int, QWebSocket*>& b) {
+                             return a.first < b.first;
+                         });
+        for(const auto& turn : qAsConst(turns)) {
+            QWebSocket* pClient = turn.second;
+            auto it = pendingFrames.find(pClient);
+            TokenBucket* pBucket = clientBuckets.value(pClient);
+            if(pBucket && !pBucket->isAvailable()) {
+                qint64 clientWait = pBucket->msecsToAvailable();
+                wait = (wait < 0) ? clientWait : qMin(wait, clientWait);
+                continue;
+            }
+            if(pGlobalBucket && !pGlobalBucket->tryConsume(it->head().frame.size())) {
+                qint64 globalWait = pGlobalBucket->msecsToAvailable();
+                wait = (wait < 0) ? globalWait : qMin(wait, globalWait);
+                bProgress = false;
+                break;
+            }
+            QByteArray frame = it->dequeue().frame;
+            queuedFrames--;
+            queuedBytes -= frame.size();
+            if(pBucket)
+                pBucket->consume(frame.size());
+            if(pClient->isValid()) {
+                qint64 bytesSent = pClient->sendBinaryMessage(frame);
+                if(bytesSent != frame.size()) {
+                    logMessage(logFile,
+                               Q_FUNC_INFO,
+                               serverName +
+                               QString(" Unable to send %1 bytes to %2")
+                               .arg(frame.size())
+                               .arg(pClient->peerAddress().toString()));
+                }
+                sentBytes += bytesSent;
+            }
+            if(!servedClients.contains(pClient))
+                servedClients.append(pClient);
+            bProgress = true;
+        }
+    }
+    for(auto it=pendingFrames.begin(); it!=pendingFrames.end(); ) {
+        if(it->isEmpty())
+            it = pendingFrames.erase(it);
+        else
+            ++it;
+    }
+    if((wait >= 0) && pShapingTimer && !pShapingTimer->isActive())
+        pShapingTimer->start(int(qBound(qint64(1), wait, qint64(SHAPING_MAX_WAIT))));
+    // The streams held back can go on
+    for(QWebSocket* pClient : qAsConst(servedClients)) {
+        if(connections.contains(pClient))
+            pumpStream(pClient);
+    }
+}
+
+
+/*!
+ * \brief FileServer::setGlobalLimiter
+ * \param pBucket The rate limiter shared by all the servers (may be nullptr)
+ * To be called before the server starts
+ */
+void
+FileServer::setGlobalLimiter(TokenBucket* pBucket) {
+    pGlobalBucket = pBucket;
+}
+
+
+/*!
+ * \brief FileServer::onSetClientRate
+ * Change the transfer rate allowed to each client
+ * \param bytesPerSecond The new rate (0 means unlimited)
+ */
+void
+FileServer::onSetClientRate(qint64 bytesPerSecond) {
+    clientRate = bytesPerSecond;
+    for(TokenBucket* pBucket : qAsConst(clientBuckets))
+        pBucket->setRate(clientRate);
+    if(pHttpServer)
+        pHttpServer->setClientRate(clientRate);
+    // A looser limit may let the queued messages go
+    onFlushFrames();
+}
+
+
+/*!
+ * \brief FileServer::onUpdateTransferStatistics
+ * Measure the current transfer rate
+ */
+void
+FileServer::onUpdateTransferStatistics() {
+    qint64 elapsed = statsClock.restart();
+    if(elapsed <= 0)
+        return;
+    qint64 sent = sentBytes;
+    currentRate = (sent-lastSentBytes)*1000/elapsed;
+    lastSentBytes = sent;
+    updateLinks(elapsed);
+    releaseIdleTransfers();
+    purgeVariants();
+    for(auto it=peers.begin(); it!=peers.end(); ++it)
+        it->load = 0;
+#ifdef LOG_VERBOSE
+    if((currentRate > 0) || (queuedFrames > 0))
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   serverName +
+                   QString(" ") +
+                   transferStatistics());
+#endif
+}
+
+
+/*!
+ * \brief FileServer::updateLinks
+ * Update the goodput estimate of each client and probe its round trip time.
+ * The intervals in which the socket had nothing to send measure the
+ * server rather than the link: they can only raise the estimate.
+ * The clients that asked for it are told when the advised chunk size changes.
+ * \param elapsed The time since the last update (ms)
+ */
+void
+FileServer::updateLinks(qint64 elapsed) {
+    for(auto it=links.begin(); it!=links.end(); ++it) {
+        QWebSocket* pClient = it.key();
+        qint64 sample = it->writtenBytes*1000/elapsed;
+        bool bBacklogged = pClient->bytesToWrite() > 0;
+        if((it->writtenBytes >= LINK_MIN_SAMPLE) && (bBacklogged || (sample > it->goodput)))
+            it->goodput = (it->goodput == 0) ? sample : (3*it->goodput+sample)/4;
+        it->writtenBytes = 0;
+        if(!pClient->isValid())
+            continue;
+        pClient->ping();
+        if(!it->bHintWanted)
+            continue;
+        qint64 hint = chunkHint(pClient);
+        if((hint > 0) && ((hint >= 2*it->chunkHint) || (2*hint <= it->chunkHint))) {
+            it->chunkHint = hint;
+            SendToOne(pClient, chunkHintMessage(pClient));
+        }
+    }
+}
+
+
+/*!
+ * \brief FileServer::chunkHint
+ * The chunk should take about LINK_CHUNK_TIME to cross the link: large on
+ * fast links, small on the marginal ones where big frames stall.
+ * \param pClient The client
+ * \return The advised chunk size (0 when the link is not known yet)
+ */
+qint64
+FileServer::chunkHint(QWebSocket* pClient) const {
+    const LinkState link = links.value(pClient);
+    if(link.goodput == 0)
+        return 0;
+    qint64 size = link.goodput*LINK_CHUNK_TIME/1000;
+    if(link.rtt > LINK_HIGH_RTT)
+        size /= 2;
+    // Round down to a power of two
+    qint64 hint = minChunkSize;
+    while((hint*2 <= size) && (hint*2 <= maxChunkSize))
+        hint *= 2;
+    return hint;
+}
+
+
+/*!
+ * \brief FileServer::chunkHintMessage
+ * \return The <chunk_hint>chunkSize,goodput,rtt</chunk_hint> message
+ * (the default chunk size while the link is not known)
+ */
+QString
+FileServer::chunkHintMessage(QWebSocket* pClient) const {
+    const LinkState link = links.value(pClient);
+    qint64 hint = chunkHint(pClient);
+    if(hint == 0)
+        hint = qBound(minChunkSize, qint64(STREAM_CHUNK_SIZE), maxChunkSize);
+    return QString("<chunk_hint>%1,%2,%3</chunk_hint>")
+           .arg(hint)
+           .arg(link.goodput)
+           .arg(link.rtt);
+}
+
+
+/*!
+ * \brief FileServer::onClientPong
+ * Smooth the round trip time of the client
+ */
+void
+FileServer::onClientPong(quint64 elapsedTime, const QByteArray& payload) {
+    Q_UNUSED(payload)
+    auto* pClient = qobject_cast<QWebSocket *>(sender());
+    auto it = links.find(pClient);
+    if(it == links.end())
+        return;
+    qint64 rtt = qint64(elapsedTime);
+    it->rtt = (it->rtt == 0) ? rtt : (7*it->rtt+rtt)/8;
+}
+
+
+/*!
+ * \brief FileServer::transferStatistics
+ * It can be called from any thread
+ * \return The current transfer rate and the messages held by the rate limiters
+ */
+QString
+FileServer::transferStatistics() const {
+    return QString("Rate: %1 KB/s Queued: %2 messages (%3 KB) Redirected: %4 requests")
+           .arg(currentRate.load()/1024)
+           .arg(queuedFrames.load())
+           .arg(queuedBytes.load()/1024)
+           .arg(redirectedRequests.load());
+}
+
+
+/*!
+ * \brief FileServer::onStartServer Invoked to start listening for connections
+ */
+void
+FileServer::onStartServer() {
+    bClosing = false;
+    if(!bHosted) {
+        if(port == 0) {
+            logMessage(logFile,
+                       Q_FUNC_INFO,
+                       serverName +
+                       QString(" Error! Server port not set."));
+            emit fileServerDone(true);// Close with errors
+            return;
+        }
+        prepareServer(port);
+        connect(this, SIGNAL(newConnection(QWebSocket*)),
+                this, SLOT(onNewConnection(QWebSocket*)));
+        connect(this, SIGNAL(netServerError(QWebSocketProtocol::CloseCode)),
+                this, SLOT(onFileServerError(QWebSocketProtocol::CloseCode)));
+    }
+
+    pShapingTimer = new QTimer(this);
+    pShapingTimer->setSingleShot(true);
+    connect(pShapingTimer, SIGNAL(timeout()),
+            this, SLOT(onFlushFrames()));
+    pStatsTimer = new QTimer(this);
+    connect(pStatsTimer, SIGNAL(timeout()),
+            this, SLOT(onUpdateTransferStatistics()));
+    statsClock.start();
+    pStatsTimer->start(TRANSFER_STATS_INTERVAL);
+
+    if(httpPort != 0) {
+        pHttpServer = new HttpMediaServer(this, logFile, this);
+        if(!pHttpServer->listen(httpPort)) {
+            delete pHttpServer;
+            pHttpServer = nullptr;
+        }
+    }
+
+    if(multicastPort != 0) {
+        pMulticast = new MulticastSender(this, logFile, this);
+        pMulticast->setRate(multicastRate);
+        pMulticast->setGlobalLimiter(pGlobalBucket);
+        if(!pMulticast->start(multicastGroup, multicastPort)) {
+            delete pMulticast;
+            pMulticast = nullptr;
+        }
+    }
+}
+
+
+/*!
+ * \brief FileServer::onFileServerError
+ */
+void
+FileServer::onFileServerError(QWebSocketProtocol::CloseCode code) {
+    Q_UNUSED(code)
+#ifdef LOG_VERBOSE
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               QString("code=%1").arg(code));
+#endif
+    for(int i=0; i<connections.count(); i++) {
+        if(connections.at(i)) {
+            if(connections.at(i)->isValid())
+                connections.at(i)->close();
+            connections.at(i)->disconnect();
+            delete connections.at(i);
+        }
+    }
+    connections.clear();
+    streams.clear();
+    clientResolutions.clear();
+    clientBudgets.clear();
+    budgetChanged.clear();
+    clientFraming.clear();
+    pinnedFiles.clear();
+    clientManifestEncoding.clear();
+    peers.clear();
+    links.clear();
+    sequences.clear();
+    pTransferSlots->cancel(this);
+    pTransferSlots->release(activeTransfers.count());
+    activeTransfers.clear();
+    waitingClients.clear();
+    qDeleteAll(clientBuckets);
+    clientBuckets.clear();
+    pendingFrames.clear();
+    pendingReads.clear();
+    queuedFrames = 0;
+    queuedBytes  = 0;
+    emit fileServerDone(true);// Close File Server with errors !
+}
+
+
+/*!
+ * \brief FileServer::onNewConnection
+ * Invoked upon a new connection has been detected
+ * \param pClient The websocket of the connected client
+ */
+void
+FileServer::onNewConnection(QWebSocket *pClient) {
+    int nConnections = connections.count();
+#ifdef LOG_VERBOSE
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               serverName +
+               QString("Connection requests from %1")
+               .arg(pClient->peerAddress().toString()));
+#endif
+    // Several simulated panels may run on this host (see setPeerLoopback())
+    bool bLoopback = bPeerLoopback && pClient->peerAddress().isLoopback();
+    for(int i=nConnections-1; i>=0 && !bLoopback; i--) {
+        if(connections.at(i)->peerAddress() == pClient->peerAddress()) {
+            logMessage(logFile,
+                       Q_FUNC_INFO,
+                       serverName +
+                       QString("Duplicate requests from %1")
+                       .arg(pClient->peerAddress().toString()));
+            if(connections.at(i)->isValid() && pClient->isValid()) {
+                logMessage(logFile,
+                           Q_FUNC_INFO,
+                           serverName +
+                           QString(" Both sockets are valid! Removing the old connection"));
+                connections.at(i)->disconnect();
+                connections.at(i)->abort();
+                forgetClient(connections.at(i));
+                delete connections.at(i);
+                connections.removeAt(i);
+                break;
+            }
+            if(pClient->isValid()) {
+                logMessage(logFile,
+                           Q_FUNC_INFO,
+                           serverName +
+                           QString(" Only present socket is valid. Removing the old one"));
+                connections.at(i)->disconnect();
+                connections.at(i)->abort();
+                forgetClient(connections.at(i));
+                delete connections.at(i);
+                connections.removeAt(i);
+            }
+            else {
+                logMessage(logFile,
+                           Q_FUNC_INFO,
+                           serverName +
+                           QString(" Present socket is not valid."));
+                pClient->disconnect();
+                pClient->close(QWebSocketProtocol::CloseCodeNormal,
+                               QString("Duplicated request"));
+                delete pClient;
+                pClient = nullptr;
+                return;
+            }
+            break;
+        }// if(connections.at(i)->peerAddress() == pClient->peerAddress())
+    }// for(int i=nConnections-1; i>=0; i--)
+#ifdef LOG_VERBOSE
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               serverName +
+               QString(" Client connected: %1")
+               .arg(pClient->peerAddress().toString()));
+#endif
+    connections.append(pClient);
+    clientBuckets.insert(pClient, new TokenBucket(clientRate));
+    LinkState link;
+    link.writtenBytes = 0;
+    link.goodput      = 0;
+    link.rtt          = 0;
+    link.chunkHint    = 0;
+    link.bHintWanted  = false;
+    links.insert(pClient, link);
+
+    connect(pClient, SIGNAL(textMessageReceived(QString)),
+            this, SLOT(onProcessTextMessage(QString)));
+    connect(pClient, SIGNAL(binaryMessageReceived(QByteArray)),
+            this, SLOT(onProcessBinaryMessage(QByteArray)));
+    connect(pClient, SIGNAL(disconnected()),
+            this, SLOT(onClientDisconnected()));
+    connect(pClient, SIGNAL(bytesWritten(qint64)),
+            this, SLOT(onClientBytesWritten(qint64)));
+    connect(pClient, SIGNAL(pong(quint64,QByteArray)),
+            this, SLOT(onClientPong(quint64,QByteArray)));
+    connect(pClient, SIGNAL(error(QAbstractSocket::SocketError)),
+            this, SLOT(onClientSocketError(QAbstractSocket::SocketError)));
+}
+
+
+/*!
+ * \brief FileServer::onClientSocketError
+ * \param error
+ */
+void
+FileServer::onClientSocketError(QAbstractSocket::SocketError error) {
+    Q_UNUSED(error)
+    auto *pClient = qobject_cast<QWebSocket *>(sender());
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               serverName +
+               QString(" %1 Error %2 %3")
+               .arg(pClient->peerAddress().toString())
+               .arg(error)
+               .arg(pClient->errorString()));
+    pClient->disconnect();
+    pClient->abort();
+    forgetClient(pClient);
+    if(!connections.removeOne(pClient)) {
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   serverName +
+                   QString(" Unable to remove %1 from list !")
+                   .arg(pClient->peerAddress().toString()));
+    }
+    delete pClient;
+    pClient = nullptr;
+}
+
+
+/*!
+ * \brief FileServer::onProcessTextMessage
+ * Process the requests from the clients
+ * \param sMessage
+ */
+void
+FileServer::onProcessTextMessage(QString sMessage) {
+    // The pointer is valid only during the execution of the slot
+    // that calls this function from this object's thread context.
+    auto *pClient = qobject_cast<QWebSocket *>(sender());
+    if(!pClient)
+        return;
+    if(!admitRequest(pClient, sMessage))
+        return; // Deferred until the client is admitted
+    processTextMessage(pClient, std::move(sMessage));
+}
+
+
+/*!
+ * \brief FileServer::admitRequest
+ * Only a limited number of clients at a time are served (the limit is
+ * shared by all the namespaces of a MediaServer): the transfer requests
+ * of the others are deferred and they are told their position in the
+ * queue with <queued>N</queued>. The queue is kept by the TransferSlots,
+ * in order of arrival whatever the namespace. <queued>0</queued> means that the
+ * client has been admitted and its deferred requests are being served.
+ * The other requests are always served. At most ADMISSION_MAX_DEFERRED
+ * requests are kept for a waiting client: the panels ask again the
+ * chunks they have not received.
+ * \param pClient The requesting client
+ * \param sMessage The request
+ * \return true if the request can be served now
+ */
+bool
+FileServer::admitRequest(QWebSocket* pClient, const QString& sMessage) {
+    if(pTransferSlots->limit() == 0)
+        return true;
+    bool bTransfer = sMessage.contains(QString("<get>")) ||
+                     sMessage.contains(QString("<stream>"));
+    auto active = activeTransfers.find(pClient);
+    if(active != activeTransfers.end()) {
+        if(bTransfer)
+            *active = admissionClock.elapsed();
+        return true;
+    }
+    bool bStreamControl = sMessage.contains(QString("<credit>")) ||
+                          sMessage.contains(QString("<stream_stop>"));
+    for(int i=0; i<waitingClients.count(); i++) {
+        if(waitingClients.at(i).pClient != pClient)
+            continue;
+        if(!bTransfer && !bStreamControl)
+            return true;
+        if(waitingClients.at(i).requests.count() >= ADMISSION_MAX_DEFERRED) {
+            logMessage(logFile,
+                       Q_FUNC_INFO,
+                       serverName +
+                       QString(" Too many requests from the waiting %1: dropped")
+                       .arg(pClient->peerAddress().toString()));
+            return false;
+        }
+        // Keep the order of the requests
+        waitingClients[i].requests.append(sMessage);
+        return false;
+    }
+    if(!bTransfer)
+        return true;
+    if(pTransferSlots->tryAcquire(this, pClient)) {
+        activeTransfers.insert(pClient, admissionClock.elapsed());
+        return true;
+    }
+    WaitingClient waiting;
+    waiting.pClient  = pClient;
+    waiting.requests.append(sMessage);
+    waitingClients.append(waiting);
+    int position = pTransferSlots->position(this, pClient);
+    if(position > 0) // Else the place is already granted
+        SendToOne(pClient, QString("<queued>%1</queued>").arg(position));
+#ifdef LOG_VERBOSE
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               serverName +
+               QString(" %1 queued at position %2")
+               .arg(pClient->peerAddress().toString())
+               .arg(position));
+#endif
+    return false;
+}
+
+
+/*!
+ * \brief FileServer::releaseIdleTransfers
+ * The clients with nothing to receive for a while leave their place.
+ * Called periodically.
+ */
+void
+FileServer::releaseIdleTransfers() {
+    if(activeTransfers.isEmpty())
+        return;
+    qint64 now = admissionClock.elapsed();
+    for(auto it=activeTransfers.begin(); it!=activeTransfers.end(); ) {
+        QWebSocket* pClient = it.key();
+        if(streams.contains(pClient)        ||
+           pendingFrames.contains(pClient)  ||
+           (pClient->bytesToWrite() > 0))
+        {
+            *it = now; // Still busy
+            ++it;
+        }
+        else if(now-*it > ADMISSION_IDLE_TIME) {
+            it = activeTransfers.erase(it);
+            pTransferSlots->release();
+        }
+        else
+            ++it;
+    }
+}
+
+
+/*!
+ * \brief FileServer::onTransferSlotGranted
+ * Invoked (queued) by the TransferSlots when the turn of a client
+ * waiting here has come: its deferred requests are served
+ * \param pClient The admitted client
+ */
+void
+FileServer::onTransferSlotGranted(QWebSocket* pClient) {
+    int i = 0;
+    while((i < waitingClients.count()) && (waitingClients.at(i).pClient != pClient))
+        i++;
+    if((i == waitingClients.count()) || !connections.contains(pClient)) {
+        pTransferSlots->release(); // Gone in the meantime
+        return;
+    }
+    WaitingClient waiting = waitingClients.takeAt(i);
+    activeTransfers.insert(pClient, admissionClock.elapsed());
+    SendToOne(pClient, QString("<queued>0</queued>"));
+    for(const QString& sRequest : qAsConst(waiting.requests)) {
+        if(!connections.contains(pClient))
+            break;
+        processTextMessage(pClient, sRequest);
+    }
+}
+
+
+/*!
+ * \brief FileServer::sendQueuePositions
+ * Invoked (queued) by the TransferSlots when the queue has moved:
+ * the clients waiting here are told their new position
+ */
+void
+FileServer::sendQueuePositions() {
+    for(const WaitingClient& waiting : qAsConst(waitingClients)) {
+        int position = pTransferSlots->position(this, waiting.pClient);
+        if(position > 0)
+            SendToOne(waiting.pClient, QString("<queued>%1</queued>").arg(position));
+    }
+}
+
+
+/*!
+ * \brief FileServer::processTextMessage
+ * Serve a request of a client
+ * \param pClient The requesting client
+ * \param sMessage The request
+ */
+void
+FileServer::processTextMessage(QWebSocket* pClient, QString sMessage) {
+    QString sNoData = QString("NoData");
+    QString sToken;
+
+    sToken = XML_Parse(sMessage, "get");
+    if(sToken != sNoData) {
+        QStringList argumentList = sToken.split(",");
+        if(argumentList.count() < 3) {
+            logMessage(logFile,
+                       Q_FUNC_INFO,
+                       QString("Bad formatted requests: %1")
+                       .arg(sToken));
+            return;
+        }
+        const QString& sFileName = argumentList.at(0);
+        qint64 startPos = argumentList.at(1).toLongLong();
+        // No more than a stream chunk: the reply says how much has been sent
+        qint64 length   = qMin(argumentList.at(2).toLongLong(), qint64(STREAM_MAX_CHUNK));
+        // An optional request ID asks for a tagged reply: the client
+        // can then keep several requests in flight and match the replies
+        bool bTagged = argumentList.count() > 3;
+        quint32 requestId = bTagged ? argumentList.at(3).toUInt() : 0;
+#ifdef LOG_VERBOSE
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("%1 asked for: %2 %3 bytes, starting form %4 ")
+                   .arg(pClient->peerAddress().toString(), sFileName)
+                   .arg(length)
+                   .arg(startPos));
+#endif
+        // The file chosen at the first chunk is sent until the last one
+        bool bChanged;
+        QFileInfo fileInfo = pinnedFile(pClient, sFileName, startPos == 0, &bChanged);
+        if(bChanged) {
+            logMessage(logFile,
+                       Q_FUNC_INFO,
+                       QString("%1 changed while %2 was downloading it")
+                       .arg(sFileName, pClient->peerAddress().toString()));
+            if(bTagged)
+                SendToOne(pClient, QString("<chunk_error>%1</chunk_error>").arg(sToken));
+            else
+                SendToOne(pClient, QString("<missingFile>%1</missingFile>").arg(sToken));
+            return;
+        }
+        if(fileInfo.exists()) {
+            qint64 filesize = fileInfo.size();
+            if((startPos < 0) || (length <= 0) || (filesize <= startPos)) {
+                logMessage(logFile,
+                           Q_FUNC_INFO,
+                           QString("File size %1 is less than requested start position: %2")
+                           .arg(filesize)
+                           .arg(startPos));
+                if(bTagged)
+                    SendToOne(pClient, QString("<chunk_error>%1</chunk_error>").arg(sToken));
+                return;
+            }
+            if(pendingReads.value(pClient)+pendingFrames.value(pClient).count() >= MAX_QUEUED_CHUNKS) {
+                // The client asks faster than it can be served
+                logMessage(logFile,
+                           Q_FUNC_INFO,
+                           QString("Too many requests from %1")
+                           .arg(pClient->peerAddress().toString()));
+                if(bTagged)
+                    SendToOne(pClient, QString("<chunk_error>%1</chunk_error>").arg(sToken));
+                return;
+            }
+            // A panel that already has the chunk sends it in our place
+            QString sPeer = peerFor(pClient, sFileName, fileInfo, startPos, length);
+            if(!sPeer.isEmpty()) {
+                notePinnedRange(pClient, sFileName, fileInfo.absoluteFilePath(), startPos, length);
+                SendToOne(pClient, QString("<redirect>%1;%2</redirect>").arg(sToken, sPeer));
+                return;
+            }
+            ChunkRequest request;
+            request.pClient      = pClient;
+            request.sFileName    = sFileName;
+            request.sFilePath    = fileInfo.absoluteFilePath();
+            request.fileSize     = filesize;
+            request.lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+            request.startPos     = startPos;
+            request.length       = length;
+            request.requestId    = requestId;
+            request.bTagged      = bTagged;
+            request.bStream      = false;
+            request.playRank     = playRank(sFileName);
+            request.bPrefetch    = false;
+            request.bMulticast   = false;
+            pendingReads[pClient]++;
+            readChunkAsync(request);
+            return;
+        }
+        sMessage = QString("<missingFile>%1</missingFile>").arg(sToken);
+        if(pClient->isValid()) {
+            pClient->sendTextMessage(sMessage);
+        }
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("Missing File: %1")
+                   .arg(sFileName));
+        
+    }
+
+    sToken = XML_Parse(sMessage, "send_file_list");
+    if(sToken != sNoData) {
+        // <send_file_list>V</send_file_list> asks for the changes since version V
+        // (the whole list after a change of the storage budget)
+        bool bSince;
+        quint64 sinceVersion = sToken.toULongLong(&bSince);
+        if(bSince && !budgetChanged.contains(pClient) &&
+           (sinceVersion >= deltaBaseVersion) && (sinceVersion <= manifestVersion))
+            SendToOne(pClient, manifestDeltaMessage(pClient, sinceVersion));
+        else
+            sendFileList(pClient);
+    }// send_spot_list
+
+    sToken = XML_Parse(sMessage, "manifest_encoding");
+    if(sToken != sNoData) {
+        // Reply with the encoding of the <file_list> that will be used
+        int encoding = qBound(int(MANIFEST_ENCODING_TEXT), sToken.toInt(), int(MANIFEST_ENCODING_BINARY));
+        clientManifestEncoding.insert(pClient, encoding);
+        SendToOne(pClient, QString("<manifest_encoding>%1</manifest_encoding>").arg(encoding));
+        return;
+    }// manifest_encoding
+
+    sToken = XML_Parse(sMessage, "send_file_page");
+    if(sToken != sNoData) {
+        // <send_file_page>P</send_file_page> asks for the page P (from 0) of the manifest
+        SendToOne(pClient, filePageMessage(pClient, sToken.toInt()));
+    }// send_file_page
+
+    sToken = XML_Parse(sMessage, "framing");
+    if(sToken != sNoData) {
+        // Reply with the framing that will be used
+        int framing = qBound(1, sToken.toInt(), int(CHUNK_HEADER_V2_VERSION));
+        clientFraming.insert(pClient, framing);
+        SendToOne(pClient, QString("<framing>%1</framing>").arg(framing));
+        return;
+    }// framing
+
+    sToken = XML_Parse(sMessage, "send_transfer_stats");
+    if(sToken != sNoData) {
+        SendToOne(pClient, QString("<transfer_stats>%1,%2,%3</transfer_stats>")
+                           .arg(currentRate.load())
+                           .arg(queuedFrames.load())
+                           .arg(queuedBytes.load()));
+        return;
+    }// send_transfer_stats
+
+    sToken = XML_Parse(sMessage, "send_http_port");
+    if(sToken != sNoData) {
+        quint16 servingPort = pHttpServer ? pHttpServer->serverPort() : 0;
+        SendToOne(pClient, QString("<http_port>%1</http_port>").arg(servingPort));
+        return;
+    }// send_http_port
+
+    sToken = XML_Parse(sMessage, "send_multicast");
+    if(sToken != sNoData) {
+        if(pMulticast)
+            SendToOne(pClient, QString("<multicast>%1;%2;%3</multicast>")
+                               .arg(pMulticast->groupAddress().toString())
+                               .arg(pMulticast->groupPort())
+                               .arg(MULTICAST_PAYLOAD_SIZE));
+        else
+            SendToOne(pClient, QString("<multicast>0</multicast>"));
+        return;
+    }// send_multicast
+
+    sToken = XML_Parse(sMessage, "multicast_get");
+    if(sToken != sNoData) {
+        // The file is sent to the whole group as it is: a client
+        // that would get a scaled slide has to <get> it instead
+        int i = catalog.indexOf(sToken);
+        bool bScaled = (i >= 0) &&
+                       (servedFile(pClient, sToken).absoluteFilePath() !=
+                        QFileInfo(catalog.filePath(i)).absoluteFilePath());
+        if(!pMulticast || bScaled || !pMulticast->sendFile(sToken))
+            SendToOne(pClient, QString("<multicast_fallback>%1</multicast_fallback>").arg(sToken));
+        return;
+    }// multicast_get
+
+    sToken = XML_Parse(sMessage, "multicast_nack");
+    if(sToken != sNoData) {
+        // <multicast_nack>fileName;startPos,length;startPos,length...</multicast_nack>
+        QStringList fields = sToken.split(";", Qt::SkipEmptyParts);
+        if(fields.isEmpty())
+            return;
+        QString sFileName = fields.takeFirst();
+        MulticastSender::RangeList ranges;
+        for(int i=0; i<qMin(fields.count(), int(MULTICAST_MAX_NACK_RANGES)); i++) {
+            QStringList range = fields.at(i).split(",");
+            if(range.count() != 2)
+                continue;
+            bool bStartOk, bLengthOk;
+            qint64 startPos = range.at(0).toLongLong(&bStartOk);
+            qint64 length   = range.at(1).toLongLong(&bLengthOk);
+            if(bStartOk && bLengthOk && (startPos >= 0) && (length > 0))
+                ranges.append(qMakePair(startPos, length));
+        }
+        // Too many losses: the client has to <get> the missing chunks
+        if(!pMulticast || ranges.isEmpty() || !pMulticast->repair(sFileName, ranges))
+            SendToOne(pClient, QString("<multicast_fallback>%1</multicast_fallback>").arg(sFileName));
+        return;
+    }// multicast_nack
+
+    sToken = XML_Parse(sMessage, "send_chunk_hint");
+    if(sToken != sNoData) {
+        // From now on the client is told when the advice changes
+        auto it = links.find(pClient);
+        if(it != links.end()) {
+            it->bHintWanted = true;
+            it->chunkHint   = chunkHint(pClient);
+            SendToOne(pClient, chunkHintMessage(pClient));
+        }
+        return;
+    }// send_chunk_hint
+
+    sToken = XML_Parse(sMessage, "send_play_order");
+    if(sToken != sNoData) {
+        SendToOne(pClient, playOrderMessage());
+        return;
+    }// send_play_order
+
+    sToken = XML_Parse(sMessage, "send_bundle");
+    if(sToken != sNoData) {
+        SendToOne(pClient, bundleMessage());
+        return;
+    }// send_bundle
+
+    sToken = XML_Parse(sMessage, "peer_port");
+    if(sToken != sNoData) {
+        // The panel follows the redirects and serves the others at this port.
+        // Sent once, when the panel connects: the redirects never go to
+        // a port changed afterwards
+        bool bOk;
+        uint peerPort = sToken.toUInt(&bOk);
+        if(!bOk || (peerPort > 65535) || ((peerPort != 0) && (peerPort < PEER_MIN_PORT))) {
+            logMessage(logFile,
+                       Q_FUNC_INFO,
+                       QString("Bad formatted requests: %1")
+                       .arg(sToken));
+            return;
+        }
+        if(peers.contains(pClient)) {
+            logMessage(logFile,
+                       Q_FUNC_INFO,
+                       QString("Peer port already set for %1")
+                       .arg(pClient->peerAddress().toString()));
+            return;
+        }
+        PeerState& peer = peers[pClient];
+        peer.port = quint16(peerPort);
+        peer.load = 0;
+        return;
+    }// peer_port
+
+    sToken = XML_Parse(sMessage, "have");
+    if(sToken != sNoData) {
+        notePeerHolding(pClient, sToken);
+        return;
+    }// have
+
+    sToken = XML_Parse(sMessage, "drop");
+    if(sToken != sNoData) {
+        auto it = peers.find(pClient);
+        if(it != peers.end())
+            it->files.remove(sToken);
+        return;
+    }// drop
+
+    sToken = XML_Parse(sMessage, "peer_failed");
+    if(sToken != sNoData) {
+        // The panel could not get a chunk from a peer: it will ask us again
+        dropPeer(sToken);
+        return;
+    }// peer_failed
+
+    sToken = XML_Parse(sMessage, "send_update");
+    if(sToken != sNoData) {
+        requestUpdate(pClient, sToken);
+        return;
+    }// send_update
+
+    sToken = XML_Parse(sMessage, "storage_budget");
+    if(sToken != sNoData) {
+        // <storage_budget>bytes</storage_budget>: the total space the panel
+        // reserves for the media, the files it already holds included
+        // (not the space still free), 0 = the whole library.
+        // The next <send_file_list> gets the whole list for the new budget.
+        bool bOk;
+        qint64 budget = sToken.toLongLong(&bOk);
+        if(!bOk || (budget < 0)) {
+            logMessage(logFile,
+                       Q_FUNC_INFO,
+                       QString("Bad formatted requests: %1")
+                       .arg(sToken));
+            return;
+        }
+        if(clientBudgets.value(pClient, 0) == budget)
+            return;
+        if(budget == 0)
+            clientBudgets.remove(pClient);
+        else
+            clientBudgets.insert(pClient, budget);
+        budgetChanged.insert(pClient);
+        return;
+    }// storage_budget
+
+    sToken = XML_Parse(sMessage, "resolution");
+    if(sToken != sNoData) {
+        QStringList argumentList = sToken.split("x");
+        int width  = argumentList.count() == 2 ? argumentList.at(0).toInt() : 0;
+        int height = argumentList.count() == 2 ? argumentList.at(1).toInt() : 0;
+        if((width  < MIN_PANEL_SIDE) || (width  > MAX_PANEL_SIDE) ||
+           (height < MIN_PANEL_SIDE) || (height > MAX_PANEL_SIDE))
+        {
+            logMessage(logFile,
+                       Q_FUNC_INFO,
+                       QString("Bad formatted requests: %1")
+                       .arg(sToken));
+            return;
+        }
+        clientResolutions.insert(pClient, QSize(width, height));
+        if(pSlidePreprocessor)
+            pSlidePreprocessor->addResolution(QSize(width, height));
+        return;
+    }// resolution
+
+    sToken = XML_Parse(sMessage, "stream");
+    if(sToken != sNoData) {
+        startStream(pClient, sToken);
+        return;
+    }// stream
+
+    sToken = XML_Parse(sMessage, "credit");
+    if(sToken != sNoData) {
+        QStringList argumentList = sToken.split(",");
+        auto it = streams.find(pClient);
+        if((argumentList.count() < 2) ||
+           (it == streams.end())      ||
+           (it->sFileName != argumentList.at(0)))
+            return; // Credit for a stream already terminated
+        it->credit += qMax(qint64(0), argumentList.at(1).toLongLong());
+        pumpStream(pClient);
+        return;
+    }// credit
+
+    sToken = XML_Parse(sMessage, "stream_stop");
+    if(sToken != sNoData) {
+        streams.remove(pClient);
+        return;
+    }// stream_stop
+}
+
+
+/*!
+ * \brief FileServer::fileListMessage
+ * \param pClient The requesting client
+ * \return The <file_list> reply with all the served files followed by
+ * the <manifest_version>. The reply is built once for each version of the
+ * manifest and each panel resolution.
+ * The large libraries are better fetched with <send_file_page>.
+ */
+QString
+FileServer::fileListMessage(QWebSocket* pClient) {
+    QString sKey = manifestKey(pClient);
+    auto cached = manifestCache.constFind(sKey);
+    if(cached != manifestCache.constEnd())
+        return cached.value();
+
+    QString sMessage;
+    const QVector<int>& order = manifestOrder(pClient);
+    if(order.isEmpty()) {
+        sMessage = QString("<file_list>0/file_list>");
+    }
+    else {
+        // The files are listed in play order
+        sMessage = QString("<file_list>");
+        sMessage.reserve(64*order.count());
+        for(int i=0; i<order.count()-1; i++) {
+            sMessage += manifestEntry(order.at(i), pClient);
+            sMessage += QChar(',');
+        }
+        int i = order.count()-1;
+        sMessage += manifestEntry(order.at(i), pClient);
+        sMessage += QString("</file_list>");
+    }
+    sMessage += QString("<manifest_version>%1</manifest_version>").arg(manifestVersion);
+    manifestCache.insert(sKey, sMessage);
+    return sMessage;
+}
+
+
+/*!
+ * \brief FileServer::fileListFrame
+ * The manifest for the clients that asked for the binary encoding.
+ * As the <file_list> it is built once for each version of the
+ * manifest and each panel resolution.
+ * \param pClient The requesting client
+ * \return The binary frame (see manifestframe.h)
+ */
+QByteArray
+FileServer::fileListFrame(QWebSocket* pClient) {
+    QString sKey = manifestKey(pClient);
+    auto cached = manifestFrames.constFind(sKey);
+    if(cached != manifestFrames.constEnd())
+        return cached.value();
+
+    const QVector<int>& order = manifestOrder(pClient);
+    QVector<ManifestRecord> records;
+    records.reserve(order.count());
+    for(int i=0; i<order.count(); i++)
+        records.append(manifestRecord(order.at(i), pClient));
+    QByteArray frame = encodeManifestFrame(manifestVersion, records);
+    manifestFrames.insert(sKey, frame);
+#ifdef LOG_VERBOSE
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               serverName +
+               QString(" Binary manifest: %1 entries in %2 bytes")
+               .arg(records.count())
+               .arg(frame.size()));
+#endif
+    return frame;
+}
+
+
+/*!
+ * \brief FileServer::sendFileList
+ * Send the whole manifest in the encoding chosen by the client
+ * \param pClient The client
+ */
+void
+FileServer::sendFileList(QWebSocket* pClient) {
+    budgetChanged.remove(pClient);
+    if(clientManifestEncoding.value(pClient, MANIFEST_ENCODING_TEXT) != MANIFEST_ENCODING_BINARY) {
+        SendToOne(pClient, fileListMessage(pClient));
+        return;
+    }
+    if(!pClient->isValid())
+        return;
+    QByteArray frame = fileListFrame(pClient);
+    if(pClient->sendBinaryMessage(frame) != frame.size()) {
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   serverName +
+                   QString(" Error writing the manifest to %1")
+                   .arg(pClient->peerAddress().toString()));
+    }
+}
+
+
+/*!
+ * \brief FileServer::filePageMessage
+ * The manifest split in pages of MANIFEST_PAGE_SIZE entries in play order:
+ * no message grows with the library. The client asks for the pages
+ * from 0 to pageCount-1 and starts again if the version changes meanwhile.
+ * \param pClient The requesting client
+ * \param page The requested page (from 0)
+ * \return <file_page>page;pageCount;version</file_page> followed by
+ * <page_entries>entry,entry...</page_entries>
+ */
+QString
+FileServer::filePageMessage(QWebSocket* pClient, int page) {
+    const QVector<int>& order = manifestOrder(pClient);
+    int pageCount = qMax(1, (order.count()+MANIFEST_PAGE_SIZE-1) / MANIFEST_PAGE_SIZE);
+    page = qBound(0, page, pageCount-1);
+    QString sKey = QString("%1#%2").arg(manifestKey(pClient)).arg(page);
+    auto cached = manifestCache.constFind(sKey);
+    if(cached != manifestCache.constEnd())
+        return cached.value();
+
+    QString sMessage = QString("<file_page>%1;%2;%3</file_page><page_entries>")
+                       .arg(page)
+                       .arg(pageCount)
+                       .arg(manifestVersion);
+    int first = page*MANIFEST_PAGE_SIZE;
+    int last  = qMin(order.count(), first+MANIFEST_PAGE_SIZE);
+    for(int i=first; i<last; i++) {
+        if(i > first)
+            sMessage += QChar(',');
+        sMessage += manifestEntry(order.at(i), pClient);
+    }
+    sMessage += QString("</page_entries>");
+    manifestCache.insert(sKey, sMessage);
+    return sMessage;
+}
+
+
+/*!
+ * \brief FileServer::manifestKey
+ * \param pClient The requesting client
+ * \return The key of the cached manifest messages for the client:
+ * its resolution when the slides are scaled and its storage budget
+ * if it has declared one, otherwise empty
+ */
+QString
+FileServer::manifestKey(QWebSocket* pClient) const {
+    QString sKey;
+    if(pSlidePreprocessor) {
+        QSize resolution = clientResolutions.value(pClient);
+        if(resolution.isValid())
+            sKey = QString("%1x%2").arg(resolution.width()).arg(resolution.height());
+    }
+    auto itBudget = clientBudgets.constFind(pClient);
+    if(itBudget != clientBudgets.constEnd())
+        sKey += QString("@%1").arg(itBudget.value());
+    return sKey;
+}
+
+
+/*!
+ * \brief FileServer::manifestOrder
+ * \return The catalog rows in play order, rebuilt when the manifest changes
+ */
+const QVector<int>&
+FileServer::manifestOrder() {
+    if(manifestRows.count() == catalog.count())
+        return manifestRows;
+    manifestRows.resize(catalog.count());
+    std::iota(manifestRows.begin(), manifestRows.end(), 0);
+    QVector<int> ranks(catalog.count());
+    for(int i=0; i<catalog.count(); i++)
+        ranks[i] = playRank(catalog.name(i));
+    std::stable_sort(manifestRows.begin(), manifestRows.end(), [&ranks](int a, int b) {
+        return ranks.at(a) < ranks.at(b);
+    });
+    return manifestRows;
+}
+
+
+/*!
+ * \brief FileServer::manifestOrder
+ * The panels with a small disk get only the files that fit their storage
+ * budget (the total space reserved to the media): the files are taken in
+ * play order and a file too large for the space left is skipped in favour
+ * of the smaller ones that follow, so the panel does not keep downloading
+ * and deleting files it cannot hold.
+ * \param pClient The requesting client
+ * \return The catalog rows advertised to the client, in play order
+ */
+const QVector<int>&
+FileServer::manifestOrder(QWebSocket* pClient) {
+    const QVector<int>& order = manifestOrder();
+    auto itBudget = clientBudgets.constFind(pClient);
+    if(itBudget == clientBudgets.constEnd())
+        return order;
+    QString sKey = manifestKey(pClient);
+    auto cached = budgetRows.constFind(sKey);
+    if(cached != budgetRows.constEnd())
+        return cached.value();
+
+    QVector<int> rows;
+    qint64 spaceLeft = itBudget.value();
+    for(int i=0; i<order.count(); i++) {
+        qint64 size = manifestRecord(order.at(i), pClient).size;
+        if(size > spaceLeft)
+            continue;
+        rows.append(order.at(i));
+        spaceLeft -= size;
+    }
+#ifdef LOG_VERBOSE
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               serverName +
+               QString(" %1 of %2 files fit a budget of %3 MB")
+               .arg(rows.count())
+               .arg(order.count())
+               .arg(itBudget.value()/(1024*1024)));
+#endif
+    return budgetRows.insert(sKey, rows).value();
+}
+
+
+/*!
+ * \brief FileServer::manifestDeltaMessage
+ * \param pClient The requesting client
+ * \param sinceVersion The manifest version known by the client
+ * \return <manifest_unchanged>V</manifest_unchanged> when the client is up to date,
+ * the whole <file_list> when the changes are not known any more, otherwise
+ * <manifest_delta>sinceVersion;version</manifest_delta> followed by the
+ * <changed>entry,entry...</changed> and <removed>name,name...</removed>
+ * files and by the <play_order> if it has changed.
+ */
+QString
+FileServer::manifestDeltaMessage(QWebSocket* pClient, quint64 sinceVersion) {
+    if(sinceVersion == manifestVersion)
+        return QString("<manifest_unchanged>%1</manifest_unchanged>").arg(manifestVersion);
+    if((sinceVersion < deltaBaseVersion) || (sinceVersion > manifestVersion))
+        return fileListMessage(pClient);
+    // Any change may move files in or out of the subset of a budgeted panel
+    if(clientBudgets.contains(pClient))
+        return fileListMessage(pClient);
+
+    QSet<QString> changedNames;
+    for(int i=manifestChanges.count()-1; i>=0; i--) {
+        if(manifestChanges.at(i).version <= sinceVersion)
+            break;
+        changedNames.insert(manifestChanges.at(i).sFileName);
+    }
+    QStringList changedEntries;
+    QStringList removedNames;
+    for(const QString& sFileName : qAsConst(changedNames)) {
+        int i = catalog.indexOf(sFileName);
+        if(i >= 0)
+            changedEntries.append(manifestEntry(i, pClient));
+        else
+            removedNames.append(sFileName);
+    }
+    QString sMessage = QString("<manifest_delta>%1;%2</manifest_delta>")
+                       .arg(sinceVersion)
+                       .arg(manifestVersion);
+    sMessage += QString("<changed>%1</changed>").arg(changedEntries.join(QChar(',')));
+    sMessage += QString("<removed>%1</removed>").arg(removedNames.join(QChar(',')));
+    if(playOrderVersion > sinceVersion)
+        sMessage += playOrderMessage();
+    return sMessage;
+}
+
+
+/*!
+ * \brief FileServer::manifestRecord
+ * \param i The catalog row of the file
+ * \param pClient The client: the entry of a scaled slide has its size and hash
+ * \return The manifest entry of the file
+ */
+ManifestRecord
+FileServer::manifestRecord(int i, QWebSocket* pClient) {
+    ManifestRecord record;
+    record.sName = catalog.name(i);
+    if(pSlidePreprocessor) {
+        auto itResolution = clientResolutions.constFind(pClient);
+        SlideVariant slideVariant;
+        if((itResolution != clientResolutions.constEnd()) &&
+           pSlidePreprocessor->variant(QFileInfo(catalog.filePath(i)), itResolution.value(), &slideVariant))
+        {
+            record.size    = slideVariant.size;
+            record.bHashed = true;
+            record.hash    = slideVariant.hash;
+            return record;
+        }
+    }
+    record.size    = catalog.size(i);
+    record.bHashed = catalog.isHashed(i);
+    record.hash    = record.bHashed ? catalog.hash(i) : 0;
+    return record;
+}
+
+
+/*!
+ * \brief FileServer::manifestEntry
+ * \param i The catalog row of the file
+ * \param pClient The client: the entry of a scaled slide has its size and hash
+ * \return The file description sent in the <file_list> reply:
+ * name;size or name;size;hash when the content hash is already known
+ */
+QString
+FileServer::manifestEntry(int i, QWebSocket* pClient) {
+    ManifestRecord record = manifestRecord(i, pClient);
+    QString sEntry = QString("%1;%2").arg(record.sName).arg(record.size);
+    if(record.bHashed)
+        sEntry += QString(";%1").arg(record.hash, 16, 16, QChar('0'));
+    return sEntry;
+}
+
+
+/*!
+ * \brief FileServer::onFileHashed
+ * Invoked by the HashIndexer when the content hash of a file is available.
+ * The entries pushed with a <file_added> without a hash (the files found
+ * or modified while serving) are pushed again with their hash.
+ * The entries sent only in whole lists (e.g. just after setDir()) are not
+ * pushed one by one: a single new manifest is started by onHashingDone().
+ */
+void
+FileServer::onFileHashed(QString sFilePath, qint64 size, qint64 lastModified, quint64 hash) {
+    int i = catalog.indexOf(catalog.nameOf(sFilePath));
+    if((i < 0)                                 ||
+       (catalog.size(i) != size)               ||
+       (catalog.lastModified(i) != lastModified))
+        return; // Removed or changed again: it will be hashed again
+    if(catalog.isHashed(i) && (catalog.hash(i) == hash))
+        return; // Nothing new
+    catalog.setHash(i, hash);
+    const QString sName = catalog.name(i);
+    if(!announcedUnhashed.remove(sName)) {
+        bListedUnhashed = true;
+        return;
+    }
+    // The entry now has its hash: push it so the panels can verify the file
+    noteManifestChange(sName, true);
+    SendFileAdded(i);
+    for(auto it=clientBudgets.constBegin(); it!=clientBudgets.constEnd(); ++it) {
+        // The subset does not change (the cached one is used): only the hash is new
+        if(it.key()->isValid() && manifestOrder(it.key()).contains(i))
+            SendToOne(it.key(), QString("<file_added>%1</file_added>")
+                                .arg(manifestEntry(i, it.key())));
+    }
+}
+
+
+/*!
+ * \brief FileServer::onHashingDone
+ * The hashes of the entries sent only in whole lists are now known:
+ * a new manifest begins, so that the panels asking for the changes
+ * get the whole list again, with the hashes, in a single reply
  */
 void
-FileServer::onStartServer() {
-    if(port == 0) {
-        logMessage(logFile,
-                   Q_FUNC_INFO,
-                   serverName +
-                   QString(" Error! Server port not set."));
-        emit fileServerDone(true);// Close with errors
+FileServer::onHashingDone() {
+    if(!bListedUnhashed)
         return;
-    }
+    bListedUnhashed = false;
+    resetManifest();
+}
 
-    prepareServer(port);
 
-    connect(this, SIGNAL(newConnection(QWebSocket*)),
-            this, SLOT(onNewConnection(QWebSocket*)));
-    connect(this, SIGNAL(netServerError(QWebSocketProtocol::CloseCode)),
-            this, SLOT(onFileServerError(QWebSocketProtocol::CloseCode)));
+/*!
+ * \brief FileServer::frameChunk
+ * Build the binary message carrying a chunk. Depending on the client:
+ * - framing 2: every chunk has a version 2 header (with CRC-32C)
+ * - tagged requests: the chunk has a version 1 header
+ * - otherwise only the first chunk of the file has the legacy header
+ * \param pClient The client to serve
+ * \param request The request with the data read
+ * \return The message to send
+ */
+QByteArray
+FileServer::frameChunk(QWebSocket* pClient, const ChunkRequest& request) {
+    ChunkHeader header;
+    header.flags     = (request.startPos+request.data.size() >= request.fileSize) ? CHUNK_FLAG_LAST : 0;
+    header.requestId = request.requestId;
+    header.offset    = quint64(request.startPos);
+    header.length    = quint32(request.data.size());
+    header.fileSize  = quint64(request.fileSize);
+    if(clientFraming.value(pClient, 1) >= CHUNK_HEADER_V2_VERSION) {
+        header.fileId = chunkFileId(request.sFileName);
+        return encodeChunkFrameV2(header, request.data);
+    }
+    QByteArray ba = request.data;
+    if(request.bTagged)
+        ba.prepend(encodeChunkHeader(header));
+    else if(request.startPos == 0)
+        ba.prepend(legacyHeader(request.sFileName, request.fileSize));
+    return ba;
 }
 
 
 /*!
- * \brief FileServer::onFileServerError
+ * \brief FileServer::legacyHeader
+ * The first chunk of every file carries its name and size padded to 1024 bytes
+ * \param sFileName The name of the file
+ * \param fileSize The size of the file
+ * \return The header
  */
-void
-FileServer::onFileServerError(QWebSocketProtocol::CloseCode code) {
-    Q_UNUSED(code)
-#ifdef LOG_VERBOSE
-    logMessage(logFile,
-               Q_FUNC_INFO,
-               QString("code=%1").arg(code));
-#endif
-    for(int i=0; i<connections.count(); i++) {
-        if(connections.at(i)) {
-            if(connections.at(i)->isValid())
-                connections.at(i)->close();
-            connections.at(i)->disconnect();
-            delete connections.at(i);
-        }
-    }
-    connections.clear();
-    emit fileServerDone(true);// Close File Server with errors !
+QByteArray
+FileServer::legacyHeader(const QString& sFileName, qint64 fileSize) {
+    QByteArray header = sFileName.toLocal8Bit();
+    header.append(',');
+    header.append(QByteArray::number(fileSize));
+    if(header.size() < 1024)
+        header.append(1024-header.size(), '\0');
+    return header;
 }
 
 
 /*!
- * \brief FileServer::onNewConnection
- * Invoked upon a new connection has been detected
- * \param pClient The websocket of the connected client
+ * \brief FileServer::startStream
+ * Serve a <stream>fileName,startPos,window[,chunkSize]</stream> request.
+ * Instead of waiting for a <get> for every chunk, the server pushes the
+ * consecutive chunks of the file as long as the client has credit left.
+ * The window is the initial credit (in bytes) granted by the client, which
+ * adds credit with <credit>fileName,bytes</credit> as it consumes the data.
+ * The negotiated values are sent back with
+ * <stream_start>fileName,fileSize,chunkSize,window</stream_start>
+ * and the end of the transfer is signaled with <stream_done>fileName</stream_done>.
+ * When the client does not ask for a chunk size (or asks for 0) the server
+ * chooses it from the link estimates and changes it as the link changes.
+ * \param pClient The requesting client
+ * \param sToken The request arguments
  */
 void
-FileServer::onNewConnection(QWebSocket *pClient) {
-    int nConnections = connections.count();
-#ifdef LOG_VERBOSE
-    logMessage(logFile,
-               Q_FUNC_INFO,
-               serverName +
-               QString("Connection requests from %1")
-               .arg(pClient->peerAddress().toString()));
-#endif
-    for(int i=nConnections-1; i>=0; i--) {
-        if(connections.at(i)->peerAddress() == pClient->peerAddress()) {
-            logMessage(logFile,
-                       Q_FUNC_INFO,
-                       serverName +
-                       QString("Duplicate requests from %1")
-                       .arg(pClient->peerAddress().toString()));
-            if(connections.at(i)->isValid() && pClient->isValid()) {
-                logMessage(logFile,
-                           Q_FUNC_INFO,
-                           serverName +
-                           QString(" Both sockets are valid! Removing the old connection"));
-                connections.at(i)->disconnect();
-                connections.at(i)->abort();
-                delete connections.at(i);
-                connections.removeAt(i);
-                break;
-            }
-            if(pClient->isValid()) {
-                logMessage(logFile,
-                           Q_FUNC_INFO,
-                           serverName +
-                           QString(" Only present socket is valid. Removing the old one"));
-                connections.at(i)->disconnect();
-                connections.at(i)->abort();
-                delete connections.at(i);
-                connections.removeAt(i);
-            }
-            else {
-                logMessage(logFile,
-                           Q_FUNC_INFO,
-                           serverName +
-                           QString(" Present socket is not valid."));
-                pClient->disconnect();
-                pClient->close(QWebSocketProtocol::CloseCodeNormal,
-                               QString("Duplicated request"));
-                delete pClient;
-                pClient = nullptr;
-                return;
-            }
-            break;
-        }// if(connections.at(i)->peerAddress() == pClient->peerAddress())
-    }// for(int i=nConnections-1; i>=0; i--)
+FileServer::startStream(QWebSocket* pClient, const QString& sToken) {
+    QStringList argumentList = sToken.split(",");
+    if(argumentList.count() < 3) {
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("Bad formatted requests: %1")
+                   .arg(sToken));
+        return;
+    }
+    StreamState stream;
+    stream.sFileName = argumentList.at(0);
+    stream.nextPos   = qMax(qint64(0), argumentList.at(1).toLongLong());
+    qint64 window    = argumentList.at(2).toLongLong();
+    stream.chunkSize = 0;
+    if(argumentList.count() > 3)
+        stream.chunkSize = argumentList.at(3).toLongLong();
+    stream.bAdaptive = stream.chunkSize <= 0;
+    if(stream.bAdaptive) {
+        stream.chunkSize = chunkHint(pClient);
+        if(stream.chunkSize == 0)
+            stream.chunkSize = qBound(minChunkSize, qint64(STREAM_CHUNK_SIZE), maxChunkSize);
+    }
+    stream.chunkSize = qBound(qint64(STREAM_MIN_CHUNK), stream.chunkSize, qint64(STREAM_MAX_CHUNK));
+    window           = qBound(qint64(STREAM_MIN_CHUNK), window, qint64(STREAM_MAX_WINDOW));
+    stream.chunkSize = qMin(stream.chunkSize, window);
+    stream.window    = window;
+    stream.credit    = window;
+    stream.bReadPending = false;
+
+    QFileInfo fileInfo = servedFile(pClient, stream.sFileName);
+    if(!fileInfo.exists()) {
+        SendToOne(pClient, QString("<missingFile>%1</missingFile>").arg(sToken));
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("Missing File: %1")
+                   .arg(stream.sFileName));
+        return;
+    }
 #ifdef LOG_VERBOSE
     logMessage(logFile,
                Q_FUNC_INFO,
-               serverName +
-               QString(" Client connected: %1")
-               .arg(pClient->peerAddress().toString()));
+               QString("%1 streaming %2 from %3 chunk %4 window %5")
+               .arg(pClient->peerAddress().toString(), stream.sFileName)
+               .arg(stream.nextPos)
+               .arg(stream.chunkSize)
+               .arg(window));
 #endif
-    connections.append(pClient);
-
-    connect(pClient, SIGNAL(textMessageReceived(QString)),
-            this, SLOT(onProcessTextMessage(QString)));
-    connect(pClient, SIGNAL(binaryMessageReceived(QByteArray)),
-            this, SLOT(onProcessBinaryMessage(QByteArray)));
-    connect(pClient, SIGNAL(disconnected()),
-            this, SLOT(onClientDisconnected()));
-    connect(pClient, SIGNAL(error(QAbstractSocket::SocketError)),
-            this, SLOT(onClientSocketError(QAbstractSocket::SocketError)));
+    // The file is kept for the whole stream
+    stream.sFilePath    = fileInfo.absoluteFilePath();
+    stream.fileSize     = fileInfo.size();
+    stream.lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+    streams.insert(pClient, stream);
+    SendToOne(pClient, QString("<stream_start>%1,%2,%3,%4</stream_start>")
+                       .arg(stream.sFileName)
+                       .arg(fileInfo.size())
+                       .arg(stream.chunkSize)
+                       .arg(window));
+    pumpStream(pClient);
 }
 
 
 /*!
- * \brief FileServer::onClientSocketError
- * \param error
+ * \brief FileServer::pumpStream
+ * Read the next chunk of the client stream if there is credit left
+ * and the socket is not holding too much unsent data.
+ * Only one read per stream is in flight at any time.
+ * \param pClient The client to serve
  */
 void
-FileServer::onClientSocketError(QAbstractSocket::SocketError error) {
-    Q_UNUSED(error)
-    auto *pClient = qobject_cast<QWebSocket *>(sender());
-    logMessage(logFile,
-               Q_FUNC_INFO,
-               serverName +
-               QString(" %1 Error %2 %3")
-               .arg(pClient->peerAddress().toString())
-               .arg(error)
-               .arg(pClient->errorString()));
-    pClient->disconnect();
-    pClient->abort();
-    if(!connections.removeOne(pClient)) {
-        logMessage(logFile,
-                   Q_FUNC_INFO,
-                   serverName +
-                   QString(" Unable to remove %1 from list !")
-                   .arg(pClient->peerAddress().toString()));
+FileServer::pumpStream(QWebSocket* pClient) {
+    auto it = streams.find(pClient);
+    if(it == streams.end())
+        return;
+    if(!pClient->isValid()) {
+        streams.erase(it);
+        return;
     }
-    delete pClient;
-    pClient = nullptr;
+    if(it->bReadPending)
+        return;
+    if(it->bAdaptive) {
+        qint64 hint = chunkHint(pClient);
+        if(hint > 0)
+            it->chunkSize = qMin(hint, it->window);
+    }
+    if(pClient->bytesToWrite() >= STREAM_MAX_BUFFERED_CHUNKS*it->chunkSize)
+        return; // Wait for bytesWritten()
+    if(pendingFrames.contains(pClient))
+        return; // Held back by the rate limiter
+    QFileInfo fileInfo(it->sFilePath);
+    if(!fileInfo.exists()                                                  ||
+       (fileInfo.size() != it->fileSize)                                   ||
+       (fileInfo.lastModified().toMSecsSinceEpoch() != it->lastModified))
+    {
+        // Removed or changed: the client has to start again
+        SendToOne(pClient, QString("<missingFile>%1</missingFile>").arg(it->sFileName));
+        streams.erase(it);
+        return;
+    }
+    qint64 fileSize = it->fileSize;
+    if(it->nextPos >= fileSize) {
+        SendToOne(pClient, QString("<stream_done>%1</stream_done>").arg(it->sFileName));
+        streams.erase(it);
+        return;
+    }
+    qint64 length = qMin(it->chunkSize, fileSize-it->nextPos);
+    if(it->credit < length)
+        return; // Wait for the client to grant more credit
+    it->bReadPending = true;
+    ChunkRequest request;
+    request.pClient      = pClient;
+    request.sFileName    = it->sFileName;
+    request.sFilePath    = it->sFilePath;
+    request.fileSize     = fileSize;
+    request.lastModified = it->lastModified;
+    request.startPos     = it->nextPos;
+    request.length       = length;
+    request.requestId    = 0;
+    request.bTagged      = false;
+    request.bStream      = true;
+    request.playRank     = playRank(it->sFileName);
+    request.bPrefetch    = false;
+    request.bMulticast   = false;
+    readChunkAsync(request);
 }
 
 
 /*!
- * \brief FileServer::onProcessTextMessage
- * Process the requests from the clients
- * \param sMessage
+ * \brief FileServer::onStreamChunkRead
+ * Send the chunk read for a stream and go on with the next one
+ * \param pClient The client to serve
+ * \param request The request with the data read
  */
 void
-FileServer::onProcessTextMessage(QString sMessage) {
-    QString sNoData = QString("NoData");
-    QString sToken;
-
-    // The pointer is valid only during the execution of the slot
-    // that calls this function from this object's thread context.
-    auto *pClient = qobject_cast<QWebSocket *>(sender());
-
-    sToken = XML_Parse(sMessage, "get");
-    if(sToken != sNoData) {
-        QStringList argumentList = sToken.split(",");
-        if(argumentList.count() < 3) {
-            logMessage(logFile,
-                       Q_FUNC_INFO,
-                       QString("Bad formatted requests: %1")
-                       .arg(sToken));
-            return;
-        }
-        const QString& sFileName = argumentList.at(0);
-        qint64 startPos = argumentList.at(1).toInt();
-        qint64 length   = argumentList.at(2).toInt();
-#ifdef LOG_VERBOSE
-        logMessage(logFile,
-                   Q_FUNC_INFO,
-                   QString("%1 asked for: %2 %3 bytes, starting form %4 ")
-                   .arg(pClient->peerAddress().toString(), sFileName)
-                   .arg(length)
-                   .arg(startPos));
-#endif
-        QFile file;
-        QString sFilePath = sFileDir + sFileName;
-        file.setFileName(sFilePath);
-        if(file.exists()) {
-            qint64 filesize = file.size();
-            if(filesize <= startPos) {
-                logMessage(logFile,
-                           Q_FUNC_INFO,
-                           QString("File size %1 is less than requested start position: %2")
-                           .arg(filesize)
-                           .arg(startPos));
-                return;
-            }
-            QByteArray ba;
-            if(startPos == 0) {
-                ba.append(sFileName.toLocal8Bit());
-                ba.append(QString(",%1").arg(filesize).toLocal8Bit());
-                ba.append(QString(1024-ba.length(), '\0').toLocal8Bit());
-            }
-            if(file.open(QIODevice::ReadOnly)) {
-                if(file.seek(startPos)) {
-                    ba.append(file.read(length));
-                    if(ba.size() == 1024) {// Read error !
-                        file.close();
-                        logMessage(logFile,
-                                   Q_FUNC_INFO,
-                                   QString("Error reading %1")
-                                   .arg(sFileName));
-                        return;
-                    }
-                    if(pClient->isValid()) {
-                        auto bytesSent = int(pClient->sendBinaryMessage(ba));
-                        if(bytesSent != ba.size()) {
-                            logMessage(logFile,
-                                       Q_FUNC_INFO,
-                                       QString("Unable to send the file %1")
-                                       .arg(sFileName));
-                        }
-#ifdef LOG_VERBOSE
-                        else {
-                            logMessage(logFile,
-                                       Q_FUNC_INFO,
-                                       QString("File %1 correctly sent")
-                                       .arg(sFileName));
-                        }
-#endif
-                    }
-                    else { // Client disconnected
-                        file.close();
-                        logMessage(logFile,
-                                   Q_FUNC_INFO,
-                                   QString("Client disconnected while sending %1")
-                                   .arg(sFileName));
-                        return;
-                    }
-                    return;
-                }
-                // Unsuccesful seek
-                    file.close();
-                    logMessage(logFile,
-                               Q_FUNC_INFO,
-                               QString("Error seeking %1 to %2")
-                               .arg(sFileName)
-                               .arg(startPos));
-                    return;
-
-            }
-            // file.open failed !
-            logMessage(logFile,
-                       Q_FUNC_INFO,
-                       QString("Unable to open the file %1")
-                       .arg(sFileName));
-            return;
-            
-        }
-        sMessage = QString("<missingFile>%1</missingFile>").arg(sToken);
-        if(pClient->isValid()) {
-            pClient->sendTextMessage(sMessage);
-        }
+FileServer::onStreamChunkRead(QWebSocket* pClient, const ChunkRequest& request) {
+    auto it = streams.find(pClient);
+    if((it == streams.end())                   ||
+       !it->bReadPending                       ||
+       (it->sFileName != request.sFileName)    ||
+       (it->nextPos   != request.startPos))
+        return; // The stream has been stopped or replaced
+    it->bReadPending = false;
+    if(request.data.isEmpty()) {// Read error !
         logMessage(logFile,
                    Q_FUNC_INFO,
-                   QString("Missing File: %1")
-                   .arg(sFileName));
-        
+                   QString("Error reading %1 at %2")
+                   .arg(request.sFileName)
+                   .arg(request.startPos));
+        SendToOne(pClient, QString("<missingFile>%1</missingFile>").arg(request.sFileName));
+        streams.erase(it);
+        return;
     }
+    sendFrame(pClient, frameChunk(pClient, request), request.playRank);
+    notePeerSent(pClient, request);
+    it->nextPos += request.data.size();
+    it->credit  -= request.data.size();
+    pumpStream(pClient);
+}
 
-    sToken = XML_Parse(sMessage, "send_file_list");
-    if(sToken != sNoData) {
-        if(fileList.isEmpty()) {
-            sMessage = QString("<file_list>0/file_list>");
-            SendToOne(pClient, sMessage);
-            return;
-        }
-        if(pClient->isValid()) {
-            sMessage = QString("<file_list>");
-            for(int i=0; i<fileList.count()-1; i++) {
-                sMessage += fileList.at(i).fileName();
-                sMessage += QString(";%1,").arg(fileList.at(i).size());
-            }
-            int i = fileList.count()-1;
-            sMessage += fileList.at(i).fileName();
-            sMessage += QString(";%1</file_list>").arg(fileList.at(i).size());
-            SendToOne(pClient, sMessage);
-        }
-    }// send_spot_list
+
+/*!
+ * \brief FileServer::onClientBytesWritten
+ * The socket has drained some data: continue with the stream (if any)
+ */
+void
+FileServer::onClientBytesWritten(qint64 bytes) {
+    auto* pClient = qobject_cast<QWebSocket *>(sender());
+    if(!pClient)
+        return;
+    auto it = links.find(pClient);
+    if(it != links.end())
+        it->writtenBytes += bytes;
+    pumpStream(pClient);
 }
 
 
@@ -438,6 +3427,51 @@ FileServer::SendToOne(QWebSocket* pClient, const QString& sMessage) {
 }
 
 
+/*!
+ * \brief FileServer::SendToAll
+ * \param sMessage The message for all the connected clients
+ */
+void
+FileServer::SendToAll(const QString& sMessage) {
+    for(int i=0; i<connections.count(); i++) {
+        if(connections.at(i)->isValid())
+            SendToOne(connections.at(i), sMessage);
+    }
+}
+
+
+/*!
+ * \brief FileServer::SendFileAdded
+ * Tell all the connected clients that a file has been added or modified
+ * \param i The catalog row of the file
+ */
+void
+FileServer::SendFileAdded(int i) {
+    if(!catalog.isHashed(i)) // Pushed again once hashed
+        announcedUnhashed.insert(catalog.name(i));
+    for(int j=0; j<connections.count(); j++) {
+        // The panels with a storage budget get their new subset afterwards
+        if(connections.at(j)->isValid() && !clientBudgets.contains(connections.at(j)))
+            SendToOne(connections.at(j), QString("<file_added>%1</file_added>")
+                                         .arg(manifestEntry(i, connections.at(j))));
+    }
+}
+
+
+/*!
+ * \brief FileServer::SendBudgetedLists
+ * The files have changed: the panels with a storage budget get
+ * the whole list again since their subset may be different
+ */
+void
+FileServer::SendBudgetedLists() {
+    for(auto it=clientBudgets.constBegin(); it!=clientBudgets.constEnd(); ++it) {
+        if(it.key()->isValid())
+            sendFileList(it.key());
+    }
+}
+
+
 /*!
  * \brief FileServer::onProcessBinaryMessage
  * \param message
@@ -463,6 +3497,7 @@ FileServer::onClientDisconnected() {
                .arg(sDiconnectedAddress, pClient->closeReason())
                .arg(pClient->closeCode()));
 #endif
+    forgetClient(pClient);
     if(!connections.removeOne(pClient)) {
         logMessage(logFile,
                    Q_FUNC_INFO,
@@ -477,6 +3512,12 @@ FileServer::onClientDisconnected() {
  */
 void
 FileServer::onCloseServer() {
+    // Before the caches and the senders the readers use go away
+    waitForReaders();
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               serverName +
+               QString(" File Server reader threads regularly closed"));
     for(int i=0; i<connections.count(); i++) {
         connections.at(i)->disconnect();
         if(connections.at(i)->isValid())
@@ -484,24 +3525,78 @@ FileServer::onCloseServer() {
         delete connections.at(i);
     }
     connections.clear();
-    for(int i=0; i<senderThreads.count(); i++) {
-        senderThreads.at(i)->requestInterruption();
-        if(senderThreads.at(i)->wait(3000)) {
-            logMessage(logFile,
-                       Q_FUNC_INFO,
-                       serverName +
-                       QString(" File Server Thread %1 regularly closed")
-                       .arg(i));
-        }
-        else {
-            logMessage(logFile,
-                       Q_FUNC_INFO,
-                       serverName +
-                       QString(" File Server Thread %1 forced to close")
-                       .arg(i));
-            senderThreads.at(i)->terminate();
-        }
+    streams.clear();
+    clientResolutions.clear();
+    clientBudgets.clear();
+    budgetChanged.clear();
+    clientFraming.clear();
+    pinnedFiles.clear();
+    clientManifestEncoding.clear();
+    peers.clear();
+    links.clear();
+    sequences.clear();
+    pTransferSlots->cancel(this);
+    pTransferSlots->release(activeTransfers.count());
+    activeTransfers.clear();
+    waitingClients.clear();
+    qDeleteAll(clientBuckets);
+    clientBuckets.clear();
+    pendingFrames.clear();
+    pendingReads.clear();
+    queuedFrames = 0;
+    queuedBytes  = 0;
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               serverName +
+               QString(" ") +
+               chunkCacheStatistics());
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               serverName +
+               QString(" ") +
+               transferStatistics());
+    if(pWatchTimer)
+        pWatchTimer->stop();
+    if(pRescanTimer)
+        pRescanTimer->stop();
+    delete pWatcher;
+    pWatcher = nullptr;
+    delete pSlidePreprocessor;
+    pSlidePreprocessor = nullptr;
+    delete pDeltaBuilder;
+    pDeltaBuilder = nullptr;
+    updateWaiters.clear();
+    delete pHttpServer;
+    pHttpServer = nullptr;
+    delete pMulticast;
+    pMulticast = nullptr;
+    delete pShapingTimer;
+    pShapingTimer = nullptr;
+    delete pStatsTimer;
+    pStatsTimer = nullptr;
+    mappedFiles.clear();
+    openFiles.clear();
+    pChunkCache->clear();
+    pHashThread->requestInterruption();
+    pHashThread->quit();
+    if(!pHashThread->wait(3000)) {
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   serverName +
+                   QString(" Hash Thread forced to close"));
+        pHashThread->terminate();
+        pHashThread->wait();
     }
+    delete pHashIndexer;
+    pHashIndexer = nullptr;
+    delete pSlideBundler;
+    pSlideBundler = nullptr;
+    bundle.size = 0;
+    delete pHashThread;
+    pHashThread = nullptr;
+    // A hosted server leaves its thread to the MediaServer
+    if(bHosted)
+        return;
     // NetServer::closeServer() calls
     // thread()->quit()
     // to quit the processing thread
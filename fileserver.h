@@ -23,51 +23,326 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QObject>
 #include <QTextStream>
 #include <QDateTime>
-#include <QFileInfoList>
+#include <QHash>
+#include <QSet>
+#include <QSize>
+#include <QQueue>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
 
 #include "netServer.h"
+#include "mappedfilecache.h"
+#include "filehandlecache.h"
+#include "chunkcache.h"
+#include "transferslots.h"
+#include "mediacatalog.h"
+#include "manifestframe.h"
 
 QT_FORWARD_DECLARE_CLASS(QFile)
+QT_FORWARD_DECLARE_CLASS(QFileInfo)
 QT_FORWARD_DECLARE_CLASS(QWebSocket)
+QT_FORWARD_DECLARE_CLASS(HashIndexer)
+QT_FORWARD_DECLARE_CLASS(QThreadPool)
+QT_FORWARD_DECLARE_CLASS(QFileSystemWatcher)
+QT_FORWARD_DECLARE_CLASS(QTimer)
+QT_FORWARD_DECLARE_CLASS(SlidePreprocessor)
+QT_FORWARD_DECLARE_CLASS(SlideBundler)
+QT_FORWARD_DECLARE_CLASS(HttpMediaServer)
+QT_FORWARD_DECLARE_CLASS(TokenBucket)
+QT_FORWARD_DECLARE_CLASS(MediaServer)
+QT_FORWARD_DECLARE_CLASS(MulticastSender)
+QT_FORWARD_DECLARE_CLASS(UpdateDeltaBuilder)
+QT_FORWARD_DECLARE_STRUCT(ChunkRequest)
 
 class FileServer : public NetServer
 {
     Q_OBJECT
+    friend class ChunkReader;
+    friend class HttpMediaServer;
+    friend class MediaServer;
+    friend class MulticastSender;
+    friend class TransferSlots;
+
 public:
     explicit FileServer(const QString& sName, QFile *_logFile = nullptr, QObject *parent = nullptr);
     void setServerPort(quint16 myPort);
     bool setDir(QString sDirectory, const QString& sExtensions);
+    void setMappedMode(bool bMapped);
+    void setChunkCacheSize(qint64 maxBytes);
+    void setReaderThreads(int nThreads);
+    void setSlideScaling(bool bScale);
+    void setSlideBundle(bool bEnable);
+    void setUpdateDeltas(bool bEnable);
+    void setHttpPort(quint16 myPort);
+    void setMulticast(const QHostAddress& groupAddress, quint16 groupPort, qint64 bytesPerSecond);
+    void setChunkBounds(qint64 minBytes, qint64 maxBytes);
+    void setPrefetchDepth(int nChunks);
+    void setMaxTransfers(int nTransfers);
+    void setMaxOpenFiles(int nFiles);
+    void setPeerRedirects(int nRedirects);
+    void setPeerLoopback(bool bEnable);
+    void setGlobalLimiter(TokenBucket* pBucket);
+    QString transferStatistics() const;
+    QString chunkCacheStatistics() const;
     void closeServer();
 
 private:
     int SendToOne(QWebSocket* pSocket, const QString& sMessage);
+    void SendToAll(const QString& sMessage);
+    void SendFileAdded(int i);
+    void SendBudgetedLists();
+    QString fileListMessage(QWebSocket* pClient);
+    QByteArray fileListFrame(QWebSocket* pClient);
+    void sendFileList(QWebSocket* pClient);
+    QString filePageMessage(QWebSocket* pClient, int page);
+    QString manifestKey(QWebSocket* pClient) const;
+    const QVector<int>& manifestOrder();
+    const QVector<int>& manifestOrder(QWebSocket* pClient);
+    QStringList scanDirectory(QStringList* pDirectories);
+    QString manifestDeltaMessage(QWebSocket* pClient, quint64 sinceVersion);
+    void noteManifestChange(const QString& sFileName, bool bHashOnly = false);
+    void resetManifest();
+    QString playOrderMessage();
+    qint64 chunkHint(QWebSocket* pClient) const;
+    QString chunkHintMessage(QWebSocket* pClient) const;
+    void updateLinks(qint64 elapsed);
+    bool updatePlayOrder();
+    int playRank(const QString& sFileName) const;
+    QString bundleMessage();
+    void requestUpdate(QWebSocket* pClient, const QString& sRequest);
+    QString updateMessage(const QString& sTarget, quint64 baseHash, quint64 targetHash);
+    void forgetFile(const QString& sFilePath);
+    void forgetUpdateDeltas(const QString& sFilePath);
+    void forgetClient(QWebSocket* pClient);
+    void processTextMessage(QWebSocket* pClient, QString sMessage);
+    bool admitRequest(QWebSocket* pClient, const QString& sMessage);
+    void onTransferSlotGranted(QWebSocket* pClient);
+    void sendQueuePositions();
+    void releaseIdleTransfers();
+    void notePeerHolding(QWebSocket* pClient, const QString& sHolding);
+    void notePeerSent(QWebSocket* pClient, const ChunkRequest& request);
+    static void addRange(QVector<QPair<qint64, qint64>>* pRanges, qint64 startPos, qint64 length);
+    QString peerFor(QWebSocket* pClient, const QString& sFileName, const QFileInfo& fileInfo,
+                    qint64 startPos, qint64 length);
+    void dropPeer(const QString& sEndpoint);
+    static QString peerHost(const QHostAddress& address);
+    void setHost(QThreadPool* pSharedPool, ChunkCache* pSharedCache, TransferSlots* pSharedSlots);
+    QFileInfo servedFile(QWebSocket* pClient, const QString& sFileName);
+    QFileInfo pinnedFile(QWebSocket* pClient, const QString& sFileName, bool bRestart, bool* pChanged);
+    void notePinnedRange(QWebSocket* pClient, const QString& sFileName, const QString& sFilePath,
+                         qint64 startPos, qint64 length);
+    void purgeVariants();
+    bool httpResource(const QString& sFileName, QSize resolution, QFileInfo* pFileInfo, QString* pETag);
+    QSize peerResolution(const QHostAddress& address);
+    QByteArray readChunk(const QString& sFilePath, qint64 lastModified, qint64 startPos, qint64 length);
+    void readChunkAsync(const ChunkRequest& request);
+    void startReader(const ChunkRequest& request, int priority);
+    void readerDone();
+    void waitForReaders();
+    void prefetchChunks(const ChunkRequest& request);
+    void adviseWillNeed(const QString& sFilePath, qint64 startPos, qint64 length);
+    void onChunkRead(const ChunkRequest& request);
+    void onStreamChunkRead(QWebSocket* pClient, const ChunkRequest& request);
+    ManifestRecord manifestRecord(int i, QWebSocket* pClient);
+    QString manifestEntry(int i, QWebSocket* pClient);
+    QByteArray frameChunk(QWebSocket* pClient, const ChunkRequest& request);
+    void sendFrame(QWebSocket* pClient, const QByteArray& frame, int rank);
+    QByteArray legacyHeader(const QString& sFileName, qint64 fileSize);
+    void startStream(QWebSocket* pClient, const QString& sToken);
+    void pumpStream(QWebSocket* pClient);
 
 signals:
     void fileServerDone(bool);
     void goTransfer();
     void serverAddress(QString);
+    void hashFiles(QStringList filePaths);
+    void buildBundle(QString sRootDir, QStringList filePaths);
 
 public slots:
     void onStartServer();
     void onCloseServer();
     void onFileTransferDone(bool bSuccess);
+    void onSetDir(QString sDirectory, QString sExtensions);
+    void onSetClientRate(qint64 bytesPerSecond);
 
 private slots:
     void onNewConnection(QWebSocket *pClient);
     void onClientDisconnected();
     void onProcessTextMessage(QString sMessage);
     void onProcessBinaryMessage(QByteArray message);
+    void onClientBytesWritten(qint64 bytes);
+    void onClientPong(quint64 elapsedTime, const QByteArray& payload);
+    void onFileHashed(QString sFilePath, qint64 size, qint64 lastModified, quint64 hash);
+    void onHashingDone();
+    void onDirectoryChanged(const QString& sPath);
+    void onUpdateFileList();
+    void onSlideVariantReady(QString sSlidePath, QSize resolution);
+    void onBundleReady(QString sBundlePath, qint64 size, quint64 hash, qint64 tocOffset, int count);
+    void onBundleFailed(QString sBundlePath);
+    void onUpdateDeltaReady(quint64 baseHash, quint64 targetHash);
+    void onFlushFrames();
+    void onUpdateTransferStatistics();
     void onClientSocketError(QAbstractSocket::SocketError error);
     void onFileServerError(QWebSocketProtocol::CloseCode);
 
 private:
     QString       serverName;
     quint16       port;
+    quint16       httpPort;
     QString       sFileDir;
-    QFileInfoList fileList;
+    QStringList   nameFilters;
+    MediaCatalog  catalog;     // The served files
+    QFileSystemWatcher* pWatcher;
+    QTimer*       pWatchTimer;
+    QTimer*       pRescanTimer; // For the files written in place
+    std::atomic<bool> bMapFiles; // Read by the reader threads
+    MappedFileCache mappedFiles;
+    FileHandleCache openFiles;  // For the files not mapped
+    ChunkCache    localChunkCache;
+    ChunkCache*   pChunkCache; // The local one or the one shared by the MediaServer
+    bool          bHosted;     // A namespace of a MediaServer
+
+    struct StreamState {
+        QString sFileName;
+        QString sFilePath;    // The file chosen when the stream started
+        qint64  fileSize;
+        qint64  lastModified;
+        qint64  nextPos;
+        qint64  chunkSize;
+        qint64  window;
+        qint64  credit;
+        bool    bReadPending;
+        bool    bAdaptive; // The chunk size follows the link
+    };
+    struct PinnedFile {
+        QString sFilePath;    // The file chosen at the first chunk
+        qint64  size;
+        qint64  lastModified;
+        QVector<QPair<qint64, qint64>> done; // The ranges read or redirected
+    };
+    struct LinkState {
+        qint64  writtenBytes; // Since the last sample
+        qint64  goodput;      // bytes/s (0 = not known yet)
+        qint64  rtt;          // ms (0 = not known yet)
+        qint64  chunkHint;    // The last size advised to the client
+        bool    bHintWanted;  // The client asked for the advice
+    };
+    struct SequentialState {
+        QString sFilePath;
+        qint64  nextPos;      // Where the next sequential read starts
+        qint64  prefetchedTo; // End of the chunks already read ahead
+        int     runLength;    // Consecutive sequential reads
+    };
+    struct WaitingClient {
+        QWebSocket* pClient;
+        QStringList requests; // Deferred until the client is admitted
+    };
+    struct ManifestChange {
+        quint64 version;
+        QString sFileName;
+    };
+    struct PeerHolding {
+        quint64 hash;   // The manifest hash of the verified content
+        QVector<QPair<qint64, qint64>> ranges; // startPos, length: sorted and merged (empty = whole file)
+    };
+    struct PeerState {
+        quint16 port;   // Where the panel serves the others (0 = it only follows redirects)
+        int     load;   // Redirects to this panel in the current statistics interval
+        QHash<QString, PeerHolding> files; // Keyed by file name
+        QHash<QString, PeerHolding> sent;  // What this server sent it, keyed by file name
+    };
+    struct UpdateWaiter {
+        QWebSocket* pClient;
+        QString     sTarget;
+    };
+    struct PendingFrame {
+        QByteArray frame;
+        int        playRank;
+    };
+    struct BundleInfo {
+        QString sFilePath;
+        qint64  size; // 0 when not available
+        quint64 hash;
+        qint64  tocOffset;
+        int     count;
+    };
 
     QVector<QWebSocket*> connections;
-    QList<QThread*>      senderThreads;
+    QHash<QWebSocket*, StreamState> streams;
+    QHash<QWebSocket*, QHash<QString, PinnedFile>> pinnedFiles; // The <get> transfers in progress
+    QHash<QWebSocket*, QSize> clientResolutions;
+    QHash<QWebSocket*, qint64> clientBudgets; // Storage reserved to the media by the panels with a small disk
+    QSet<QWebSocket*>   budgetChanged; // Their subset may differ from the last list they got
+    QHash<QWebSocket*, int>   clientFraming; // Chunk header version
+    QHash<QWebSocket*, int>   clientManifestEncoding;
+    QHash<QWebSocket*, LinkState> links;
+    QHash<QWebSocket*, SequentialState> sequences;
+    QHash<QWebSocket*, PeerState> peers; // The panels taking part in the peer distribution
+    int                  peerMaxRedirects; // Per peer and statistics interval (0 = no redirects)
+    bool                 bPeerLoopback;    // Several panels allowed on the loopback address
+    int                  prefetchDepth; // Chunks read ahead (0 = none)
+
+    // Admission control
+    TransferSlots        localSlots;
+    TransferSlots*       pTransferSlots; // The local ones or the ones shared by the MediaServer
+    QHash<QWebSocket*, qint64> activeTransfers; // Last activity (msecs)
+    QList<WaitingClient> waitingClients;        // In the queue of pTransferSlots
+    QElapsedTimer        admissionClock;
+    qint64               minChunkSize;
+    qint64               maxChunkSize;
+    QStringList          playOrder;  // The file names in play order
+    QHash<QString, int>  playRanks;  // Keyed by file name
+
+    // Versioned manifest
+    quint64              manifestVersion;
+    quint64              deltaBaseVersion;   // The oldest version a delta can start from
+    quint64              playOrderVersion;   // The version of the last play order change
+    QVector<ManifestChange> manifestChanges; // Since deltaBaseVersion
+    QSet<QString>        announcedUnhashed;  // Pushed with <file_added> before being hashed
+    bool                 bListedUnhashed;    // Hashes set on entries sent only in whole lists
+    QHash<QString, QString> manifestCache;   // <file_list> and <file_page> messages keyed by panel resolution
+    QHash<QString, QByteArray> manifestFrames; // Binary <file_list> keyed by panel resolution
+    QVector<int>         manifestRows;       // The catalog rows in play order (empty = to rebuild)
+    QHash<QString, QVector<int>> budgetRows; // The rows that fit a storage budget keyed as manifestCache
+    HashIndexer*         pHashIndexer;
+    QThread*             pHashThread;
+    QThreadPool*         pReaderPool;
+    std::atomic<bool>    bClosing;      // The queued reads are dropped
+    QMutex               readerMutex;
+    QWaitCondition       readersDone;
+    int                  nReaders;      // Our reads queued or running in the pool
+    bool                 bScaleSlides;
+    SlidePreprocessor*   pSlidePreprocessor;
+    SlideBundler*        pSlideBundler;
+    BundleInfo           bundle;
+    bool                 bUpdateDeltas;  // Serve the application builds as deltas
+    UpdateDeltaBuilder*  pDeltaBuilder;
+    QHash<QString, QString> updateDeltas; // Paths of the deltas keyed by served name
+    QHash<QPair<quint64, quint64>, QList<UpdateWaiter>> updateWaiters; // Keyed by base and target hashes
+    HttpMediaServer*     pHttpServer;
+    MulticastSender*     pMulticast;
+    QHostAddress         multicastGroup;
+    quint16              multicastPort; // 0 = no multicast
+    qint64               multicastRate;
+
+    // Rate limiting
+    TokenBucket*         pGlobalBucket; // Shared by all the servers
+    qint64               clientRate;
+    QHash<QWebSocket*, TokenBucket*>        clientBuckets;
+    QHash<QWebSocket*, QQueue<PendingFrame>> pendingFrames;
+    QHash<QWebSocket*, int> pendingReads; // The <get> being read for each client
+    QTimer*              pShapingTimer;
+    QTimer*              pStatsTimer;
+    QElapsedTimer        statsClock;
+    qint64               sentBytes;
+    qint64               lastSentBytes;
+    std::atomic<qint64>  currentRate;  // bytes/s
+    std::atomic<qint64>  queuedFrames;
+    std::atomic<qint64>  queuedBytes;
+    std::atomic<qint64>  redirectedRequests;
 };
 
 #endif // FILESERVER_H
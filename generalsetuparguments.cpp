@@ -7,8 +7,25 @@ GeneralSetupArguments::GeneralSetupArguments()
     : maxTimeout(2)
     , maxSet(3)
     , iTimeoutDuration(30) //In seconds
+    , iChunkCacheMB(64)
+    , iReaderThreads(2)
+    , bScaleSlides(true)
+    , bSlideBundle(true)
+    , bHttpServer(false)
+    , bMulticast(false)
+    , iMulticastRateKB(2048)
+    , iMinChunkKB(16)
+    , iMaxChunkKB(4096)
+    , iPrefetchChunks(2)
+    , iMaxTransfers(4)
+    , iMaxOpenFiles(0)
+    , iPeerRedirects(8)
+    , bPeerLoopback(false)
+    , iPlayRateKB(1024)
+    , iPlayClientRateKB(512)
     // The default Directories to look for the slides and spots
     , sSlideDir(QStandardPaths::writableLocation(QStandardPaths::PicturesLocation))
     , sSpotDir(QStandardPaths::writableLocation(QStandardPaths::MoviesLocation))
+    , sUpdateDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + QString("/updates"))
 {
 }
@@ -11,7 +11,24 @@ public:
     int        maxTimeout;
     int        maxSet;
     int        iTimeoutDuration;
+    int        iChunkCacheMB; // Memory shared by the File Servers for the hot chunks
+    int        iReaderThreads; // Disk reader threads of each File Server
+    bool       bScaleSlides; // Scale the slides to the panels resolution
+    bool       bSlideBundle; // Pack the slides in a single bundle
+    bool       bHttpServer; // Serve the slides and spots also with HTTP
+    bool       bMulticast; // Send the slides and spots to a multicast group
+    int        iMulticastRateKB; // Multicast sending rate (KB/s, 0 = none)
+    int        iMinChunkKB; // Bounds of the chunk size advised to the panels
+    int        iMaxChunkKB;
+    int        iPrefetchChunks; // Chunks read ahead of the sequential requests
+    int        iMaxTransfers; // Panels served at the same time by the Media Server (0 = no limit)
+    int        iMaxOpenFiles; // Files kept open by each File Server (0 = from the descriptor limit)
+    int        iPeerRedirects; // Requests redirected to each panel every second (0 = no peer distribution)
+    bool       bPeerLoopback; // Several simulated panels on the server host (tests only)
+    int        iPlayRateKB; // Media transfer limit during the rallies (KB/s, 0 = none)
+    int        iPlayClientRateKB; // The same for each panel
 
     QString    sSlideDir;
     QString    sSpotDir;
+    QString    sUpdateDir; // The builds of the panel application
 };
@@ -0,0 +1,192 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#include "hashindexer.h"
+#include "xxhash64.h"
+#include "utility.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSaveFile>
+#include <QThread>
+
+
+#define HASH_BLOCK_SIZE (1024*1024)
+
+
+/*!
+ * \brief HashIndexer::HashIndexer
+ * Computes the xxHash64 of the served files in a background thread.
+ * The hashes are kept in an on-disk index keyed by path, size and
+ * modification time so that a restart does not rehash unchanged files.
+ * \param sIndexFile The file where the index is stored
+ * \param _logFile The File for message logging (if any)
+ * \param parent
+ */
+HashIndexer::HashIndexer(const QString& sIndexFile, QFile* _logFile, QObject *parent)
+    : QObject(parent)
+    , sIndexFileName(sIndexFile)
+    , logFile(_logFile)
+    , bIndexLoaded(false)
+{
+}
+
+
+/*!
+ * \brief HashIndexer::onHashFiles
+ * Emits fileHashed() for every file in the list, rehashing only the
+ * files not present (or changed) in the index.
+ * \param filePaths The full paths of the files to hash
+ */
+void
+HashIndexer::onHashFiles(QStringList filePaths) {
+    if(!bIndexLoaded)
+        loadIndex();
+    bool bIndexChanged = false;
+    for(const QString& sFilePath : qAsConst(filePaths)) {
+        if(QThread::currentThread()->isInterruptionRequested())
+            break;
+        QFileInfo fileInfo(sFilePath);
+        if(!fileInfo.exists())
+            continue;
+        qint64 lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+        auto it = index.constFind(sFilePath);
+        if((it != index.constEnd())       &&
+           (it->size == fileInfo.size()) &&
+           (it->lastModified == lastModified))
+        {
+            emit fileHashed(sFilePath, it->size, it->lastModified, it->hash);
+            continue;
+        }
+        quint64 hash;
+        if(!hashFile(sFilePath, &hash))
+            continue;
+        IndexEntry entry;
+        entry.size         = fileInfo.size();
+        entry.lastModified = lastModified;
+        entry.hash         = hash;
+        index.insert(sFilePath, entry);
+        bIndexChanged = true;
+        emit fileHashed(sFilePath, entry.size, entry.lastModified, entry.hash);
+    }
+    if(bIndexChanged)
+        saveIndex();
+    emit hashingDone();
+}
+
+
+/*!
+ * \brief HashIndexer::hashFile
+ * \param sFilePath The file to hash
+ * \param pHash Where to store the hash
+ * \return true on success
+ */
+bool
+HashIndexer::hashFile(const QString& sFilePath, quint64* pHash) {
+    QFile file(sFilePath);
+    if(!file.open(QIODevice::ReadOnly)) {
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("Unable to open %1")
+                   .arg(sFilePath));
+        return false;
+    }
+    XxHash64 hasher;
+    QByteArray block;
+    while(!file.atEnd()) {
+        if(QThread::currentThread()->isInterruptionRequested()) {
+            file.close();
+            return false;
+        }
+        block = file.read(HASH_BLOCK_SIZE);
+        if(block.isEmpty()) {
+            logMessage(logFile,
+                       Q_FUNC_INFO,
+                       QString("Error reading %1")
+                       .arg(sFilePath));
+            file.close();
+            return false;
+        }
+        hasher.update(block.constData(), block.size());
+    }
+    file.close();
+    *pHash = hasher.digest();
+    return true;
+}
+
+
+/*!
+ * \brief HashIndexer::loadIndex
+ * Each line of the index is: hash;size;lastModified;path
+ */
+void
+HashIndexer::loadIndex() {
+    bIndexLoaded = true;
+    index.clear();
+    QFile indexFile(sIndexFileName);
+    if(!indexFile.open(QIODevice::ReadOnly))
+        return;
+    while(!indexFile.atEnd()) {
+        QByteArray line = indexFile.readLine();
+        if(line.endsWith('\n'))
+            line.chop(1);
+        QString sLine = QString::fromUtf8(line);
+        // The path is the last field since it could contain ';'
+        QStringList fields = sLine.split(";");
+        if(fields.count() < 4)
+            continue;
+        bool bOk;
+        IndexEntry entry;
+        entry.hash = fields.at(0).toULongLong(&bOk, 16);
+        if(!bOk) continue;
+        entry.size = fields.at(1).toLongLong(&bOk);
+        if(!bOk) continue;
+        entry.lastModified = fields.at(2).toLongLong(&bOk);
+        if(!bOk) continue;
+        index.insert(fields.mid(3).join(";"), entry);
+    }
+    indexFile.close();
+}
+
+
+void
+HashIndexer::saveIndex() {
+    QDir().mkpath(QFileInfo(sIndexFileName).absolutePath());
+    QSaveFile indexFile(sIndexFileName);
+    if(!indexFile.open(QIODevice::WriteOnly)) {
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("Unable to write %1")
+                   .arg(sIndexFileName));
+        return;
+    }
+    for(auto it=index.constBegin(); it!=index.constEnd(); ++it) {
+        // Forget the files that no longer exist
+        if(!QFileInfo::exists(it.key()))
+            continue;
+        QString sLine = QString("%1;%2;%3;%4\n")
+                        .arg(it->hash, 16, 16, QChar('0'))
+                        .arg(it->size)
+                        .arg(it->lastModified)
+                        .arg(it.key());
+        indexFile.write(sLine.toUtf8());
+    }
+    indexFile.commit();
+}
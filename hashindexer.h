@@ -0,0 +1,60 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef HASHINDEXER_H
+#define HASHINDEXER_H
+
+#include <QObject>
+#include <QHash>
+#include <QStringList>
+
+QT_FORWARD_DECLARE_CLASS(QFile)
+
+
+class HashIndexer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit HashIndexer(const QString& sIndexFile, QFile* _logFile = nullptr, QObject *parent = nullptr);
+
+signals:
+    void fileHashed(QString sFilePath, qint64 size, qint64 lastModified, quint64 hash);
+    void hashingDone();
+
+public slots:
+    void onHashFiles(QStringList filePaths);
+
+private:
+    void    loadIndex();
+    void    saveIndex();
+    bool    hashFile(const QString& sFilePath, quint64* pHash);
+
+private:
+    struct IndexEntry {
+        qint64  size;
+        qint64  lastModified; // msecs since epoch
+        quint64 hash;
+    };
+    QString                    sIndexFileName;
+    QFile*                     logFile;
+    QHash<QString, IndexEntry> index;
+    bool                       bIndexLoaded;
+};
+
+#endif // HASHINDEXER_H
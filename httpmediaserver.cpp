@@ -0,0 +1,643 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+
+#include "httpmediaserver.h"
+#include "fileserver.h"
+#include "utility.h"
+#include "tokenbucket.h"
+#include "httprange.h"
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QLocale>
+#include <QUrl>
+#include <QUrlQuery>
+#include <QSize>
+
+#if defined(Q_OS_LINUX)
+#include <sys/sendfile.h>
+#include <cerrno>
+#endif
+
+
+#define HTTP_MAX_CONNECTIONS    32
+#define HTTP_MAX_REQUEST_SIZE   (16*1024)
+// Bytes handed to sendfile() in a single call
+#define HTTP_SENDFILE_CHUNK     (1024*1024)
+// Used when sendfile() is not available or the socket is full
+#define HTTP_BLOCK_SIZE         (64*1024)
+#define HTTP_MAX_BUFFERED       (256*1024)
+// Longest wait of the rate limiters before checking again (ms)
+#define HTTP_SHAPING_MAX_WAIT   100
+// A keep-alive connection with no request for so long is closed (ms)
+#define HTTP_IDLE_TIMEOUT       15000
+
+
+/*!
+ * \brief HttpMediaServer::HttpMediaServer
+ * A minimal HTTP/1.1 server for the files of a FileServer.
+ * It answers GET and HEAD requests for the files in the FileServer
+ * manifest with Range, ETag and If-None-Match support, so that a panel
+ * can play a video while it is downloading and use the standard HTTP
+ * caching. A slide is sent scaled to the panel resolution, as through
+ * the WebSocket, with the entity tag of the scaled version. On Linux the file contents are sent by the kernel with
+ * sendfile() without being copied in user space.
+ * The bodies are subject to the same rate limits of the WebSocket
+ * transfers: the rate allowed to each client and the global one.
+ * It lives in the FileServer thread.
+ * \param pServer The FileServer whose files are served
+ * \param _logFile The File for message logging (if any)
+ * \param parent
+ */
+HttpMediaServer::HttpMediaServer(FileServer* pServer, QFile* _logFile, QObject *parent)
+    : QObject(parent)
+    , pFileServer(pServer)
+    , logFile(_logFile)
+    , pTcpServer(nullptr)
+{
+    pShapingTimer = new QTimer(this);
+    pShapingTimer->setSingleShot(true);
+    connect(pShapingTimer, SIGNAL(timeout()),
+            this, SLOT(onShapingTimeout()));
+    pIdleTimer = new QTimer(this);
+    connect(pIdleTimer, SIGNAL(timeout()),
+            this, SLOT(onIdleTimeout()));
+}
+
+
+HttpMediaServer::~HttpMediaServer() {
+    close();
+}
+
+
+/*!
+ * \brief HttpMediaServer::listen
+ * \param port The TCP port to listen on
+ * \return true on success
+ */
+bool
+HttpMediaServer::listen(quint16 port) {
+    close();
+    pTcpServer = new QTcpServer(this);
+    pTcpServer->setMaxPendingConnections(HTTP_MAX_CONNECTIONS);
+    if(!pTcpServer->listen(QHostAddress::Any, port)) {
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("Unable to listen on port %1: %2")
+                   .arg(port)
+                   .arg(pTcpServer->errorString()));
+        delete pTcpServer;
+        pTcpServer = nullptr;
+        return false;
+    }
+    connect(pTcpServer, SIGNAL(newConnection()),
+            this, SLOT(onNewConnection()));
+    pIdleTimer->start(HTTP_IDLE_TIMEOUT/4);
+    return true;
+}
+
+
+/*!
+ * \brief HttpMediaServer::close
+ * Stop listening and drop all the connections
+ */
+void
+HttpMediaServer::close() {
+    const QList<QTcpSocket*> sockets = connections.keys();
+    for(QTcpSocket* pSocket : sockets) {
+        closeConnection(pSocket);
+    }
+    if(pTcpServer) {
+        pTcpServer->close();
+        delete pTcpServer;
+        pTcpServer = nullptr;
+    }
+    pIdleTimer->stop();
+}
+
+
+/*!
+ * \brief HttpMediaServer::serverPort
+ * \return The listening port (0 if not listening)
+ */
+quint16
+HttpMediaServer::serverPort() const {
+    return pTcpServer ? pTcpServer->serverPort() : 0;
+}
+
+
+/*!
+ * \brief HttpMediaServer::setClientRate
+ * \param bytesPerSecond The rate allowed to each client (0 means unlimited)
+ */
+void
+HttpMediaServer::setClientRate(qint64 bytesPerSecond) {
+    for(HttpConnection* pConnection : qAsConst(connections))
+        pConnection->pBucket->setRate(bytesPerSecond);
+    onShapingTimeout();
+}
+
+
+void
+HttpMediaServer::onNewConnection() {
+    while(pTcpServer->hasPendingConnections()) {
+        QTcpSocket* pSocket = pTcpServer->nextPendingConnection();
+        if(connections.count() >= HTTP_MAX_CONNECTIONS)
+            closeIdlestConnection();
+        if(connections.count() >= HTTP_MAX_CONNECTIONS) {
+            logMessage(logFile,
+                       Q_FUNC_INFO,
+                       QString("Too many HTTP connections: %1 refused")
+                       .arg(pSocket->peerAddress().toString()));
+            pSocket->abort();
+            pSocket->deleteLater();
+            continue;
+        }
+        auto* pConnection = new HttpConnection;
+        pConnection->nextPos        = 0;
+        pConnection->endPos         = 0;
+        pConnection->bSending       = false;
+        pConnection->bKeepAlive     = true;
+        pConnection->pBucket        = new TokenBucket(pFileServer->clientRate);
+        pConnection->idleClock.start();
+        connections.insert(pSocket, pConnection);
+        connect(pSocket, SIGNAL(readyRead()),
+                this, SLOT(onReadyRead()));
+        connect(pSocket, SIGNAL(bytesWritten(qint64)),
+                this, SLOT(onBytesWritten(qint64)));
+        connect(pSocket, SIGNAL(disconnected()),
+                this, SLOT(onDisconnected()));
+    }
+}
+
+
+void
+HttpMediaServer::onReadyRead() {
+    auto* pSocket = qobject_cast<QTcpSocket*>(sender());
+    HttpConnection* pConnection = connections.value(pSocket);
+    if(!pConnection)
+        return;
+    pConnection->idleClock.start();
+    pConnection->requestBuffer.append(pSocket->readAll());
+    processRequests(pSocket);
+}
+
+
+/*!
+ * \brief HttpMediaServer::processRequests
+ * Handle the complete requests received (pipelined requests are
+ * handled one after the other when the previous response is done)
+ */
+void
+HttpMediaServer::processRequests(QTcpSocket* pSocket) {
+    HttpConnection* pConnection = connections.value(pSocket);
+    while(pConnection && !pConnection->bSending) {
+        int endOfHeaders = pConnection->requestBuffer.indexOf("\r\n\r\n");
+        if(endOfHeaders < 0) {
+            if(pConnection->requestBuffer.size() > HTTP_MAX_REQUEST_SIZE) {
+                pConnection->bKeepAlive = false;
+                sendError(pSocket, 431, "Request Header Fields Too Large");
+            }
+            return;
+        }
+        QByteArray request = pConnection->requestBuffer.left(endOfHeaders);
+        pConnection->requestBuffer.remove(0, endOfHeaders+4);
+        handleRequest(pSocket, request);
+        pConnection = connections.value(pSocket); // It may have been closed
+        if(pConnection && !pConnection->bKeepAlive)
+            return;
+    }
+}
+
+
+/*!
+ * \brief HttpMediaServer::handleRequest
+ * \param pSocket The requesting socket
+ * \param request The request line and the headers
+ */
+void
+HttpMediaServer::handleRequest(QTcpSocket* pSocket, const QByteArray& request) {
+    HttpConnection* pConnection = connections.value(pSocket);
+    QList<QByteArray> lines = request.split('\n');
+    QList<QByteArray> requestLine = lines.at(0).simplified().split(' ');
+    if(requestLine.count() != 3) {
+        pConnection->bKeepAlive = false;
+        sendError(pSocket, 400, "Bad Request");
+        return;
+    }
+    const QByteArray& method  = requestLine.at(0);
+    const QByteArray& target  = requestLine.at(1);
+    const QByteArray& version = requestLine.at(2);
+    pConnection->bKeepAlive = (version == "HTTP/1.1");
+
+    QByteArray range, ifNoneMatch;
+    for(int i=1; i<lines.count(); i++) {
+        int colon = lines.at(i).indexOf(':');
+        if(colon < 0)
+            continue;
+        QByteArray name  = lines.at(i).left(colon).trimmed().toLower();
+        QByteArray value = lines.at(i).mid(colon+1).trimmed();
+        if(name == "connection") {
+            if(value.toLower() == "close")
+                pConnection->bKeepAlive = false;
+            else if(value.toLower() == "keep-alive")
+                pConnection->bKeepAlive = true;
+        }
+        else if(name == "range")
+            range = value;
+        else if(name == "if-none-match")
+            ifNoneMatch = value;
+    }
+    bool bHead = (method == "HEAD");
+    if(!bHead && (method != "GET")) {
+        sendError(pSocket, 405, "Method Not Allowed", "Allow: GET, HEAD\r\n");
+        return;
+    }
+
+    // Only the files in the manifest are served
+    int question = target.indexOf('?');
+    QByteArray path = target.left(question);
+    QString sFileName = QUrl::fromPercentEncoding(path);
+    if(sFileName.startsWith(QChar('/')))
+        sFileName.remove(0, 1);
+    // A slide is scaled to the resolution in the query (?res=WxH) or
+    // else to the one declared by the panel on the WebSocket connection
+    QSize resolution;
+    if(question >= 0) {
+        QUrlQuery query(QString::fromLatin1(target.mid(question+1)));
+        QStringList size = query.queryItemValue("res").split(QChar('x'));
+        if(size.count() == 2)
+            resolution = QSize(size.at(0).toInt(), size.at(1).toInt());
+    }
+    if(!resolution.isValid())
+        resolution = pFileServer->peerResolution(pSocket->peerAddress());
+    QFileInfo fileInfo;
+    QString sETag;
+    if(!MediaCatalog::isValidName(sFileName) ||
+       !pFileServer->httpResource(sFileName, resolution, &fileInfo, &sETag))
+    {
+        sendError(pSocket, 404, "Not Found");
+        return;
+    }
+    QByteArray eTag = sETag.toLatin1();
+
+    QByteArray headers;
+    headers += "ETag: " + eTag + "\r\n";
+    headers += "Last-Modified: " + httpDate(fileInfo.lastModified()) + "\r\n";
+    headers += "Cache-Control: no-cache\r\n";
+    headers += "Accept-Ranges: bytes\r\n";
+    headers += pConnection->bKeepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+
+    if(!ifNoneMatch.isEmpty()) {
+        const QList<QByteArray> tags = ifNoneMatch.split(',');
+        for(const QByteArray& tag : tags) {
+            if((tag.trimmed() == eTag) || (tag.trimmed() == "*")) {
+                pSocket->write("HTTP/1.1 304 Not Modified\r\n" + headers + "\r\n");
+                if(!pConnection->bKeepAlive)
+                    pSocket->disconnectFromHost();
+                return;
+            }
+        }
+    }
+
+    qint64 fileSize = fileInfo.size();
+    qint64 startPos, endPos;
+    int rangeType = parseHttpRange(range, fileSize, &startPos, &endPos);
+    if(rangeType == HTTP_RANGE_UNSATISFIABLE) {
+        sendError(pSocket, 416, "Range Not Satisfiable",
+                  "Content-Range: bytes */" + QByteArray::number(fileSize) + "\r\n");
+        return;
+    }
+    bool bPartial = (rangeType == HTTP_RANGE_PARTIAL);
+
+    pConnection->file.setFileName(fileInfo.absoluteFilePath());
+    if(!pConnection->file.open(QIODevice::ReadOnly)) {
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("Unable to open %1")
+                   .arg(fileInfo.absoluteFilePath()));
+        sendError(pSocket, 500, "Internal Server Error");
+        return;
+    }
+
+    QByteArray response = bPartial ? "HTTP/1.1 206 Partial Content\r\n" : "HTTP/1.1 200 OK\r\n";
+    response += "Content-Type: " + mimeType(sFileName) + "\r\n";
+    response += "Content-Length: " + QByteArray::number(endPos-startPos) + "\r\n";
+    if(bPartial)
+        response += "Content-Range: bytes " + QByteArray::number(startPos) + "-" +
+                    QByteArray::number(endPos-1) + "/" + QByteArray::number(fileSize) + "\r\n";
+    response += headers + "\r\n";
+    pSocket->write(response);
+#ifdef LOG_VERBOSE
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               QString("%1 %2 %3 bytes %4-%5")
+               .arg(pSocket->peerAddress().toString(), QString(method), sFileName)
+               .arg(startPos)
+               .arg(endPos-1));
+#endif
+    if(bHead) {
+        pConnection->file.close();
+        if(!pConnection->bKeepAlive)
+            pSocket->disconnectFromHost();
+        return;
+    }
+    pConnection->nextPos  = startPos;
+    pConnection->endPos   = endPos;
+    pConnection->bSending = true;
+#if !defined(Q_OS_LINUX)
+    pConnection->file.seek(startPos);
+#endif
+    sendBody(pSocket);
+}
+
+
+/*!
+ * \brief HttpMediaServer::sendBody
+ * Send as much of the response body as the socket accepts
+ * without blocking. When the body is done the file is closed.
+ */
+void
+HttpMediaServer::sendBody(QTcpSocket* pSocket) {
+    HttpConnection* pConnection = connections.value(pSocket);
+    if(!pConnection || !pConnection->bSending)
+        return;
+#if defined(Q_OS_LINUX)
+    // The headers buffered by the socket must go first
+    if(pSocket->bytesToWrite() > 0) {
+        pSocket->flush();
+        if(pSocket->bytesToWrite() > 0)
+            return; // Wait for bytesWritten()
+    }
+    int socketFd = int(pSocket->socketDescriptor());
+    while(pConnection->nextPos < pConnection->endPos) {
+        qint64 wait = shapingWait(pConnection);
+        if(wait > 0) {
+            if(!pShapingTimer->isActive())
+                pShapingTimer->start(int(qMin(wait, qint64(HTTP_SHAPING_MAX_WAIT))));
+            return;
+        }
+        // Smaller pieces when a limit is in force
+        qint64 maxCount = (wait < 0) ? qint64(HTTP_SENDFILE_CHUNK) : qint64(HTTP_BLOCK_SIZE);
+        off_t offset = off_t(pConnection->nextPos);
+        size_t count = size_t(qMin(pConnection->endPos-pConnection->nextPos, maxCount));
+        ssize_t sent = ::sendfile(socketFd, pConnection->file.handle(), &offset, count);
+        if(sent < 0) {
+            if(errno == EINTR)
+                continue;
+            if((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                // The kernel buffer is full: a block written through the
+                // socket makes it emit bytesWritten() when there is room
+                // again (the socket has its own notifier on the descriptor)
+                QByteArray block;
+                if(pConnection->file.seek(pConnection->nextPos))
+                    block = pConnection->file.read(qMin(pConnection->endPos-pConnection->nextPos,
+                                                        qint64(HTTP_BLOCK_SIZE)));
+                if(block.isEmpty()) {
+                    closeConnection(pSocket);
+                    return;
+                }
+                pSocket->write(block);
+                pConnection->nextPos += block.size();
+                chargeBody(pConnection, block.size());
+                return; // Wait for bytesWritten()
+            }
+            logMessage(logFile,
+                       Q_FUNC_INFO,
+                       QString("sendfile() error %1 sending %2")
+                       .arg(errno)
+                       .arg(pConnection->file.fileName()));
+            closeConnection(pSocket);
+            return;
+        }
+        if(sent == 0) {// The file has been truncated
+            closeConnection(pSocket);
+            return;
+        }
+        pConnection->nextPos += sent;
+        chargeBody(pConnection, sent);
+    }
+#else
+    while((pConnection->nextPos < pConnection->endPos) &&
+          (pSocket->bytesToWrite() < HTTP_MAX_BUFFERED))
+    {
+        qint64 wait = shapingWait(pConnection);
+        if(wait > 0) {
+            if(!pShapingTimer->isActive())
+                pShapingTimer->start(int(qMin(wait, qint64(HTTP_SHAPING_MAX_WAIT))));
+            return;
+        }
+        QByteArray block = pConnection->file.read(qMin(pConnection->endPos-pConnection->nextPos,
+                                                       qint64(HTTP_BLOCK_SIZE)));
+        if(block.isEmpty()) {
+            closeConnection(pSocket);
+            return;
+        }
+        pSocket->write(block);
+        pConnection->nextPos += block.size();
+        chargeBody(pConnection, block.size());
+    }
+    if(pConnection->nextPos < pConnection->endPos)
+        return; // Wait for bytesWritten()
+#endif
+    pConnection->file.close();
+    pConnection->bSending = false;
+    pConnection->idleClock.start();
+    if(!pConnection->bKeepAlive)
+        pSocket->disconnectFromHost();
+}
+
+
+/*!
+ * \brief HttpMediaServer::onIdleTimeout
+ * Close the keep-alive connections with no request for HTTP_IDLE_TIMEOUT:
+ * they would hold a place among the HTTP_MAX_CONNECTIONS allowed
+ */
+void
+HttpMediaServer::onIdleTimeout() {
+    const QList<QTcpSocket*> sockets = connections.keys();
+    for(QTcpSocket* pSocket : sockets) {
+        HttpConnection* pConnection = connections.value(pSocket);
+        if(!pConnection->bSending && pConnection->idleClock.hasExpired(HTTP_IDLE_TIMEOUT))
+            closeConnection(pSocket);
+    }
+}
+
+
+/*!
+ * \brief HttpMediaServer::closeIdlestConnection
+ * Make room for a new connection closing the one idle for the
+ * longest time (if any)
+ */
+void
+HttpMediaServer::closeIdlestConnection() {
+    QTcpSocket* pIdlest = nullptr;
+    qint64 idlest = -1;
+    for(auto it=connections.constBegin(); it!=connections.constEnd(); ++it) {
+        if(it.value()->bSending || !it.value()->requestBuffer.isEmpty())
+            continue;
+        qint64 idle = it.value()->idleClock.elapsed();
+        if(idle > idlest) {
+            idlest = idle;
+            pIdlest = it.key();
+        }
+    }
+    if(pIdlest)
+        closeConnection(pIdlest);
+}
+
+
+/*!
+ * \brief HttpMediaServer::shapingWait
+ * \param pConnection The connection sending a body
+ * \return The time to wait before sending more of the body (ms):
+ * 0 if it can be sent now, -1 if it is not rate limited at all
+ */
+qint64
+HttpMediaServer::shapingWait(HttpConnection* pConnection) {
+    TokenBucket* pGlobalBucket = pFileServer->pGlobalBucket;
+    bool bLimited = (pConnection->pBucket->rate() > 0) ||
+                    (pGlobalBucket && (pGlobalBucket->rate() > 0));
+    if(!bLimited)
+        return -1;
+    qint64 wait = pConnection->pBucket->msecsToAvailable();
+    if(pGlobalBucket)
+        wait = qMax(wait, pGlobalBucket->msecsToAvailable());
+    return wait;
+}
+
+
+/*!
+ * \brief HttpMediaServer::chargeBody
+ * Charge the body bytes sent to the rate limiters
+ */
+void
+HttpMediaServer::chargeBody(HttpConnection* pConnection, qint64 bytes) {
+    pConnection->pBucket->consume(bytes);
+    if(pFileServer->pGlobalBucket)
+        pFileServer->pGlobalBucket->consume(bytes);
+}
+
+
+/*!
+ * \brief HttpMediaServer::onShapingTimeout
+ * The rate limiters may allow the bodies held back to go on
+ */
+void
+HttpMediaServer::onShapingTimeout() {
+    const QList<QTcpSocket*> sockets = connections.keys();
+    for(QTcpSocket* pSocket : sockets) {
+        HttpConnection* pConnection = connections.value(pSocket);
+        if(!pConnection || !pConnection->bSending)
+            continue;
+        sendBody(pSocket);
+        if(connections.contains(pSocket))
+            processRequests(pSocket);
+    }
+}
+
+
+void
+HttpMediaServer::onBytesWritten(qint64 bytes) {
+    Q_UNUSED(bytes)
+    auto* pSocket = qobject_cast<QTcpSocket*>(sender());
+    HttpConnection* pConnection = connections.value(pSocket);
+    if(!pConnection || !pConnection->bSending)
+        return;
+    sendBody(pSocket);
+    if(connections.contains(pSocket))
+        processRequests(pSocket);
+}
+
+
+void
+HttpMediaServer::onDisconnected() {
+    auto* pSocket = qobject_cast<QTcpSocket*>(sender());
+    closeConnection(pSocket);
+}
+
+
+/*!
+ * \brief HttpMediaServer::closeConnection
+ * Drop a connection and its state
+ */
+void
+HttpMediaServer::closeConnection(QTcpSocket* pSocket) {
+    HttpConnection* pConnection = connections.take(pSocket);
+    if(!pConnection)
+        return;
+    pConnection->file.close();
+    delete pConnection->pBucket;
+    delete pConnection;
+    pSocket->disconnect(this);
+    pSocket->abort();
+    pSocket->deleteLater();
+}
+
+
+/*!
+ * \brief HttpMediaServer::sendError
+ * Send a response without a body other than the reason phrase
+ */
+void
+HttpMediaServer::sendError(QTcpSocket* pSocket, int status, const QByteArray& reason,
+                           const QByteArray& extraHeaders) {
+    HttpConnection* pConnection = connections.value(pSocket);
+    QByteArray body = reason + "\r\n";
+    QByteArray response = "HTTP/1.1 " + QByteArray::number(status) + " " + reason + "\r\n";
+    response += "Content-Type: text/plain\r\n";
+    response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    response += extraHeaders;
+    response += pConnection->bKeepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+    response += "\r\n" + body;
+    pSocket->write(response);
+    if(!pConnection->bKeepAlive)
+        pSocket->disconnectFromHost();
+}
+
+
+/*!
+ * \brief HttpMediaServer::mimeType
+ * \return The Content-Type of the served file
+ */
+QByteArray
+HttpMediaServer::mimeType(const QString& sFileName) {
+    QString sSuffix = QFileInfo(sFileName).suffix().toLower();
+    if(sSuffix == QString("mp4"))
+        return "video/mp4";
+    if((sSuffix == QString("jpg")) || (sSuffix == QString("jpeg")))
+        return "image/jpeg";
+    if(sSuffix == QString("png"))
+        return "image/png";
+    return "application/octet-stream";
+}
+
+
+/*!
+ * \brief HttpMediaServer::httpDate
+ * \return The date in the format required by HTTP (RFC 7231)
+ */
+QByteArray
+HttpMediaServer::httpDate(const QDateTime& dateTime) {
+    return QLocale::c().toString(dateTime.toUTC(), QString("ddd, dd MMM yyyy hh:mm:ss 'GMT'")).toLatin1();
+}
@@ -0,0 +1,87 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef HTTPMEDIASERVER_H
+#define HTTPMEDIASERVER_H
+
+#include <QObject>
+#include <QHash>
+#include <QFile>
+#include <QElapsedTimer>
+
+QT_FORWARD_DECLARE_CLASS(QTcpServer)
+QT_FORWARD_DECLARE_CLASS(QTcpSocket)
+QT_FORWARD_DECLARE_CLASS(QTimer)
+QT_FORWARD_DECLARE_CLASS(TokenBucket)
+QT_FORWARD_DECLARE_CLASS(QDateTime)
+QT_FORWARD_DECLARE_CLASS(FileServer)
+
+
+class HttpMediaServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit HttpMediaServer(FileServer* pServer, QFile* _logFile = nullptr, QObject *parent = nullptr);
+    ~HttpMediaServer();
+    bool    listen(quint16 port);
+    void    close();
+    quint16 serverPort() const;
+    void    setClientRate(qint64 bytesPerSecond);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onBytesWritten(qint64 bytes);
+    void onDisconnected();
+    void onShapingTimeout();
+    void onIdleTimeout();
+
+private:
+    struct HttpConnection {
+        QByteArray       requestBuffer;
+        QFile            file;
+        qint64           nextPos;
+        qint64           endPos;         // One past the last byte to send
+        bool             bSending;       // A response body is in progress
+        bool             bKeepAlive;
+        TokenBucket*     pBucket;        // The rate allowed to each client
+        QElapsedTimer    idleClock;      // Since the last request or response
+    };
+    void processRequests(QTcpSocket* pSocket);
+    void handleRequest(QTcpSocket* pSocket, const QByteArray& request);
+    void sendError(QTcpSocket* pSocket, int status, const QByteArray& reason,
+                   const QByteArray& extraHeaders = QByteArray());
+    void sendBody(QTcpSocket* pSocket);
+    void closeConnection(QTcpSocket* pSocket);
+    void closeIdlestConnection();
+    qint64 shapingWait(HttpConnection* pConnection);
+    void chargeBody(HttpConnection* pConnection, qint64 bytes);
+    static QByteArray mimeType(const QString& sFileName);
+    static QByteArray httpDate(const QDateTime& dateTime);
+
+private:
+    FileServer*                         pFileServer;
+    QFile*                              logFile;
+    QTcpServer*                         pTcpServer;
+    QTimer*                             pShapingTimer;
+    QTimer*                             pIdleTimer;
+    QHash<QTcpSocket*, HttpConnection*> connections;
+};
+
+#endif // HTTPMEDIASERVER_H
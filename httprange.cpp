@@ -0,0 +1,65 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "httprange.h"
+
+
+/*!
+ * \brief parseHttpRange
+ * Parse the value of a Range header (RFC 7233).
+ * A single byte range is supported: for multiple ranges (and for
+ * units other than bytes) the whole file is sent, as allowed by the RFC.
+ * \param range The header value (empty when there is no Range header)
+ * \param fileSize The size of the requested file
+ * \param pStartPos Where to store the first byte to send
+ * \param pEndPos Where to store one past the last byte to send
+ * \return HTTP_RANGE_NONE, HTTP_RANGE_PARTIAL or HTTP_RANGE_UNSATISFIABLE
+ */
+int
+parseHttpRange(const QByteArray& range, qint64 fileSize, qint64* pStartPos, qint64* pEndPos) {
+    *pStartPos = 0;
+    *pEndPos   = fileSize;
+    if(!range.startsWith("bytes=") || range.contains(','))
+        return HTTP_RANGE_NONE;
+    QByteArray spec = range.mid(6).trimmed();
+    int dash = spec.indexOf('-');
+    if(dash < 0)
+        return HTTP_RANGE_UNSATISFIABLE;
+    QByteArray first = spec.left(dash).trimmed();
+    QByteArray last  = spec.mid(dash+1).trimmed();
+    bool bFirstOk = true, bLastOk = true;
+    qint64 startPos, endPos = fileSize;
+    if(first.isEmpty()) {// Suffix range: the last N bytes
+        qint64 suffix = last.toLongLong(&bLastOk);
+        startPos = qMax(qint64(0), fileSize-suffix);
+        bFirstOk = bLastOk && (suffix > 0);
+    }
+    else {
+        startPos = first.toLongLong(&bFirstOk);
+        if(!last.isEmpty()) {
+            qint64 lastPos = last.toLongLong(&bLastOk);
+            bLastOk = bLastOk && (lastPos >= startPos);
+            endPos = qMin(fileSize, lastPos+1);
+        }
+    }
+    if(!bFirstOk || !bLastOk || (startPos < 0) || (startPos >= fileSize) || (endPos <= startPos))
+        return HTTP_RANGE_UNSATISFIABLE;
+    *pStartPos = startPos;
+    *pEndPos   = endPos;
+    return HTTP_RANGE_PARTIAL;
+}
@@ -0,0 +1,31 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#ifndef HTTPRANGE_H
+#define HTTPRANGE_H
+
+#include <QByteArray>
+
+// The result of parseHttpRange()
+#define HTTP_RANGE_NONE             0 // Send the whole file
+#define HTTP_RANGE_PARTIAL          1 // Send [startPos, endPos)
+#define HTTP_RANGE_UNSATISFIABLE    2 // Reply 416
+
+int parseHttpRange(const QByteArray& range, qint64 fileSize, qint64* pStartPos, qint64* pEndPos);
+
+#endif // HTTPRANGE_H
@@ -0,0 +1,124 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#include "manifestframe.h"
+#include "varint.h"
+
+#include <QtEndian>
+
+
+// zlib level: the frame is built once for each manifest version
+#define MANIFEST_COMPRESSION_LEVEL  9
+
+
+/*!
+ * \brief encodeManifestFrame
+ * \param version The manifest version
+ * \param records The entries in play order
+ * \return The binary frame to send
+ */
+QByteArray
+encodeManifestFrame(quint64 version, const QVector<ManifestRecord>& records) {
+    QByteArray body;
+    body.reserve(24*records.count());
+    QByteArray previous;
+    for(const ManifestRecord& record : records) {
+        QByteArray name = record.sName.toUtf8();
+        int shared = 0;
+        int maxShared = qMin(name.size(), previous.size());
+        while((shared < maxShared) && (name.at(shared) == previous.at(shared)))
+            shared++;
+        appendVarint(&body, quint64(shared));
+        appendVarint(&body, quint64(name.size()-shared));
+        body.append(name.constData()+shared, name.size()-shared);
+        appendVarint(&body, quint64(record.size));
+        body.append(char(record.bHashed ? MANIFEST_ENTRY_HASHED : 0));
+        if(record.bHashed) {
+            uchar hash[8];
+            qToBigEndian(record.hash, hash);
+            body.append(reinterpret_cast<const char*>(hash), 8);
+        }
+        previous = std::move(name);
+    }
+
+    QByteArray frame(MANIFEST_FRAME_HEADER_SIZE, Qt::Uninitialized);
+    auto* pData = reinterpret_cast<uchar*>(frame.data());
+    qToBigEndian(quint16(MANIFEST_FRAME_MAGIC), pData);
+    pData[2] = quint8(MANIFEST_FRAME_VERSION);
+    pData[3] = 0;
+    qToBigEndian(version,                 pData+4);
+    qToBigEndian(quint32(records.count()), pData+12);
+    frame.append(qCompress(body, MANIFEST_COMPRESSION_LEVEL));
+    return frame;
+}
+
+
+/*!
+ * \brief decodeManifestFrame
+ * The decoding done by the panels: the tests check it against the encoder
+ * \param frame A binary manifest frame
+ * \param pVersion Where to store the manifest version
+ * \param pRecords Where to store the entries
+ * \return false if the frame is not valid or is corrupted
+ */
+bool
+decodeManifestFrame(const QByteArray& frame, quint64* pVersion, QVector<ManifestRecord>* pRecords) {
+    if(frame.size() < MANIFEST_FRAME_HEADER_SIZE)
+        return false;
+    auto* pData = reinterpret_cast<const uchar*>(frame.constData());
+    if(qFromBigEndian<quint16>(pData) != MANIFEST_FRAME_MAGIC)
+        return false;
+    if(pData[2] != MANIFEST_FRAME_VERSION)
+        return false;
+    *pVersion = qFromBigEndian<quint64>(pData+4);
+    quint32 count = qFromBigEndian<quint32>(pData+12);
+    QByteArray body = qUncompress(frame.mid(MANIFEST_FRAME_HEADER_SIZE));
+    if(body.isEmpty() && (count > 0))
+        return false;
+
+    pRecords->clear();
+    QByteArray previous;
+    int pos = 0;
+    for(quint32 i=0; i<count; i++) {
+        quint64 shared, length, size;
+        if(!readVarint(body, &pos, &shared) || (shared > quint64(previous.size())))
+            return false;
+        if(!readVarint(body, &pos, &length) || (length > quint64(body.size()-pos)))
+            return false;
+        QByteArray name = previous.left(int(shared));
+        name.append(body.constData()+pos, int(length));
+        pos += int(length);
+        if(!readVarint(body, &pos, &size) || (pos >= body.size()))
+            return false;
+        ManifestRecord record;
+        record.sName   = QString::fromUtf8(name);
+        record.size    = qint64(size);
+        record.bHashed = (quint8(body.at(pos++)) & MANIFEST_ENTRY_HASHED) != 0;
+        record.hash    = 0;
+        if(record.bHashed) {
+            if(body.size()-pos < 8)
+                return false;
+            record.hash = qFromBigEndian<quint64>(reinterpret_cast<const uchar*>(body.constData())+pos);
+            pos += 8;
+        }
+        pRecords->append(record);
+        previous = std::move(name);
+    }
+    return pos == body.size();
+}
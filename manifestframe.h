@@ -0,0 +1,67 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef MANIFESTFRAME_H
+#define MANIFESTFRAME_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+// Binary encoding of the <file_list> sent to the clients that asked
+// for it with <manifest_encoding>1</manifest_encoding>.
+// All the fixed size fields are stored in network (big endian) order:
+//
+//  0  quint16 magic ('V','M')
+//  2  quint8  version (1)
+//  3  quint8  flags (reserved)
+//  4  quint64 manifest version
+// 12  quint32 number of entries
+// 16  the entries compressed with qCompress() (a quint32 with the
+//     uncompressed length followed by the zlib stream)
+//
+// Entries, in play order:
+//     varint  bytes of the name shared with the previous entry
+//     varint  length of the rest of the name
+//     the rest of the name (UTF-8)
+//     varint  file size
+//     quint8  entry flags
+//     quint64 xxHash64 of the file (only with MANIFEST_ENTRY_HASHED)
+//
+// The varints are unsigned LEB128 (see varint.h).
+#define MANIFEST_FRAME_MAGIC        0x564D
+#define MANIFEST_FRAME_VERSION      1
+#define MANIFEST_FRAME_HEADER_SIZE  16
+
+// Entry flags
+#define MANIFEST_ENTRY_HASHED       0x01
+
+
+struct ManifestRecord {
+    QString sName;
+    qint64  size;
+    bool    bHashed;
+    quint64 hash;
+};
+
+
+QByteArray encodeManifestFrame(quint64 version, const QVector<ManifestRecord>& records);
+bool       decodeManifestFrame(const QByteArray& frame, quint64* pVersion, QVector<ManifestRecord>* pRecords);
+
+#endif // MANIFESTFRAME_H
@@ -0,0 +1,261 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#include "mappedfilecache.h"
+#include "filehandlecache.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+#if defined(Q_OS_UNIX)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+#define MAPPED_MAX_FILES    256       // Mappings kept (they hold no descriptor on Unix)
+#define MAPPED_MAX_CHUNK    (1 << 30) // Largest copy (a QByteArray holds less than 2 GB)
+// A file modified more recently than this (s) may still be being written
+#define MAPPED_MIN_AGE      60
+
+
+/*!
+ * \brief MappedFileCache::MappedFileCache
+ * Keeps the recently served files mapped in memory so that the chunks
+ * requested by the panels are sliced out of the mapping instead of being
+ * read with an open/seek/read/close cycle for each request.
+ * A mapping is shared by all the clients and it is dropped as soon as
+ * the file size or its modification time change.
+ * A mapped file must never be truncated: the copy out of the mapping
+ * would raise SIGBUS. The recently modified files, that may still be
+ * written in place, are not mapped and the caller reads them instead.
+ * On Unix the file is closed as soon as it is mapped, so the mappings
+ * use no descriptor; elsewhere each mapping keeps its file open.
+ * The cache can be used concurrently by several reader threads.
+ * \param maxFiles The files kept mapped (0 = MAPPED_MAX_FILES)
+ */
+MappedFileCache::MappedFileCache(int maxFiles) {
+    setMaxFiles(maxFiles);
+}
+
+
+MappedFileCache::~MappedFileCache() {
+    clear();
+}
+
+
+/*!
+ * \brief MappedFileCache::setMaxFiles
+ * \param maxFiles The files kept mapped (0 = MAPPED_MAX_FILES).
+ * It is never more than MAPPED_MAX_FILES and, where a mapping keeps its
+ * file open, never more than FileHandleCache::descriptorBudget().
+ */
+void
+MappedFileCache::setMaxFiles(int maxFiles) {
+#if defined(Q_OS_UNIX)
+    int budget = MAPPED_MAX_FILES;
+#else
+    int budget = qMin(MAPPED_MAX_FILES, FileHandleCache::descriptorBudget());
+#endif
+    if(maxFiles <= 0)
+        maxFiles = budget;
+    QMutexLocker locker(&mutex);
+    mappedFiles.setMaxCost(qMin(maxFiles, budget));
+}
+
+
+int
+MappedFileCache::maxFiles() const {
+    QMutexLocker locker(&mutex);
+    return mappedFiles.maxCost();
+}
+
+
+/*!
+ * \brief MappedFileCache::chunk
+ * \param sFilePath The full path of the file
+ * \param startPos The first byte requested
+ * \param length The number of bytes requested
+ * \return A copy of the requested bytes taken from the mapping (at most
+ * MAPPED_MAX_CHUNK) or an empty QByteArray if the file cannot be mapped.
+ */
+QByteArray
+MappedFileCache::chunk(const QString& sFilePath, qint64 startPos, qint64 length) {
+    MappedFilePtr pMapped = mappedFile(sFilePath);
+    if(!pMapped)
+        return QByteArray();
+    if(startPos < 0 || startPos >= pMapped->size || length <= 0)
+        return QByteArray();
+    qint64 available = qMin(qMin(length, pMapped->size-startPos), qint64(MAPPED_MAX_CHUNK));
+    // The copy is done without holding the lock
+    return QByteArray(reinterpret_cast<const char*>(pMapped->pData+startPos),
+                      int(available));
+}
+
+
+/*!
+ * \brief MappedFileCache::willNeed
+ * Ask the kernel to start reading a range of the mapping in background
+ * \param sFilePath The full path of the file
+ * \param startPos The first byte that will be needed
+ * \param length The number of bytes that will be needed
+ * \return false if the file cannot be mapped or the advice is not supported
+ */
+bool
+MappedFileCache::willNeed(const QString& sFilePath, qint64 startPos, qint64 length) {
+#if defined(Q_OS_UNIX)
+    MappedFilePtr pMapped = mappedFile(sFilePath);
+    if(!pMapped)
+        return false;
+    if(startPos < 0 || startPos >= pMapped->size || length <= 0)
+        return true; // Nothing to read
+    qint64 endPos   = qMin(pMapped->size, startPos+length);
+    qint64 pageSize = qint64(sysconf(_SC_PAGESIZE));
+    qint64 firstPos = startPos - (startPos % pageSize);
+    return madvise(pMapped->pData+firstPos, size_t(endPos-firstPos), MADV_WILLNEED) == 0;
+#else
+    Q_UNUSED(sFilePath)
+    Q_UNUSED(startPos)
+    Q_UNUSED(length)
+    return false;
+#endif
+}
+
+
+/*!
+ * \brief MappedFileCache::fileSize
+ * \param sFilePath The full path of the file
+ * \return The size of the mapped file or -1 if the file cannot be mapped
+ */
+qint64
+MappedFileCache::fileSize(const QString& sFilePath) {
+    MappedFilePtr pMapped = mappedFile(sFilePath);
+    if(!pMapped)
+        return -1;
+    return pMapped->size;
+}
+
+
+/*!
+ * \brief MappedFileCache::invalidate Drop the mapping of a file (if any)
+ * \param sFilePath The full path of the file
+ */
+void
+MappedFileCache::invalidate(const QString& sFilePath) {
+    QMutexLocker locker(&mutex);
+    mappedFiles.remove(sFilePath);
+}
+
+
+/*!
+ * \brief MappedFileCache::clear Drop all the mappings
+ */
+void
+MappedFileCache::clear() {
+    QMutexLocker locker(&mutex);
+    mappedFiles.clear();
+}
+
+
+int
+MappedFileCache::count() const {
+    QMutexLocker locker(&mutex);
+    return mappedFiles.count();
+}
+
+
+/*!
+ * \brief MappedFileCache::mappedFile
+ * Returns the mapping of the file, creating it if needed.
+ * A stale mapping (file changed on disk) is replaced.
+ * \param sFilePath The full path of the file
+ * \return The mapped file or a null pointer on errors
+ * or if the file has been modified in the last MAPPED_MIN_AGE seconds
+ */
+MappedFileCache::MappedFilePtr
+MappedFileCache::mappedFile(const QString& sFilePath) {
+    QFileInfo fileInfo(sFilePath);
+    QMutexLocker locker(&mutex);
+    if(!fileInfo.exists() || fileInfo.size() <= 0 ||
+       (fileInfo.lastModified().secsTo(QDateTime::currentDateTime()) < MAPPED_MIN_AGE))
+    {
+        mappedFiles.remove(sFilePath);
+        return MappedFilePtr();
+    }
+    MappedFilePtr* pCached = mappedFiles.object(sFilePath);
+    if(pCached) {
+        if(((*pCached)->size == fileInfo.size()) &&
+           ((*pCached)->lastModified == fileInfo.lastModified()))
+            return *pCached;
+        mappedFiles.remove(sFilePath);
+    }
+#if defined(Q_OS_UNIX)
+    // QFile::close() would unmap the file: the mapping is made directly
+    // so that the descriptor can be closed right after mmap()
+    int fd = ::open(QFile::encodeName(sFilePath).constData(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return MappedFilePtr();
+    struct stat fileStat;
+    if((fstat(fd, &fileStat) != 0) || (qint64(fileStat.st_size) != fileInfo.size())) {
+        ::close(fd);
+        return MappedFilePtr();
+    }
+    void* pMap = mmap(nullptr, size_t(fileInfo.size()), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(pMap == MAP_FAILED)
+        return MappedFilePtr();
+    QFile* pFile = nullptr;
+    uchar* pData = static_cast<uchar*>(pMap);
+#else
+    auto* pFile = new QFile(sFilePath);
+    if(!pFile->open(QIODevice::ReadOnly)) {
+        delete pFile;
+        return MappedFilePtr();
+    }
+    uchar* pData = pFile->map(0, fileInfo.size());
+    if(!pData) {
+        pFile->close();
+        delete pFile;
+        return MappedFilePtr();
+    }
+    // The file stays open as long as it is mapped
+#endif
+    MappedFilePtr pMapped(new MappedFile);
+    pMapped->pFile        = pFile;
+    pMapped->pData        = pData;
+    pMapped->size         = fileInfo.size();
+    pMapped->lastModified = fileInfo.lastModified();
+    // The least recently used mapping is dropped if the budget is exceeded
+    mappedFiles.insert(sFilePath, new MappedFilePtr(pMapped));
+    return pMapped;
+}
+
+
+MappedFileCache::MappedFile::~MappedFile() {
+#if defined(Q_OS_UNIX)
+    munmap(pData, size_t(size));
+#else
+    pFile->unmap(pData);
+    pFile->close();
+    delete pFile;
+#endif
+}
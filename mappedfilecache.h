@@ -0,0 +1,67 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef MAPPEDFILECACHE_H
+#define MAPPEDFILECACHE_H
+
+#include <QString>
+#include <QCache>
+#include <QDateTime>
+#include <QByteArray>
+#include <QMutex>
+#include <QSharedPointer>
+
+QT_FORWARD_DECLARE_CLASS(QFile)
+
+
+class MappedFileCache
+{
+public:
+    explicit MappedFileCache(int maxFiles = 0);
+    ~MappedFileCache();
+
+    void       setMaxFiles(int maxFiles);
+    int        maxFiles() const;
+
+    QByteArray chunk(const QString& sFilePath, qint64 startPos, qint64 length);
+    qint64     fileSize(const QString& sFilePath);
+    bool       willNeed(const QString& sFilePath, qint64 startPos, qint64 length);
+    void       invalidate(const QString& sFilePath);
+    void       clear();
+    int        count() const;
+
+private:
+    // Unmapped when the last reference goes away: a reader thread
+    // copying out of a mapping keeps it alive even if it is invalidated
+    struct MappedFile {
+        ~MappedFile();
+        QFile*    pFile; // Only where the mapping needs the file open
+        uchar*    pData;
+        qint64    size;
+        QDateTime lastModified;
+    };
+    typedef QSharedPointer<MappedFile> MappedFilePtr;
+    MappedFilePtr mappedFile(const QString& sFilePath);
+
+private:
+    mutable QMutex                mutex;
+    QCache<QString, MappedFilePtr> mappedFiles; // Least recently used first out
+};
+
+#endif // MAPPEDFILECACHE_H
@@ -0,0 +1,325 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+
+#include "mediacatalog.h"
+
+
+/*!
+ * \brief MediaCatalog::MediaCatalog
+ * An empty catalog
+ */
+MediaCatalog::MediaCatalog()
+    : bIndexValid(true)
+{
+}
+
+
+/*!
+ * \brief MediaCatalog::setRoot
+ * Empty the catalog and change its root directory
+ * \param sRootDir The directory the file names are relative to
+ */
+void
+MediaCatalog::setRoot(const QString& sRootDir) {
+    clear();
+    sRoot = sRootDir;
+    if(!sRoot.endsWith(QChar('/')))
+        sRoot += QChar('/');
+}
+
+
+/*!
+ * \brief MediaCatalog::root
+ * \return The root directory (with the trailing '/')
+ */
+QString
+MediaCatalog::root() const {
+    return sRoot;
+}
+
+
+/*!
+ * \brief MediaCatalog::clear
+ * Remove all the files
+ */
+void
+MediaCatalog::clear() {
+    directories.clear();
+    directoryIndexes.clear();
+    fileDirectories.clear();
+    fileNames.clear();
+    fileSizes.clear();
+    fileTimes.clear();
+    fileHashes.clear();
+    fileHashed.clear();
+    rows.clear();
+    bIndexValid = true;
+}
+
+
+int
+MediaCatalog::count() const {
+    return fileNames.count();
+}
+
+
+bool
+MediaCatalog::isEmpty() const {
+    return fileNames.isEmpty();
+}
+
+
+/*!
+ * \brief MediaCatalog::indexOf
+ * \param sName The file name relative to the root
+ * \return The row of the file or -1 if it is not in the catalog
+ */
+int
+MediaCatalog::indexOf(const QString& sName) const {
+    updateIndex();
+    int slash = sName.lastIndexOf(QChar('/'));
+    QString sLeaf = sName.mid(slash+1);
+    auto dirIt = directoryIndexes.constFind(sName.left(slash+1));
+    if(dirIt == directoryIndexes.constEnd())
+        return -1;
+    for(auto it=rows.constFind(sLeaf); (it != rows.constEnd()) && (it.key() == sLeaf); ++it) {
+        if(fileDirectories.at(it.value()) == dirIt.value())
+            return it.value();
+    }
+    return -1;
+}
+
+
+/*!
+ * \brief MediaCatalog::indexOfHash
+ * A linear search: meant for the small catalogs (e.g. the application builds)
+ * \param hash The xxHash64 of a file
+ * \return The row of the first file with that content or -1
+ */
+int
+MediaCatalog::indexOfHash(quint64 hash) const {
+    for(int i=0; i<fileHashes.count(); i++) {
+        if(fileHashed.at(i) && (fileHashes.at(i) == hash))
+            return i;
+    }
+    return -1;
+}
+
+
+/*!
+ * \brief MediaCatalog::insert
+ * Add a file keeping the catalog sorted by name (case insensitive).
+ * Adding the files already sorted costs nothing more than appending them.
+ * \param sName The file name relative to the root
+ * \param size The file size
+ * \param lastModified The last modification time (msecs since epoch)
+ * \return The row of the new file
+ */
+int
+MediaCatalog::insert(const QString& sName, qint64 size, qint64 lastModified) {
+    int slash = sName.lastIndexOf(QChar('/'));
+    int i = lowerBound(sName);
+    fileDirectories.insert(i, internDirectory(sName.left(slash+1)));
+    fileNames.insert(i, sName.mid(slash+1));
+    fileSizes.insert(i, size);
+    fileTimes.insert(i, lastModified);
+    fileHashes.insert(i, 0);
+    fileHashed.insert(i, false);
+    if(bIndexValid && (i == fileNames.count()-1))
+        rows.insert(fileNames.at(i), i);
+    else
+        bIndexValid = false;
+    return i;
+}
+
+
+/*!
+ * \brief MediaCatalog::update
+ * The file has changed: its hash is no more valid
+ */
+void
+MediaCatalog::update(int i, qint64 size, qint64 lastModified) {
+    fileSizes[i]  = size;
+    fileTimes[i]  = lastModified;
+    fileHashed[i] = false;
+}
+
+
+/*!
+ * \brief MediaCatalog::removeAt
+ * Remove a file. The directory stays interned until the catalog is cleared.
+ */
+void
+MediaCatalog::removeAt(int i) {
+    fileDirectories.removeAt(i);
+    fileNames.removeAt(i);
+    fileSizes.removeAt(i);
+    fileTimes.removeAt(i);
+    fileHashes.removeAt(i);
+    fileHashed.removeAt(i);
+    bIndexValid = false;
+}
+
+
+/*!
+ * \brief MediaCatalog::name
+ * \return The file name relative to the root
+ */
+QString
+MediaCatalog::name(int i) const {
+    return directories.at(fileDirectories.at(i)) + fileNames.at(i);
+}
+
+
+/*!
+ * \brief MediaCatalog::filePath
+ * \return The absolute path of the file
+ */
+QString
+MediaCatalog::filePath(int i) const {
+    return sRoot + name(i);
+}
+
+
+/*!
+ * \brief MediaCatalog::nameOf
+ * \param sFilePath The absolute path of a file
+ * \return The file name relative to the root (empty if outside the root)
+ */
+QString
+MediaCatalog::nameOf(const QString& sFilePath) const {
+    if(sRoot.isEmpty() || !sFilePath.startsWith(sRoot))
+        return QString();
+    return sFilePath.mid(sRoot.length());
+}
+
+
+qint64
+MediaCatalog::size(int i) const {
+    return fileSizes.at(i);
+}
+
+
+qint64
+MediaCatalog::lastModified(int i) const {
+    return fileTimes.at(i);
+}
+
+
+bool
+MediaCatalog::isHashed(int i) const {
+    return fileHashed.at(i);
+}
+
+
+quint64
+MediaCatalog::hash(int i) const {
+    return fileHashes.at(i);
+}
+
+
+void
+MediaCatalog::setHash(int i, quint64 hash) {
+    fileHashes[i] = hash;
+    fileHashed[i] = true;
+}
+
+
+/*!
+ * \brief MediaCatalog::isValidName
+ * The names travel in the ',' and ';' separated lists of the messages
+ * and must never escape the root directory.
+ * \param sName A file name relative to the root
+ * \return true if the name can be served
+ */
+bool
+MediaCatalog::isValidName(const QString& sName) {
+    if(sName.isEmpty()                   ||
+       sName.startsWith(QChar('/'))      ||
+       sName.contains(QChar('\\'))       ||
+       sName.contains(QChar(','))        ||
+       sName.contains(QChar(';'))        ||
+       sName.contains(QChar('<'))        ||
+       sName.contains(QChar('>')))
+        return false;
+    const QStringList segments = sName.split(QChar('/'));
+    for(const QString& sSegment : segments) {
+        if(sSegment.isEmpty() || (sSegment == QString(".")) || (sSegment == QString("..")))
+            return false;
+    }
+    for(const QChar& c : sName) {
+        if(c.category() == QChar::Other_Control)
+            return false;
+    }
+    return true;
+}
+
+
+/*!
+ * \brief MediaCatalog::internDirectory
+ * \param sDirectory The relative directory (with the trailing '/')
+ * \return Its index in the table of the directories
+ */
+int
+MediaCatalog::internDirectory(const QString& sDirectory) {
+    auto it = directoryIndexes.constFind(sDirectory);
+    if(it != directoryIndexes.constEnd())
+        return it.value();
+    directories.append(sDirectory);
+    directoryIndexes.insert(sDirectory, directories.count()-1);
+    return directories.count()-1;
+}
+
+
+/*!
+ * \brief MediaCatalog::lowerBound
+ * \return The first row whose name is not less than sName
+ */
+int
+MediaCatalog::lowerBound(const QString& sName) const {
+    int first = 0;
+    int last  = fileNames.count();
+    if((last > 0) && (QString::compare(name(last-1), sName, Qt::CaseInsensitive) < 0))
+        return last; // The common case while scanning
+    while(first < last) {
+        int middle = (first + last) / 2;
+        if(QString::compare(name(middle), sName, Qt::CaseInsensitive) < 0)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+    return first;
+}
+
+
+/*!
+ * \brief MediaCatalog::updateIndex
+ * Rebuild the lookup table after the rows have moved
+ */
+void
+MediaCatalog::updateIndex() const {
+    if(bIndexValid)
+        return;
+    rows.clear();
+    rows.reserve(fileNames.count());
+    for(int i=0; i<fileNames.count(); i++)
+        rows.insert(fileNames.at(i), i);
+    bIndexValid = true;
+}
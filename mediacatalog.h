@@ -0,0 +1,81 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef MEDIACATALOG_H
+#define MEDIACATALOG_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QMultiHash>
+
+
+// The files served from a directory tree, sorted by name.
+// The files are named by their path relative to the root ("dir/file.jpg").
+// Each directory is stored once and referred to by index, and the
+// attributes of the files live in parallel arrays: thousands of entries
+// take a fraction of the memory of a QFileInfoList.
+class MediaCatalog
+{
+public:
+    MediaCatalog();
+
+    void    setRoot(const QString& sRootDir);
+    QString root() const;
+    void    clear();
+    int     count() const;
+    bool    isEmpty() const;
+    int     indexOf(const QString& sName) const;
+    int     indexOfHash(quint64 hash) const;
+    int     insert(const QString& sName, qint64 size, qint64 lastModified);
+    void    update(int i, qint64 size, qint64 lastModified);
+    void    removeAt(int i);
+    QString name(int i) const;
+    QString filePath(int i) const;
+    QString nameOf(const QString& sFilePath) const;
+    qint64  size(int i) const;
+    qint64  lastModified(int i) const;
+    bool    isHashed(int i) const;
+    quint64 hash(int i) const;
+    void    setHash(int i, quint64 hash);
+    static bool isValidName(const QString& sName);
+
+private:
+    int     internDirectory(const QString& sDirectory);
+    int     lowerBound(const QString& sName) const;
+    void    updateIndex() const;
+
+private:
+    QString             sRoot;        // With the trailing '/'
+    QStringList         directories;  // Relative, with the trailing '/' ("" is the root)
+    QHash<QString, int> directoryIndexes;
+    // One element per file
+    QVector<int>        fileDirectories;
+    QVector<QString>    fileNames;    // Without the directory
+    QVector<qint64>     fileSizes;
+    QVector<qint64>     fileTimes;    // msecs since epoch
+    QVector<quint64>    fileHashes;
+    QVector<bool>       fileHashed;
+    // File name (without the directory) to row: rebuilt when needed
+    mutable QMultiHash<QString, int> rows;
+    mutable bool        bIndexValid;
+};
+
+#endif // MEDIACATALOG_H
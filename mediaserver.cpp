@@ -0,0 +1,272 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#include "mediaserver.h"
+#include "fileserver.h"
+#include "utility.h"
+
+#include <QWebSocket>
+#include <QWebSocketServer>
+#include <QThread>
+#include <QThreadPool>
+#include <QUrl>
+
+
+/*!
+ * \brief MediaServer::MediaServer It hosts the File Servers of all the media
+ * (slides, spots, ...) as namespaces of a single server: one port, one thread,
+ * one pool of reader threads, one chunk cache and one limit on the
+ * clients transferring at the same time.
+ * The clients select the namespace with the path of the request
+ * (e.g. ws://address:port/slides). The ports of the old separate servers
+ * can still be served: each one is mapped to its namespace.
+ * \param sName A string distinguishing this server (used for logging)
+ * \param myLogFile The File for message logging (if any)
+ * \param parent
+ */
+MediaServer::MediaServer(const QString& sName, QFile* myLogFile, QObject *parent)
+    : NetServer(sName, myLogFile, parent)
+    , serverName(sName)
+{
+    port = 0;
+    pReaderPool = new QThreadPool(this);
+    pReaderPool->setMaxThreadCount(2);
+}
+
+
+/*!
+ * \brief MediaServer::setServerPort
+ * \param myPort The port shared by all the namespaces
+ */
+void
+MediaServer::setServerPort(quint16 myPort) {
+    port = myPort;
+}
+
+
+/*!
+ * \brief MediaServer::addNamespace
+ * To be called before the server thread starts
+ * \param sNamespace The name the clients use to select the File Server
+ * \param pServer The File Server (it is moved to the MediaServer thread)
+ * \param legacyPort The port used by the clients not aware of the namespaces (0 = none)
+ */
+void
+MediaServer::addNamespace(const QString& sNamespace, FileServer* pServer, quint16 legacyPort) {
+    pServer->setParent(this);
+    pServer->setHost(pReaderPool, &chunkCache, &transferSlots);
+    namespaces.insert(sNamespace, pServer);
+    if(legacyPort != 0)
+        legacyPorts.insert(legacyPort, sNamespace);
+}
+
+
+/*!
+ * \brief MediaServer::setReaderThreads
+ * \param nThreads The number of threads reading the files for all the namespaces
+ */
+void
+MediaServer::setReaderThreads(int nThreads) {
+    pReaderPool->setMaxThreadCount(qMax(1, nThreads));
+}
+
+
+/*!
+ * \brief MediaServer::setChunkCacheSize
+ * \param maxBytes The memory reserved to the chunks of all the namespaces
+ * (0 disables the chunk cache)
+ */
+void
+MediaServer::setChunkCacheSize(qint64 maxBytes) {
+    chunkCache.setMaxSize(maxBytes);
+}
+
+
+/*!
+ * \brief MediaServer::setMaxTransfers
+ * \param nTransfers The clients transferring at the same time from all
+ * the namespaces (0 = unlimited). The others wait in a queue.
+ */
+void
+MediaServer::setMaxTransfers(int nTransfers) {
+    transferSlots.setLimit(nTransfers);
+}
+
+
+/*!
+ * \brief MediaServer::onStartServer
+ * Start listening and start all the namespaces
+ */
+void
+MediaServer::onStartServer() {
+    if(port == 0) {
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   serverName +
+                   QString(" Error! Server port not set."));
+        emit mediaServerDone(true);// Close with errors
+        return;
+    }
+
+    connect(this, SIGNAL(newConnection(QWebSocket*)),
+            this, SLOT(onNewConnection(QWebSocket*)));
+    connect(this, SIGNAL(netServerError(QWebSocketProtocol::CloseCode)),
+            this, SLOT(onMediaServerError(QWebSocketProtocol::CloseCode)));
+    prepareServer(port);
+
+    for(auto it=legacyPorts.constBegin(); it!=legacyPorts.constEnd(); ++it) {
+        auto* pLegacySocket = new QWebSocketServer(QStringLiteral("Server"),
+                                                   QWebSocketServer::NonSecureMode,
+                                                   this);
+        if(!pLegacySocket->listen(QHostAddress::Any, it.key())) {
+            logMessage(logFile,
+                       Q_FUNC_INFO,
+                       QString("%1 - Impossibile to listen port %2 !")
+                       .arg(serverName)
+                       .arg(it.key()));
+            delete pLegacySocket;
+            continue;
+        }
+        connect(pLegacySocket, SIGNAL(newConnection()),
+                this, SLOT(onNewLegacyConnection()));
+        legacySockets.insert(pLegacySocket, it.value());
+#ifdef LOG_VERBOSE
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("%1 - port %2 mapped to %3")
+                   .arg(serverName)
+                   .arg(it.key())
+                   .arg(it.value()));
+#endif
+    }
+
+    for(FileServer* pServer : qAsConst(namespaces))
+        pServer->onStartServer();
+}
+
+
+/*!
+ * \brief MediaServer::onNewConnection
+ * A client connected to the shared port: the path of the request
+ * selects the namespace
+ * \param pClient The websocket of the connected client
+ */
+void
+MediaServer::onNewConnection(QWebSocket *pClient) {
+    QString sNamespace = pClient->requestUrl().path();
+    while(sNamespace.startsWith(QString("/")))
+        sNamespace.remove(0, 1);
+    while(sNamespace.endsWith(QString("/")))
+        sNamespace.chop(1);
+    dispatch(pClient, sNamespace);
+}
+
+
+/*!
+ * \brief MediaServer::onNewLegacyConnection
+ * A client connected to the port of an old separate server
+ */
+void
+MediaServer::onNewLegacyConnection() {
+    auto* pLegacySocket = qobject_cast<QWebSocketServer*>(sender());
+    if(!pLegacySocket)
+        return;
+    const QString sNamespace = legacySockets.value(pLegacySocket);
+    while(pLegacySocket->hasPendingConnections()) {
+        QWebSocket* pClient = pLegacySocket->nextPendingConnection();
+        if(pClient)
+            dispatch(pClient, sNamespace);
+    }
+}
+
+
+/*!
+ * \brief MediaServer::dispatch
+ * Hand the client over to the File Server of its namespace
+ * \param pClient The websocket of the connected client
+ * \param sNamespace The requested namespace
+ */
+void
+MediaServer::dispatch(QWebSocket* pClient, const QString& sNamespace) {
+    FileServer* pServer = namespaces.value(sNamespace, nullptr);
+    if(!pServer) {
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   serverName +
+                   QString(" %1 asked for the unknown namespace \"%2\"")
+                   .arg(pClient->peerAddress().toString(), sNamespace));
+        pClient->close(QWebSocketProtocol::CloseCodePolicyViolated,
+                       tr("Unknown namespace"));
+        pClient->deleteLater();
+        return;
+    }
+#ifdef LOG_VERBOSE
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               serverName +
+               QString(" %1 connected to %2")
+               .arg(pClient->peerAddress().toString(), sNamespace));
+#endif
+    pServer->onNewConnection(pClient);
+}
+
+
+/*!
+ * \brief MediaServer::onMediaServerError
+ * The shared socket failed: all the namespaces are closed
+ */
+void
+MediaServer::onMediaServerError(QWebSocketProtocol::CloseCode code) {
+    for(FileServer* pServer : qAsConst(namespaces))
+        pServer->onFileServerError(code);
+    emit mediaServerDone(true);// Close Media Server with errors !
+}
+
+
+/*!
+ * \brief MediaServer::onCloseServer
+ * Close all the namespaces and then the server thread
+ */
+void
+MediaServer::onCloseServer() {
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               serverName +
+               QString(" Chunk cache: %1 hits, %2 misses, %3 merged reads")
+               .arg(chunkCache.hits())
+               .arg(chunkCache.misses())
+               .arg(chunkCache.merged()));
+    for(FileServer* pServer : qAsConst(namespaces))
+        pServer->onCloseServer();
+    for(auto it=legacySockets.constBegin(); it!=legacySockets.constEnd(); ++it) {
+        it.key()->disconnect();
+        if(it.key()->isListening())
+            it.key()->close();
+        delete it.key();
+    }
+    legacySockets.clear();
+    chunkCache.clear();
+    // NetServer::closeServer() calls
+    // thread()->quit()
+    // to quit the processing thread
+    if(pServerSocket)
+        NetServer::closeServer();
+    else
+        thread()->quit();
+}
@@ -0,0 +1,73 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef MEDIASERVER_H
+#define MEDIASERVER_H
+
+#include "netServer.h"
+#include "chunkcache.h"
+#include "transferslots.h"
+
+#include <QMap>
+#include <QHash>
+
+QT_FORWARD_DECLARE_CLASS(QWebSocket)
+QT_FORWARD_DECLARE_CLASS(QWebSocketServer)
+QT_FORWARD_DECLARE_CLASS(QThreadPool)
+QT_FORWARD_DECLARE_CLASS(FileServer)
+
+
+class MediaServer : public NetServer
+{
+    Q_OBJECT
+public:
+    explicit MediaServer(const QString& sName, QFile* myLogFile = nullptr, QObject *parent = nullptr);
+    void setServerPort(quint16 myPort);
+    void addNamespace(const QString& sNamespace, FileServer* pServer, quint16 legacyPort = 0);
+    void setReaderThreads(int nThreads);
+    void setChunkCacheSize(qint64 maxBytes);
+    void setMaxTransfers(int nTransfers);
+
+signals:
+    void mediaServerDone(bool);
+
+public slots:
+    void onStartServer();
+    void onCloseServer();
+
+private slots:
+    void onNewConnection(QWebSocket *pClient);
+    void onNewLegacyConnection();
+    void onMediaServerError(QWebSocketProtocol::CloseCode code);
+
+private:
+    void dispatch(QWebSocket* pClient, const QString& sNamespace);
+
+private:
+    QString                      serverName;
+    quint16                      port;
+    QMap<QString, FileServer*>   namespaces;
+    QMap<quint16, QString>       legacyPorts;
+    QHash<QWebSocketServer*, QString> legacySockets;
+    QThreadPool*                 pReaderPool;  // Shared by all the namespaces
+    ChunkCache                   chunkCache;   // Shared by all the namespaces
+    TransferSlots                transferSlots; // Shared by all the namespaces
+};
+
+#endif // MEDIASERVER_H
@@ -0,0 +1,526 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#include "multicastsender.h"
+#include "fileserver.h"
+#include "chunkheader.h"
+#include "utility.h"
+
+#include <QUdpSocket>
+#include <QTimer>
+#include <QFileInfo>
+#include <QDateTime>
+
+
+// Interval between the bursts of datagrams (ms)
+#define MULTICAST_TICK              2
+// Longest wait of the rate limiters before checking again (ms)
+#define MULTICAST_MAX_WAIT          100
+// Most datagrams sent in a burst
+#define MULTICAST_MAX_BURST         32
+// Size of the file reads
+#define MULTICAST_READ_BLOCK        (64*1024)
+// Default sending rate (bytes/s)
+#define MULTICAST_DEFAULT_RATE      (2*1024*1024)
+// After these repair passes the receivers have to use <get>
+#define MULTICAST_MAX_REPAIR_ROUNDS 8
+// Files remembered for the repairs
+#define MULTICAST_MAX_TRANSFERS     64
+
+
+/*!
+ * \brief MulticastSender::MulticastSender It sends the files of a FileServer
+ * to a multicast group: all the panels receive the same datagrams so the
+ * library crosses the network once, plus the repairs.
+ * The files are sent as they are: the slides scaled for a panel
+ * resolution are never multicast.
+ * \param pServer The File Server owning the files
+ * \param _logFile The File for message logging (if any)
+ * \param parent
+ */
+MulticastSender::MulticastSender(FileServer* pServer, QFile* _logFile, QObject *parent)
+    : QObject(parent)
+    , pFileServer(pServer)
+    , logFile(_logFile)
+    , pSocket(nullptr)
+    , pSendTimer(nullptr)
+    , port(0)
+    , pacing(MULTICAST_DEFAULT_RATE)
+    , pGlobalBucket(nullptr)
+    , blockPos(0)
+    , bReadPending(false)
+{
+}
+
+
+MulticastSender::~MulticastSender() {
+    close();
+}
+
+
+/*!
+ * \brief MulticastSender::start
+ * \param groupAddress The multicast group of the receivers
+ * \param groupPort The port the receivers listen to
+ * \return true if the socket is ready
+ */
+bool
+MulticastSender::start(const QHostAddress& groupAddress, quint16 groupPort) {
+    close();
+    group = groupAddress;
+    port  = groupPort;
+    pSocket = new QUdpSocket(this);
+    if(!pSocket->bind(QHostAddress(QHostAddress::AnyIPv4), 0)) {
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("Unable to bind the multicast socket: %1")
+                   .arg(pSocket->errorString()));
+        delete pSocket;
+        pSocket = nullptr;
+        return false;
+    }
+    // Do not leave the local network
+    pSocket->setSocketOption(QAbstractSocket::MulticastTtlOption, 1);
+    pSocket->setSocketOption(QAbstractSocket::MulticastLoopbackOption, 1);
+    // Armed again after each burst as the rate limiters allow
+    pSendTimer = new QTimer(this);
+    pSendTimer->setSingleShot(true);
+    pSendTimer->setInterval(MULTICAST_TICK);
+    connect(pSendTimer, SIGNAL(timeout()),
+            this, SLOT(onSendDatagrams()));
+#ifdef LOG_VERBOSE
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               QString("Multicasting to %1:%2")
+               .arg(group.toString())
+               .arg(port));
+#endif
+    return true;
+}
+
+
+/*!
+ * \brief MulticastSender::close
+ * Stop sending and forget all the transfers
+ */
+void
+MulticastSender::close() {
+    delete pSendTimer;
+    pSendTimer = nullptr;
+    if(pSocket) {
+        pSocket->close();
+        delete pSocket;
+        pSocket = nullptr;
+    }
+    transfers.clear();
+    readBlock.clear();
+    sBlockPath.clear();
+    bReadPending = false;
+}
+
+
+/*!
+ * \brief MulticastSender::setRate
+ * \param bytesPerSecond The sending rate (0 means unlimited)
+ */
+void
+MulticastSender::setRate(qint64 bytesPerSecond) {
+    pacing.setRate(bytesPerSecond);
+}
+
+
+/*!
+ * \brief MulticastSender::setGlobalLimiter
+ * \param pBucket The rate limiter shared with the other transfers (may be nullptr)
+ */
+void
+MulticastSender::setGlobalLimiter(TokenBucket* pBucket) {
+    pGlobalBucket = pBucket;
+}
+
+
+QHostAddress
+MulticastSender::groupAddress() const {
+    return group;
+}
+
+
+quint16
+MulticastSender::groupPort() const {
+    return port;
+}
+
+
+bool
+MulticastSender::isActive() const {
+    return pSocket != nullptr;
+}
+
+
+/*!
+ * \brief MulticastSender::sendFile
+ * Schedule a file for the group. A file already being sent is not
+ * sent again: the late receivers ask for the missing ranges instead.
+ * \param sFileName The requested file
+ * \return false if the file is unknown
+ */
+bool
+MulticastSender::sendFile(const QString& sFileName) {
+    if(!pSocket)
+        return false;
+    int i = findTransfer(sFileName);
+    if(i >= 0) {
+        if(!isPending(transfers.at(i))) {
+            // Sent some time ago: send it again
+            Transfer& transfer = transfers[i];
+            transfer.nextPos      = 0;
+            transfer.repairRounds = 0;
+            transfer.bAnnounced   = false;
+            transfer.bPassEnded   = false;
+            transfer.idleSince    = 0;
+        }
+    }
+    else if(!addTransfer(sFileName)) {
+        return false;
+    }
+    if(!pSendTimer->isActive())
+        pSendTimer->start();
+    return true;
+}
+
+
+/*!
+ * \brief MulticastSender::repair
+ * Send again to the group the ranges lost by a receiver.
+ * The ranges asked by several receivers are sent once: all the requests
+ * arriving before the repair pass ends are merged in the same pass.
+ * \param sFileName The file
+ * \param ranges The missing ranges
+ * \return false if the file is unknown or has been repaired too many times:
+ * the receiver has to <get> the missing chunks
+ */
+bool
+MulticastSender::repair(const QString& sFileName, const RangeList& ranges) {
+    if(!pSocket)
+        return false;
+    int i = findTransfer(sFileName);
+    if(i < 0) {
+        if(!addTransfer(sFileName))
+            return false;
+        i = findTransfer(sFileName);
+        transfers[i].nextPos = transfers.at(i).size; // Only the ranges
+    }
+    Transfer& transfer = transfers[i];
+    if(transfer.bPassEnded && transfer.repairs.isEmpty()) {
+        // A new repair pass
+        if(transfer.repairRounds >= MULTICAST_MAX_REPAIR_ROUNDS)
+            return false;
+        transfer.repairRounds++;
+    }
+    for(const auto& range : ranges) {
+        qint64 startPos = qMax(qint64(0), range.first);
+        qint64 endPos   = qMin(transfer.size, range.first+range.second);
+        if(endPos <= startPos)
+            continue;
+        // Merge with the ranges already scheduled
+        bool bMerged = false;
+        for(auto& scheduled : transfer.repairs) {
+            if((startPos <= scheduled.second) && (endPos >= scheduled.first)) {
+                scheduled.first  = qMin(scheduled.first,  startPos);
+                scheduled.second = qMax(scheduled.second, endPos);
+                bMerged = true;
+                break;
+            }
+        }
+        if(!bMerged)
+            transfer.repairs.append(qMakePair(startPos, endPos));
+    }
+    transfer.bPassEnded = false;
+    transfer.idleSince  = 0;
+    if(!pSendTimer->isActive())
+        pSendTimer->start();
+    return true;
+}
+
+
+/*!
+ * \brief MulticastSender::forgetFile
+ * The file has changed or has been removed
+ * \param sFileName The file name
+ */
+void
+MulticastSender::forgetFile(const QString& sFileName) {
+    int i = findTransfer(sFileName);
+    if(i >= 0) {
+        if(sBlockPath == transfers.at(i).sFilePath) {
+            readBlock.clear();
+            sBlockPath.clear();
+        }
+        transfers.remove(i);
+    }
+}
+
+
+int
+MulticastSender::findTransfer(const QString& sFileName) const {
+    for(int i=0; i<transfers.count(); i++) {
+        if(transfers.at(i).sFileName == sFileName)
+            return i;
+    }
+    return -1;
+}
+
+
+/*!
+ * \brief MulticastSender::addTransfer
+ * \param sFileName The file to send
+ * \return false if the file is not served
+ */
+bool
+MulticastSender::addTransfer(const QString& sFileName) {
+    QFileInfo fileInfo;
+    QString sETag;
+    if(!pFileServer->httpResource(sFileName, QSize(), &fileInfo, &sETag))
+        return false;
+    // Make room dropping the files sent long ago
+    while(transfers.count() >= MULTICAST_MAX_TRANSFERS) {
+        int iOldest = -1;
+        for(int i=0; i<transfers.count(); i++) {
+            if(isPending(transfers.at(i)))
+                continue;
+            if((iOldest < 0) || (transfers.at(i).idleSince < transfers.at(iOldest).idleSince))
+                iOldest = i;
+        }
+        if(iOldest < 0)
+            return false; // Too many files in flight
+        transfers.remove(iOldest);
+    }
+    Transfer transfer;
+    transfer.sFileName    = sFileName;
+    transfer.sFilePath    = fileInfo.absoluteFilePath();
+    transfer.fileId       = chunkFileId(sFileName);
+    transfer.size         = fileInfo.size();
+    transfer.lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+    transfer.nextPos      = 0;
+    transfer.repairRounds = 0;
+    transfer.bAnnounced   = false;
+    transfer.bPassEnded   = false;
+    transfer.idleSince    = 0;
+    transfers.append(transfer);
+#ifdef LOG_VERBOSE
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               QString("Multicasting %1 (%2 bytes)")
+               .arg(sFileName)
+               .arg(transfer.size));
+#endif
+    return true;
+}
+
+
+bool
+MulticastSender::isPending(const Transfer& transfer) const {
+    return !transfer.bAnnounced            ||
+           (transfer.nextPos < transfer.size) ||
+           !transfer.repairs.isEmpty()       ||
+           !transfer.bPassEnded;
+}
+
+
+/*!
+ * \brief MulticastSender::nextTransfer
+ * \return The pending transfer of the file that will be played first (-1 if none)
+ */
+int
+MulticastSender::nextTransfer() const {
+    int iNext = -1;
+    int nextRank = 0;
+    for(int i=0; i<transfers.count(); i++) {
+        if(!isPending(transfers.at(i)))
+            continue;
+        int rank = pFileServer->playRank(transfers.at(i).sFileName);
+        if((iNext < 0) || (rank < nextRank)) {
+            iNext = i;
+            nextRank = rank;
+        }
+    }
+    return iNext;
+}
+
+
+/*!
+ * \brief MulticastSender::datagram
+ * \return The datagram with the given flags and payload
+ */
+QByteArray
+MulticastSender::datagram(const Transfer& transfer, quint8 flags, qint64 offset, const QByteArray& payload) {
+    ChunkHeader header;
+    header.flags     = flags;
+    header.requestId = 0;
+    header.fileId    = transfer.fileId;
+    header.offset    = quint64(offset);
+    header.length    = quint32(payload.size());
+    header.fileSize  = quint64(transfer.size);
+    return encodeChunkFrameV2(header, payload);
+}
+
+
+/*!
+ * \brief MulticastSender::readData
+ * The file is read in blocks by the FileServer reader threads and
+ * the datagrams are sliced out of them
+ * \param transfer The file
+ * \param startPos The first byte of the datagram
+ * \param length The bytes of the datagram
+ * \param pPayload Where to store the data
+ * \return false if the block is being read: onBlockRead() goes on
+ */
+bool
+MulticastSender::readData(const Transfer& transfer, qint64 startPos, qint64 length, QByteArray* pPayload) {
+    if((sBlockPath == transfer.sFilePath) &&
+       (startPos >= blockPos)             &&
+       (startPos+length <= blockPos+readBlock.size()))
+    {
+        *pPayload = readBlock.mid(int(startPos-blockPos), int(length));
+        return true;
+    }
+    if(bReadPending)
+        return false;
+    ChunkRequest request;
+    request.pClient      = nullptr;
+    request.sFileName    = transfer.sFileName;
+    request.sFilePath    = transfer.sFilePath;
+    request.fileSize     = transfer.size;
+    request.lastModified = transfer.lastModified;
+    request.startPos     = startPos;
+    request.length       = qMin(qint64(MULTICAST_READ_BLOCK), transfer.size-startPos);
+    request.requestId    = 0;
+    request.bTagged      = false;
+    request.bStream      = false;
+    request.playRank     = pFileServer->playRank(transfer.sFileName);
+    request.bPrefetch    = false;
+    request.bMulticast   = true;
+    bReadPending = true;
+    pFileServer->readChunkAsync(request);
+    return false;
+}
+
+
+/*!
+ * \brief MulticastSender::onBlockRead
+ * Invoked by the FileServer when a block of a file has been read
+ * \param request The block read (empty on errors)
+ */
+void
+MulticastSender::onBlockRead(const ChunkRequest& request) {
+    bReadPending = false;
+    if(!pSocket)
+        return;
+    // A file forgotten in the meantime does not stop the other transfers
+    int i = findTransfer(request.sFileName);
+    if((i >= 0) && (transfers.at(i).sFilePath == request.sFilePath)) {
+        if(request.data.isEmpty()) {// Read error !
+            logMessage(logFile,
+                       Q_FUNC_INFO,
+                       QString("Error reading %1 at %2")
+                       .arg(request.sFileName)
+                       .arg(request.startPos));
+            transfers.remove(i);
+        }
+        else {
+            readBlock  = request.data;
+            sBlockPath = request.sFilePath;
+            blockPos   = request.startPos;
+        }
+    }
+    if(!pSendTimer->isActive())
+        pSendTimer->start();
+}
+
+
+/*!
+ * \brief MulticastSender::onSendDatagrams
+ * Send a burst of datagrams within the allowed rate.
+ * The repairs of a file are sent before the rest of it.
+ * The timer is armed again for when the rate limiters allow to go on.
+ */
+void
+MulticastSender::onSendDatagrams() {
+    qint64 wait = MULTICAST_TICK;
+    for(int nSent=0; nSent<MULTICAST_MAX_BURST; nSent++) {
+        int i = nextTransfer();
+        if(i < 0)
+            return; // Started again by sendFile() or repair()
+        if(!pacing.isAvailable()) {
+            wait = pacing.msecsToAvailable();
+            break;
+        }
+        if(pGlobalBucket && !pGlobalBucket->isAvailable()) {
+            wait = pGlobalBucket->msecsToAvailable();
+            break;
+        }
+        Transfer& transfer = transfers[i];
+        QByteArray message;
+        qint64 startPos = 0;
+        qint64 length   = 0;
+        bool bRepair    = false;
+        if(!transfer.bAnnounced) {
+            message = datagram(transfer, CHUNK_FLAG_ANNOUNCE, transfer.lastModified,
+                               transfer.sFileName.toUtf8());
+        }
+        else if(!transfer.repairs.isEmpty() || (transfer.nextPos < transfer.size)) {
+            bRepair  = !transfer.repairs.isEmpty();
+            startPos = bRepair ? transfer.repairs.first().first : transfer.nextPos;
+            qint64 endPos = bRepair ? transfer.repairs.first().second : transfer.size;
+            length   = qMin(qint64(MULTICAST_PAYLOAD_SIZE), endPos-startPos);
+            QByteArray payload;
+            if(!readData(transfer, startPos, length, &payload))
+                return; // Started again by onBlockRead()
+            quint8 flags = (startPos+length >= transfer.size) ? CHUNK_FLAG_LAST : 0;
+            message = datagram(transfer, flags, startPos, payload);
+        }
+        else {
+            message = datagram(transfer, CHUNK_FLAG_PASS_END, transfer.size, QByteArray());
+        }
+        if(pSocket->writeDatagram(message, group, port) != message.size())
+            break; // Probably the socket buffer is full: retry later
+        // Charged only when sent
+        pacing.consume(message.size());
+        if(pGlobalBucket)
+            pGlobalBucket->consume(message.size());
+        if(!transfer.bAnnounced) {
+            transfer.bAnnounced = true;
+        }
+        else if(length > 0) {
+            if(bRepair) {
+                transfer.repairs.first().first += length;
+                if(transfer.repairs.first().first >= transfer.repairs.first().second)
+                    transfer.repairs.removeFirst();
+            }
+            else {
+                transfer.nextPos += length;
+            }
+        }
+        else {
+            transfer.bPassEnded = true;
+            transfer.idleSince  = QDateTime::currentMSecsSinceEpoch();
+        }
+    }
+    pSendTimer->start(int(qBound(qint64(MULTICAST_TICK), wait, qint64(MULTICAST_MAX_WAIT))));
+}
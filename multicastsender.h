@@ -0,0 +1,106 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef MULTICASTSENDER_H
+#define MULTICASTSENDER_H
+
+#include <QObject>
+#include <QHostAddress>
+#include <QVector>
+#include <QPair>
+#include <QFile>
+
+#include "tokenbucket.h"
+#include "chunkreader.h"
+
+QT_FORWARD_DECLARE_CLASS(QUdpSocket)
+QT_FORWARD_DECLARE_CLASS(QTimer)
+QT_FORWARD_DECLARE_CLASS(FileServer)
+
+// Every datagram is a version 2 chunk frame (see chunkheader.h) with
+// a request ID of 0. A file is sent as:
+//  - an announce datagram (CHUNK_FLAG_ANNOUNCE) with its name,
+//  - the data datagrams, the last one flagged with CHUNK_FLAG_LAST,
+//  - a pass end datagram (CHUNK_FLAG_PASS_END).
+// The receivers ask for the missing ranges with <multicast_nack> and
+// these are sent again to the whole group, followed by a new pass end.
+#define MULTICAST_PAYLOAD_SIZE  1400
+
+
+class MulticastSender : public QObject
+{
+    Q_OBJECT
+public:
+    typedef QVector<QPair<qint64, qint64>> RangeList; // startPos, length
+
+    explicit MulticastSender(FileServer* pServer, QFile* _logFile = nullptr, QObject *parent = nullptr);
+    ~MulticastSender();
+    bool         start(const QHostAddress& groupAddress, quint16 groupPort);
+    void         close();
+    void         setRate(qint64 bytesPerSecond);
+    void         setGlobalLimiter(TokenBucket* pBucket);
+    bool         sendFile(const QString& sFileName);
+    bool         repair(const QString& sFileName, const RangeList& ranges);
+    void         forgetFile(const QString& sFileName);
+    QHostAddress groupAddress() const;
+    quint16      groupPort() const;
+    bool         isActive() const;
+    void         onBlockRead(const ChunkRequest& request);
+
+private slots:
+    void onSendDatagrams();
+
+private:
+    struct Transfer {
+        QString  sFileName;
+        QString  sFilePath;
+        quint32  fileId;
+        qint64   size;
+        qint64   lastModified; // msecs since epoch
+        qint64   nextPos;      // The next byte of the first pass
+        QVector<QPair<qint64, qint64>> repairs; // startPos, endPos
+        int      repairRounds; // The repair passes done
+        bool     bAnnounced;
+        bool     bPassEnded;
+        qint64   idleSince;    // msecs since epoch (0 while sending)
+    };
+    int        findTransfer(const QString& sFileName) const;
+    int        nextTransfer() const;
+    bool       addTransfer(const QString& sFileName);
+    bool       isPending(const Transfer& transfer) const;
+    QByteArray datagram(const Transfer& transfer, quint8 flags, qint64 offset, const QByteArray& payload);
+    bool       readData(const Transfer& transfer, qint64 startPos, qint64 length, QByteArray* pPayload);
+
+private:
+    FileServer*       pFileServer;
+    QFile*            logFile;
+    QUdpSocket*       pSocket;
+    QTimer*           pSendTimer;
+    QHostAddress      group;
+    quint16           port;
+    TokenBucket       pacing;
+    TokenBucket*      pGlobalBucket;
+    QVector<Transfer> transfers;
+    QByteArray        readBlock;   // The last block read from the disk
+    QString           sBlockPath;
+    qint64            blockPos;
+    bool              bReadPending; // A block is being read by the FileServer readers
+};
+
+#endif // MULTICASTSENDER_H
@@ -7,6 +7,7 @@
 #include <QUdpSocket>
 #include <QWebSocket>
 #include <QHBoxLayout>
+#include <QTimer>
 
 
 #include "scorecontroller.h"
@@ -17,6 +18,15 @@
 #define SERVER_SOCKET_PORT  45454
 #define SPOT_UPDATER_PORT   45455
 #define SLIDE_UPDATER_PORT  45456
+#define SPOT_HTTP_PORT      45457
+#define SLIDE_HTTP_PORT     45458
+#define MEDIA_SERVER_PORT   45459
+#define SPOT_MULTICAST_PORT  45460
+#define SLIDE_MULTICAST_PORT 45461
+// Administratively scoped group for the media distribution
+#define MEDIA_MULTICAST_GROUP "239.255.45.1"
+// Longest wait for the Media Server to close its namespaces (ms)
+#define MEDIA_CLOSE_TIMEOUT  5000
 
 
 ScoreController::ScoreController(QWidget *parent)
@@ -28,11 +38,21 @@ ScoreController::ScoreController(QWidget *parent)
     , discoveryAddress(QHostAddress("224.0.0.1"))
     , pSlideUpdaterServer(nullptr)
     , pSpotUpdaterServer(nullptr)
+    , pAppUpdaterServer(nullptr)
     , serverPort(SERVER_SOCKET_PORT)
+    , pMediaServer(nullptr)
+    , pMediaServerThread(nullptr)
+    , mediaServerPort(MEDIA_SERVER_PORT)
     , spotUpdaterPort(SPOT_UPDATER_PORT)
-    , pSpotServerThread(nullptr)
-    , pSlideServerThread(nullptr)
     , slideUpdaterPort(SLIDE_UPDATER_PORT)
+    , spotHttpPort(SPOT_HTTP_PORT)
+    , slideHttpPort(SLIDE_HTTP_PORT)
+    , multicastGroup(QHostAddress(MEDIA_MULTICAST_GROUP))
+    , spotMulticastPort(SPOT_MULTICAST_PORT)
+    , slideMulticastPort(SLIDE_MULTICAST_PORT)
+    , playTransferRate(0)
+    , playClientTransferRate(0)
+    , bMatchPlaying(false)
 {
     // For Message Logging...
     pLogFile = nullptr;
@@ -72,10 +92,86 @@ ScoreController::ScoreController(QWidget *parent)
 
     connectButtonSignals();
 
+    // The media transfers are slowed down while the match is played
+    pTransferPauseTimer = new QTimer(this);
+    pTransferPauseTimer->setSingleShot(true);
+    connect(pTransferPauseTimer, SIGNAL(timeout()),
+            this, SLOT(onTransferPauseDone()));
+
     myStatus = showPanel;
 }
 
 
+/*!
+ * \brief ScoreController::setMediaRates
+ * Set the limits of the slides and spots transfers while the match
+ * is played, so that they do not delay the score updates.
+ * There are no limits during timeouts and between sets.
+ * \param playRate The total rate (bytes/s, 0 = unlimited)
+ * \param playClientRate The rate of each panel (bytes/s, 0 = unlimited)
+ */
+void
+ScoreController::setMediaRates(qint64 playRate, qint64 playClientRate) {
+    playTransferRate       = playRate;
+    playClientTransferRate = playClientRate;
+    if(bMatchPlaying) {
+        bMatchPlaying = false;
+        matchPlaying();
+    }
+}
+
+
+/*!
+ * \brief ScoreController::matchPlaying
+ * The rallies are going on: limit the media transfers
+ */
+void
+ScoreController::matchPlaying() {
+    pTransferPauseTimer->stop();
+    if(bMatchPlaying)
+        return;
+    bMatchPlaying = true;
+    transferBucket.setRate(playTransferRate);
+    emit setClientTransferRate(playClientTransferRate);
+#ifdef LOG_VERBOSE
+    logMessage(pLogFile,
+               Q_FUNC_INFO,
+               QString("Media transfers limited to %1 bytes/s (%2 bytes/s per panel)")
+               .arg(playTransferRate)
+               .arg(playClientTransferRate));
+#endif
+}
+
+
+/*!
+ * \brief ScoreController::matchPaused
+ * A timeout or a break between sets: the media transfers can go at full speed
+ * \param iSeconds The duration of the pause (0 until the play restarts)
+ */
+void
+ScoreController::matchPaused(int iSeconds) {
+    pTransferPauseTimer->stop();
+    if(iSeconds > 0)
+        pTransferPauseTimer->start(iSeconds*1000);
+    if(!bMatchPlaying)
+        return;
+    bMatchPlaying = false;
+    transferBucket.setRate(0);
+    emit setClientTransferRate(0);
+#ifdef LOG_VERBOSE
+    logMessage(pLogFile,
+               Q_FUNC_INFO,
+               QString("Media transfers not limited"));
+#endif
+}
+
+
+void
+ScoreController::onTransferPauseDone() {
+    matchPlaying();
+}
+
+
 ScoreController::~ScoreController() {
 }
 
@@ -328,8 +424,7 @@ ScoreController::prepareServices() {
         close();
     }
     else {
-        prepareSpotUpdateService();
-        prepareSlideUpdateService();
+        prepareMediaService();
     }
 }
 
@@ -400,19 +495,50 @@ ScoreController::prepareServer() {
     return true;
 }
 
+// A single Media Server, in its own thread, hosts the Spot, Slide
+// and application update File Servers as namespaces sharing one port
+void
+ScoreController::prepareMediaService() {
+    pMediaServer = new MediaServer(QString("MediaServer"), pLogFile, nullptr);
+    connect(pMediaServer, SIGNAL(mediaServerDone(bool)),
+            this, SLOT(onMediaServerDone(bool)));
+    pMediaServer->setServerPort(mediaServerPort);
+    prepareSpotUpdateService();
+    prepareSlideUpdateService();
+    prepareAppUpdateService();
+    pMediaServerThread = new QThread();
+    pMediaServer->moveToThread(pMediaServerThread);
+    connect(this, SIGNAL(startMediaServer()),
+            pMediaServer, SLOT(onStartServer()));
+    connect(this, SIGNAL(closeMediaServer()),
+            pMediaServer, SLOT(onCloseServer()));
+    pMediaServerThread->start(QThread::LowestPriority);
+}
+
+// Close the Media Server and wait for its thread to end: the File
+// Servers log their statistics and stop their reader threads
+void
+ScoreController::closeMediaService() {
+    if(!pMediaServerThread || !pMediaServerThread->isRunning())
+        return;
+    emit closeMediaServer();
+    if(!pMediaServerThread->wait(MEDIA_CLOSE_TIMEOUT))
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("The Media Server did not close in time"));
+}
+
 void
 ScoreController::prepareSpotUpdateService() {
     pSpotUpdaterServer = new FileServer(QString("SpotUpdater"), pLogFile, nullptr);
     connect(pSpotUpdaterServer, SIGNAL(fileServerDone(bool)),
             this, SLOT(onSpotServerDone(bool)));
-    pSpotUpdaterServer->setServerPort(spotUpdaterPort);
-    pSpotServerThread = new QThread();
-    pSpotUpdaterServer->moveToThread(pSpotServerThread);
-    connect(this, SIGNAL(startSpotServer()),
-            pSpotUpdaterServer, SLOT(onStartServer()));
-    connect(this, SIGNAL(closeSpotServer()),
-            pSpotUpdaterServer, SLOT(onCloseServer()));
-    pSpotServerThread->start(QThread::LowestPriority);
+    pMediaServer->addNamespace(QString("spots"), pSpotUpdaterServer, spotUpdaterPort);
+    connect(this, SIGNAL(setSpotDir(QString,QString)),
+            pSpotUpdaterServer, SLOT(onSetDir(QString,QString)));
+    connect(this, SIGNAL(setClientTransferRate(qint64)),
+            pSpotUpdaterServer, SLOT(onSetClientRate(qint64)));
+    pSpotUpdaterServer->setGlobalLimiter(&transferBucket);
 }
 
 void
@@ -420,14 +546,28 @@ ScoreController::prepareSlideUpdateService() {
     pSlideUpdaterServer = new FileServer(QString("SlideUpdater"), pLogFile, nullptr);
     connect(pSlideUpdaterServer, SIGNAL(fileServerDone(bool)),
             this, SLOT(onSlideServerDone(bool)));
-    pSlideUpdaterServer->setServerPort(slideUpdaterPort);
-    pSlideServerThread = new QThread();
-    pSlideUpdaterServer->moveToThread(pSlideServerThread);
-    connect(this, SIGNAL(startSlideServer()),
-            pSlideUpdaterServer, SLOT(onStartServer()));
-    connect(this, SIGNAL(closeSlideServer()),
-            pSlideUpdaterServer, SLOT(onCloseServer()));
-    pSlideServerThread->start(QThread::LowestPriority);
+    pMediaServer->addNamespace(QString("slides"), pSlideUpdaterServer, slideUpdaterPort);
+    connect(this, SIGNAL(setSlideDir(QString,QString)),
+            pSlideUpdaterServer, SLOT(onSetDir(QString,QString)));
+    connect(this, SIGNAL(setClientTransferRate(qint64)),
+            pSlideUpdaterServer, SLOT(onSetClientRate(qint64)));
+    pSlideUpdaterServer->setGlobalLimiter(&transferBucket);
+}
+
+// The panel application builds are only reachable through
+// the "updates" namespace and are sent as binary deltas
+void
+ScoreController::prepareAppUpdateService() {
+    pAppUpdaterServer = new FileServer(QString("AppUpdater"), pLogFile, nullptr);
+    connect(pAppUpdaterServer, SIGNAL(fileServerDone(bool)),
+            this, SLOT(onUpdateServerDone(bool)));
+    pMediaServer->addNamespace(QString("updates"), pAppUpdaterServer, 0);
+    connect(this, SIGNAL(setUpdateDir(QString,QString)),
+            pAppUpdaterServer, SLOT(onSetDir(QString,QString)));
+    connect(this, SIGNAL(setClientTransferRate(qint64)),
+            pAppUpdaterServer, SLOT(onSetClientRate(qint64)));
+    pAppUpdaterServer->setGlobalLimiter(&transferBucket);
+    pAppUpdaterServer->setUpdateDeltas(true);
 }
 
 
@@ -653,6 +793,44 @@ ScoreController::onSlideServerDone(bool bError) {
 }
 
 
+void
+ScoreController::onUpdateServerDone(bool bError) {
+    Q_UNUSED(bError)
+#ifdef LOG_VERBOSE
+    // Log a Message just to inform
+    if(bError) {
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("Update server stopped with errors"));
+    }
+    else {
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("Update server stopped without errors"));
+    }
+#endif
+}
+
+
+void
+ScoreController::onMediaServerDone(bool bError) {
+    Q_UNUSED(bError)
+#ifdef LOG_VERBOSE
+    // Log a Message just to inform
+    if(bError) {
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("Media server stopped with errors"));
+    }
+    else {
+        logMessage(pLogFile,
+                   Q_FUNC_INFO,
+                   QString("Media server stopped without errors"));
+    }
+#endif
+}
+
+
 void
 ScoreController::onSpotServerDone(bool bError) {
     Q_UNUSED(bError)
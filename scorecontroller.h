@@ -8,6 +8,8 @@
 #include <QHostAddress>
 
 #include "fileserver.h"
+#include "mediaserver.h"
+#include "tokenbucket.h"
 #include "paneldirection.h"
 #include "generalsetuparguments.h"
 #include <connection.h>
@@ -18,6 +20,7 @@ QT_FORWARD_DECLARE_CLASS(QWebSocket)
 QT_FORWARD_DECLARE_CLASS(QHBoxLayout)
 QT_FORWARD_DECLARE_CLASS(QPushButton)
 QT_FORWARD_DECLARE_CLASS(ClientListDialog)
+QT_FORWARD_DECLARE_CLASS(QTimer)
 
 
 class ScoreController : public QMainWindow
@@ -29,19 +32,24 @@ public:
     ~ScoreController();
 
 signals:
-    void startSpotServer();
-    void closeSpotServer();
-    void startSlideServer();
-    void closeSlideServer();
+    void startMediaServer();
+    void closeMediaServer();
+    void setSpotDir(QString sDirectory, QString sExtensions);
+    void setSlideDir(QString sDirectory, QString sExtensions);
+    void setUpdateDir(QString sDirectory, QString sExtensions);
+    void setClientTransferRate(qint64 bytesPerSecond);
 
 protected slots:
     void onProcessConnectionRequest();
     void onNewConnection(QWebSocket *pClient);
     void onSpotServerDone(bool bError);
     void onSlideServerDone(bool bError);
+    void onUpdateServerDone(bool bError);
+    void onMediaServerDone(bool bError);
     void onProcessTextMessage(QString sMessage);
     void onProcessBinaryMessage(QByteArray message);
     void onClientDisconnected();
+    void onTransferPauseDone();
 
     void onButtonStartStopSpotLoopClicked();
     void onButtonStartStopSlideShowClicked();
@@ -69,8 +77,11 @@ protected:
     virtual void    SaveStatus();
     virtual void    GetGeneralSetup();
     void            prepareServices();
+    void            prepareMediaService();
+    void            closeMediaService();
     void            prepareSpotUpdateService();
     void            prepareSlideUpdateService();
+    void            prepareAppUpdateService();
     bool            prepareDiscovery();
     void            sendAcceptConnection(QUdpSocket *pDiscoverySocket, const QHostAddress& hostAddress, quint16 port);
     void            RemoveClient(const QHostAddress& hAddress);
@@ -81,6 +92,9 @@ protected:
     int             SendToAll(const QString& sMessage);
     QHBoxLayout*    CreateSpotButtons();
     void            connectButtonSignals();
+    void            setMediaRates(qint64 playRate, qint64 playClientRate);
+    void            matchPlaying();
+    void            matchPaused(int iSeconds);
 
 protected:
     GeneralSetupArguments generalSetupArguments;
@@ -103,12 +117,24 @@ protected:
     QList<Connection>     connectionList;
     FileServer*           pSlideUpdaterServer;
     FileServer*           pSpotUpdaterServer;
+    FileServer*           pAppUpdaterServer; // The panel application builds
     NetServer*            pPanelServer{};
     quint16               serverPort;
-    quint16               spotUpdaterPort;
-    QThread*              pSpotServerThread;
-    QThread*              pSlideServerThread;
-    quint16               slideUpdaterPort;
+    MediaServer*          pMediaServer;
+    QThread*              pMediaServerThread;
+    quint16               mediaServerPort;
+    quint16               spotUpdaterPort;  // Mapped to the "spots" namespace
+    quint16               slideUpdaterPort; // Mapped to the "slides" namespace
+    quint16               spotHttpPort;
+    quint16               slideHttpPort;
+    QHostAddress          multicastGroup;
+    quint16               spotMulticastPort;
+    quint16               slideMulticastPort;
+    TokenBucket           transferBucket; // Shared by the File Servers
+    qint64                playTransferRate;
+    qint64                playClientTransferRate;
+    bool                  bMatchPlaying;
+    QTimer*               pTransferPauseTimer;
     QPushButton*          startStopLoopSpotButton{};
     QPushButton*          startStopSlideShowButton{};
     QPushButton*          startStopLiveCameraButton{};
@@ -0,0 +1,447 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+
+#include "slidebundler.h"
+#include "xxhash64.h"
+#include "utility.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QHash>
+#include <QSaveFile>
+#include <QThread>
+#include <QtEndian>
+
+
+#define BUNDLE_BLOCK_SIZE (1024*1024)
+
+
+/*!
+ * \brief SlideBundler::SlideBundler
+ * Packs all the slides in a single file (the bundle) so that a panel can
+ * get the whole slide show with one streamed transfer instead of a
+ * request per slide. The table of contents at the end of the bundle
+ * allows a panel to get a single slide with a <get> of its byte range.
+ * When the slides change the new ones are appended to the bundle and
+ * only the table of contents is rewritten: a panel can keep the part
+ * of the bundle already received.
+ * \param sBundleFile The bundle file
+ * \param _logFile The File for message logging (if any)
+ * \param parent
+ */
+SlideBundler::SlideBundler(const QString& sBundleFile, QFile* _logFile, QObject *parent)
+    : QObject(parent)
+    , sBundleFileName(sBundleFile)
+    , logFile(_logFile)
+{
+}
+
+
+/*!
+ * \brief SlideBundler::onBuildBundle
+ * Bring the bundle up to date with the list of slides and emit bundleReady().
+ * The slides unchanged since the last build keep their place, the new
+ * and modified ones are appended. The bundle is compacted only when
+ * the space of the removed slides exceeds that of the slides in use.
+ * The bundle hash is the hash of the table of contents (that contains
+ * the hashes of all the slides).
+ * \param sRootDir The served directory: the slides are named by their path relative to it
+ * \param filePaths The full paths of the slides
+ */
+void
+SlideBundler::onBuildBundle(QString sRootDir, QStringList filePaths) {
+    QVector<BundleEntry> oldEntries;
+    QByteArray toc;
+    qint64 oldTocOffset = 0;
+    bool bValid = loadToc(&oldEntries, &toc, &oldTocOffset);
+    bool bChanged = !bValid;
+
+    QDir rootDir(sRootDir);
+    QHash<QString, QFileInfo> slides; // Keyed by name
+    for(const QString& sFilePath : qAsConst(filePaths)) {
+        QFileInfo fileInfo(sFilePath);
+        if(fileInfo.exists())
+            slides.insert(rootDir.relativeFilePath(sFilePath), fileInfo);
+    }
+
+    // The slides already in the bundle keep their place...
+    QVector<BundleEntry> entries;
+    QHash<QString, QString> sources; // The slide files keyed by name
+    qint64 liveSize = 0;
+    for(int i=0; i<oldEntries.count(); i++) {
+        const BundleEntry& entry = oldEntries.at(i);
+        auto it = slides.constFind(entry.sName);
+        if((it == slides.constEnd())         ||
+           (it->size() != entry.size)       ||
+           (it->lastModified().toMSecsSinceEpoch() != entry.lastModified))
+        {
+            bChanged = true;
+            continue;
+        }
+        entries.append(entry);
+        sources.insert(entry.sName, it->absoluteFilePath());
+        liveSize += entry.size;
+    }
+    int firstNew = entries.count();
+    // ...and the new ones are appended
+    for(const QString& sFilePath : qAsConst(filePaths)) {
+        const QString sName = rootDir.relativeFilePath(sFilePath);
+        if(!slides.contains(sName) || sources.contains(sName))
+            continue;
+        QFileInfo fileInfo = slides.value(sName);
+        BundleEntry entry;
+        entry.sName        = sName;
+        entry.offset       = 0;
+        entry.size         = fileInfo.size();
+        entry.lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+        entry.hash         = 0;
+        entries.append(entry);
+        sources.insert(entry.sName, fileInfo.absoluteFilePath());
+        bChanged = true;
+    }
+
+    if(!bChanged) {
+        qint64 size = QFileInfo(sBundleFileName).size();
+        emit bundleReady(sBundleFileName,
+                         size,
+                         XxHash64::hash(toc.constData(), toc.size()),
+                         oldTocOffset,
+                         entries.count());
+        return;
+    }
+
+    QDir().mkpath(QFileInfo(sBundleFileName).absolutePath());
+    qint64 dataSize = 0;
+    bool bDone;
+    if(bValid && (oldTocOffset-liveSize <= liveSize)) {
+        bDone = appendBundle(&entries, sources, firstNew, oldTocOffset, &dataSize);
+    }
+    else { // Compact the bundle
+        QVector<bool> inOldBundle(entries.count(), false);
+        for(int i=0; i<firstNew; i++)
+            inOldBundle[i] = true;
+        bDone = writeBundle(&entries, sources, inOldBundle, &dataSize);
+    }
+    if(!bDone) { // The bundle no more matches the slides
+        emit bundleFailed(sBundleFileName);
+        return;
+    }
+    toc = encodeToc(entries);
+#ifdef LOG_VERBOSE
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               QString("%1: %2 slides, %3 bytes")
+               .arg(sBundleFileName)
+               .arg(entries.count())
+               .arg(dataSize+toc.size()+BUNDLE_TRAILER_SIZE));
+#endif
+    emit bundleReady(sBundleFileName,
+                     dataSize+toc.size()+BUNDLE_TRAILER_SIZE,
+                     XxHash64::hash(toc.constData(), toc.size()),
+                     dataSize,
+                     entries.count());
+}
+
+
+/*!
+ * \brief SlideBundler::appendBundle
+ * Copy the slides already in the bundle, as they are, and write the new
+ * slides after them, followed by the new table of contents and trailer:
+ * the slides before keep their offsets.
+ * The file is replaced atomically: the reads in progress still see
+ * the old bundle and an interrupted update leaves it untouched.
+ * \param pEntries The slides: the first firstNew are already in the bundle
+ * \param sources The slide files keyed by name
+ * \param firstNew The first slide to append
+ * \param oldTocOffset The end of the slides already in the bundle
+ * \param pDataSize Where to store the new end of the slides
+ * \return true if the bundle has been updated
+ */
+bool
+SlideBundler::appendBundle(QVector<BundleEntry>* pEntries, const QHash<QString, QString>& sources,
+                           int firstNew, qint64 oldTocOffset, qint64* pDataSize) {
+    QFile oldBundle(sBundleFileName);
+    QSaveFile bundle(sBundleFileName);
+    if(!oldBundle.open(QIODevice::ReadOnly) || !bundle.open(QIODevice::WriteOnly)) {
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("Unable to update %1")
+                   .arg(sBundleFileName));
+        return false;
+    }
+    QByteArray block;
+    qint64 toCopy = oldTocOffset;
+    while(toCopy > 0) {
+        if(QThread::currentThread()->isInterruptionRequested()) {
+            bundle.cancelWriting();
+            return false;
+        }
+        block = oldBundle.read(qMin(toCopy, qint64(BUNDLE_BLOCK_SIZE)));
+        if(block.isEmpty() || (bundle.write(block) != block.size())) {
+            logMessage(logFile,
+                       Q_FUNC_INFO,
+                       QString("Error copying %1")
+                       .arg(sBundleFileName));
+            bundle.cancelWriting();
+            return false;
+        }
+        toCopy -= block.size();
+    }
+    oldBundle.close();
+    qint64 offset = oldTocOffset;
+    for(int i=firstNew; i<pEntries->count(); i++) {
+        if(QThread::currentThread()->isInterruptionRequested()) {
+            bundle.cancelWriting();
+            return false;
+        }
+        BundleEntry& entry = (*pEntries)[i];
+        QFile source(sources.value(entry.sName));
+        if(!source.open(QIODevice::ReadOnly)) {
+            logMessage(logFile,
+                       Q_FUNC_INFO,
+                       QString("Unable to open %1")
+                       .arg(source.fileName()));
+            bundle.cancelWriting();
+            return false;
+        }
+        if(!copySlide(&source, &bundle, &entry)) {
+            bundle.cancelWriting();
+            return false;
+        }
+        entry.offset = offset;
+        offset += entry.size;
+    }
+    QByteArray toc = encodeToc(*pEntries);
+    bundle.write(toc);
+    bundle.write(encodeTrailer(pEntries->count(), toc.size(), offset));
+    if(!bundle.commit()) {
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("Unable to write %1")
+                   .arg(sBundleFileName));
+        return false;
+    }
+    *pDataSize = offset;
+    return true;
+}
+
+
+/*!
+ * \brief SlideBundler::writeBundle
+ * Write the whole bundle, with no space left by the removed slides.
+ * The file is replaced atomically: the reads in progress still see
+ * the old bundle.
+ * \param pEntries The slides
+ * \param sources The slide files keyed by name
+ * \param inOldBundle true for the slides to copy from the old bundle
+ * \param pDataSize Where to store the end of the slides
+ * \return true if the bundle has been written
+ */
+bool
+SlideBundler::writeBundle(QVector<BundleEntry>* pEntries, const QHash<QString, QString>& sources,
+                          const QVector<bool>& inOldBundle, qint64* pDataSize) {
+    QFile oldBundle(sBundleFileName);
+    bool bOldBundle = inOldBundle.contains(true) && oldBundle.open(QIODevice::ReadOnly);
+    QSaveFile bundle(sBundleFileName);
+    if(!bundle.open(QIODevice::WriteOnly)) {
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("Unable to create %1")
+                   .arg(sBundleFileName));
+        return false;
+    }
+    qint64 offset = 0;
+    for(int i=0; i<pEntries->count(); i++) {
+        if(QThread::currentThread()->isInterruptionRequested()) {
+            bundle.cancelWriting();
+            return false;
+        }
+        BundleEntry& entry = (*pEntries)[i];
+        QFile source(sources.value(entry.sName));
+        QFile* pSource = &source;
+        if(bOldBundle && inOldBundle.at(i)) {
+            pSource = &oldBundle;
+            pSource->seek(entry.offset);
+        }
+        else if(!source.open(QIODevice::ReadOnly)) {
+            logMessage(logFile,
+                       Q_FUNC_INFO,
+                       QString("Unable to open %1")
+                       .arg(source.fileName()));
+            bundle.cancelWriting();
+            return false;
+        }
+        if(!copySlide(pSource, &bundle, &entry)) {
+            bundle.cancelWriting();
+            return false;
+        }
+        entry.offset = offset;
+        offset += entry.size;
+    }
+    QByteArray toc = encodeToc(*pEntries);
+    bundle.write(toc);
+    bundle.write(encodeTrailer(pEntries->count(), toc.size(), offset));
+    if(!bundle.commit()) {
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("Unable to write %1")
+                   .arg(sBundleFileName));
+        return false;
+    }
+    *pDataSize = offset;
+    return true;
+}
+
+
+/*!
+ * \brief SlideBundler::copySlide
+ * Copy a slide at the current position of the bundle and compute its hash
+ * \param pSource The slide (or the old bundle) positioned at its first byte
+ * \param pBundle The bundle
+ * \param pEntry The slide description: its hash is updated
+ * \return false on errors
+ */
+bool
+SlideBundler::copySlide(QFile* pSource, QFileDevice* pBundle, BundleEntry* pEntry) {
+    XxHash64 hasher;
+    QByteArray block;
+    qint64 toCopy = pEntry->size;
+    while(toCopy > 0) {
+        block = pSource->read(qMin(toCopy, qint64(BUNDLE_BLOCK_SIZE)));
+        if(block.isEmpty() || (pBundle->write(block) != block.size())) {
+            logMessage(logFile,
+                       Q_FUNC_INFO,
+                       QString("Error copying %1 into %2")
+                       .arg(pEntry->sName, sBundleFileName));
+            return false;
+        }
+        hasher.update(block.constData(), block.size());
+        toCopy -= block.size();
+    }
+    pEntry->hash = hasher.digest();
+    return true;
+}
+
+
+/*!
+ * \brief SlideBundler::loadToc
+ * Read the table of contents of the existing bundle
+ * \param pEntries Where to store the slides descriptions
+ * \param pToc Where to store the encoded table of contents
+ * \param pTocOffset Where to store the offset of the table of contents
+ * \return false if there is no valid bundle
+ */
+bool
+SlideBundler::loadToc(QVector<BundleEntry>* pEntries, QByteArray* pToc, qint64* pTocOffset) {
+    pEntries->clear();
+    QFile file(sBundleFileName);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+    qint64 size = file.size();
+    if(size < BUNDLE_TRAILER_SIZE)
+        return false;
+    file.seek(size-BUNDLE_TRAILER_SIZE);
+    QByteArray trailer = file.read(BUNDLE_TRAILER_SIZE);
+    if(trailer.size() != BUNDLE_TRAILER_SIZE)
+        return false;
+    auto* pData = reinterpret_cast<const uchar*>(trailer.constData());
+    if((qFromBigEndian<quint32>(pData)   != BUNDLE_MAGIC) ||
+       (qFromBigEndian<quint16>(pData+4) != BUNDLE_VERSION))
+        return false;
+    quint32 count     = qFromBigEndian<quint32>(pData+8);
+    quint32 tocLength = qFromBigEndian<quint32>(pData+12);
+    quint64 tocOffset = qFromBigEndian<quint64>(pData+16);
+    if(tocOffset+tocLength+BUNDLE_TRAILER_SIZE != quint64(size))
+        return false;
+    *pTocOffset = qint64(tocOffset);
+    file.seek(qint64(tocOffset));
+    *pToc = file.read(tocLength);
+    if(pToc->size() != int(tocLength))
+        return false;
+
+    pData = reinterpret_cast<const uchar*>(pToc->constData());
+    const uchar* pEnd = pData + pToc->size();
+    for(quint32 i=0; i<count; i++) {
+        if(pEnd-pData < 2)
+            return false;
+        int nameLength = qFromBigEndian<quint16>(pData);
+        pData += 2;
+        if(pEnd-pData < nameLength+32)
+            return false;
+        BundleEntry entry;
+        entry.sName        = QString::fromUtf8(reinterpret_cast<const char*>(pData), nameLength);
+        pData += nameLength;
+        entry.offset       = qint64(qFromBigEndian<quint64>(pData));
+        entry.size         = qint64(qFromBigEndian<quint64>(pData+8));
+        entry.lastModified = qFromBigEndian<qint64>(pData+16);
+        entry.hash         = qFromBigEndian<quint64>(pData+24);
+        pData += 32;
+        if((entry.offset < 0) || (entry.size < 0) || (entry.offset+entry.size > qint64(tocOffset)))
+            return false;
+        pEntries->append(entry);
+    }
+    return pData == pEnd;
+}
+
+
+/*!
+ * \brief SlideBundler::encodeToc
+ * \param entries The slides descriptions
+ * \return The encoded table of contents
+ */
+QByteArray
+SlideBundler::encodeToc(const QVector<BundleEntry>& entries) {
+    QByteArray toc;
+    uchar number[8];
+    for(const BundleEntry& entry : entries) {
+        QByteArray name = entry.sName.toUtf8().left(0xFFFF);
+        qToBigEndian(quint16(name.size()), number);
+        toc.append(reinterpret_cast<const char*>(number), 2);
+        toc.append(name);
+        qToBigEndian(quint64(entry.offset), number);
+        toc.append(reinterpret_cast<const char*>(number), 8);
+        qToBigEndian(quint64(entry.size), number);
+        toc.append(reinterpret_cast<const char*>(number), 8);
+        qToBigEndian(entry.lastModified, number);
+        toc.append(reinterpret_cast<const char*>(number), 8);
+        qToBigEndian(entry.hash, number);
+        toc.append(reinterpret_cast<const char*>(number), 8);
+    }
+    return toc;
+}
+
+
+/*!
+ * \brief SlideBundler::encodeTrailer
+ * \return The BUNDLE_TRAILER_SIZE bytes closing the bundle
+ */
+QByteArray
+SlideBundler::encodeTrailer(int count, qint64 tocLength, qint64 tocOffset) {
+    QByteArray ba(BUNDLE_TRAILER_SIZE, Qt::Uninitialized);
+    auto* pData = reinterpret_cast<uchar*>(ba.data());
+    qToBigEndian(quint32(BUNDLE_MAGIC),   pData);
+    qToBigEndian(quint16(BUNDLE_VERSION), pData+4);
+    qToBigEndian(quint16(0),              pData+6);
+    qToBigEndian(quint32(count),          pData+8);
+    qToBigEndian(quint32(tocLength),      pData+12);
+    qToBigEndian(quint64(tocOffset),      pData+16);
+    return ba;
+}
@@ -0,0 +1,96 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef SLIDEBUNDLER_H
+#define SLIDEBUNDLER_H
+
+#include <QObject>
+#include <QVector>
+#include <QStringList>
+#include <QHash>
+
+QT_FORWARD_DECLARE_CLASS(QFile)
+QT_FORWARD_DECLARE_CLASS(QFileDevice)
+
+// A slide bundle is the concatenation of all the slides followed
+// by a table of contents and by a fixed size trailer.
+// The new and the modified slides are written after the existing ones,
+// in place of the old table of contents, so that the slides already
+// there keep their offsets. The space of the removed slides is
+// reclaimed by rewriting the bundle when it exceeds that of the slides
+// in use. The bundle is always written to a new file that replaces
+// the old one when complete.
+// All the numbers are stored in network (big endian) order.
+//
+// Table of contents, one record per slide:
+//     quint16 name length
+//     name (UTF-8, relative to the served directory)
+//     quint64 offset of the slide in the bundle
+//     quint64 size of the slide
+//     qint64  modification time of the slide (msecs since epoch)
+//     quint64 xxHash64 of the slide
+//
+// Trailer (the last BUNDLE_TRAILER_SIZE bytes of the bundle):
+//  0  quint32 magic ('V','C','B','1')
+//  4  quint16 version
+//  6  quint16 flags (reserved)
+//  8  quint32 number of slides
+// 12  quint32 length of the table of contents
+// 16  quint64 offset of the table of contents
+#define BUNDLE_MAGIC            0x56434231
+#define BUNDLE_VERSION          1
+#define BUNDLE_TRAILER_SIZE     24
+
+
+class SlideBundler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SlideBundler(const QString& sBundleFile, QFile* _logFile = nullptr, QObject *parent = nullptr);
+
+signals:
+    void bundleReady(QString sBundlePath, qint64 size, quint64 hash, qint64 tocOffset, int count);
+    void bundleFailed(QString sBundlePath);
+
+public slots:
+    void onBuildBundle(QString sRootDir, QStringList filePaths);
+
+private:
+    struct BundleEntry {
+        QString sName;
+        qint64  offset;
+        qint64  size;
+        qint64  lastModified; // msecs since epoch
+        quint64 hash;
+    };
+    bool       loadToc(QVector<BundleEntry>* pEntries, QByteArray* pToc, qint64* pTocOffset);
+    bool       copySlide(QFile* pSource, QFileDevice* pBundle, BundleEntry* pEntry);
+    bool       writeBundle(QVector<BundleEntry>* pEntries, const QHash<QString, QString>& sources,
+                           const QVector<bool>& inOldBundle, qint64* pDataSize);
+    bool       appendBundle(QVector<BundleEntry>* pEntries, const QHash<QString, QString>& sources,
+                            int firstNew, qint64 oldTocOffset, qint64* pDataSize);
+    QByteArray encodeToc(const QVector<BundleEntry>& entries);
+    QByteArray encodeTrailer(int count, qint64 tocLength, qint64 tocOffset);
+
+private:
+    QString sBundleFileName;
+    QFile*  logFile;
+};
+
+#endif // SLIDEBUNDLER_H
@@ -0,0 +1,389 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+
+#include "slidepreprocessor.h"
+#include "xxhash64.h"
+#include "utility.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDirIterator>
+#include <QSaveFile>
+#include <QBuffer>
+#include <QImage>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QThread>
+#include <QtConcurrent>
+
+
+#define SLIDE_JPEG_QUALITY      85
+#define SLIDE_MAX_RESOLUTIONS   8
+
+
+/*!
+ * \brief SlidePreprocessor::SlidePreprocessor
+ * Scales the slides to the resolutions declared by the panels, so that
+ * a panel does not download (and decode) a picture far bigger than its
+ * screen. The scaling is done in parallel with QtConcurrent and the
+ * scaled slides are kept on disk, keyed by the size and the modification
+ * time of the original, so that they survive a restart.
+ * \param sCacheDir The directory where the scaled slides are stored
+ * \param _logFile The File for message logging (if any)
+ * \param parent
+ */
+SlidePreprocessor::SlidePreprocessor(const QString& sCacheDir, QFile* _logFile, QObject *parent)
+    : QObject(parent)
+    , sCacheDirName(sCacheDir)
+    , logFile(_logFile)
+    , bStopping(false)
+    , lastGeneration(0)
+{
+    // Leave a core for the servers
+    pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()-1));
+}
+
+
+SlidePreprocessor::~SlidePreprocessor() {
+    clear();
+}
+
+
+/*!
+ * \brief SlidePreprocessor::clear
+ * Drop the pending jobs and wait for the running ones
+ */
+void
+SlidePreprocessor::clear() {
+    bStopping = true;
+    pool.clear();
+    pool.waitForDone();
+    bStopping = false;
+    generations.clear();
+    variants.clear();
+}
+
+
+/*!
+ * \brief SlidePreprocessor::addResolution
+ * Register a panel resolution and scale all the slides for it
+ * \param resolution The panel resolution
+ */
+void
+SlidePreprocessor::addResolution(QSize resolution) {
+    if(resolutions.contains(resolution))
+        return;
+    if(resolutions.count() >= SLIDE_MAX_RESOLUTIONS) {
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("Too many panel resolutions: %1 ignored")
+                   .arg(resolutionKey(resolution)));
+        return;
+    }
+    resolutions.append(resolution);
+    for(auto it=generations.constBegin(); it!=generations.constEnd(); ++it)
+        schedule(it.key(), resolution);
+}
+
+
+/*!
+ * \brief SlidePreprocessor::setSlides
+ * Replace the whole set of slides (e.g. when the directory changes)
+ * \param slidePaths The full paths of the slides
+ */
+void
+SlidePreprocessor::setSlides(const QStringList& slidePaths) {
+    pool.clear(); // The running jobs will be discarded
+    generations.clear();
+    variants.clear();
+    for(const QString& sSlidePath : slidePaths)
+        generations.insert(sSlidePath, ++lastGeneration);
+    sweepCache(slidePaths);
+    for(const QString& sSlidePath : slidePaths) {
+        for(const QSize& resolution : qAsConst(resolutions))
+            schedule(sSlidePath, resolution);
+    }
+}
+
+
+/*!
+ * \brief SlidePreprocessor::updateSlides
+ * Scale again slides that have been added or modified
+ * \param slidePaths The full paths of the slides
+ */
+void
+SlidePreprocessor::updateSlides(const QStringList& slidePaths) {
+    for(const QString& sSlidePath : slidePaths) {
+        removeSlide(sSlidePath);
+        generations.insert(sSlidePath, ++lastGeneration);
+        for(const QSize& resolution : qAsConst(resolutions))
+            schedule(sSlidePath, resolution);
+    }
+}
+
+
+/*!
+ * \brief SlidePreprocessor::sweepCache
+ * Retire the scaled slides left in the cache directory by slides
+ * no longer present or modified since (e.g. while we were not running)
+ * \param slidePaths The full paths of the current slides
+ */
+void
+SlidePreprocessor::sweepCache(const QStringList& slidePaths) {
+    QSet<QString> currentKeys;
+    for(const QString& sSlidePath : slidePaths)
+        currentKeys.insert(variantKey(QFileInfo(sSlidePath)));
+    QDirIterator it(sCacheDirName, QDir::Files, QDirIterator::Subdirectories);
+    while(it.hasNext()) {
+        QString sFilePath = it.next();
+        if(!currentKeys.contains(it.fileInfo().completeBaseName()))
+            retiredFiles.insert(sFilePath);
+    }
+}
+
+
+/*!
+ * \brief SlidePreprocessor::removeSlide
+ * Forget a slide: its scaled versions are deleted by purgeRetired()
+ * when no transfer is reading them
+ * \param sSlidePath The full path of the slide
+ */
+void
+SlidePreprocessor::removeSlide(const QString& sSlidePath) {
+    generations.remove(sSlidePath);
+    auto it = variants.find(sSlidePath);
+    if(it == variants.end())
+        return;
+    for(const SlideVariant& slideVariant : qAsConst(*it)) {
+        if(!slideVariant.sFilePath.isEmpty())
+            retiredFiles.insert(slideVariant.sFilePath);
+    }
+    variants.erase(it);
+}
+
+
+bool
+SlidePreprocessor::hasRetired() const {
+    return !retiredFiles.isEmpty();
+}
+
+
+/*!
+ * \brief SlidePreprocessor::purgeRetired
+ * Delete the retired scaled slides
+ * \param inUse The files still read by a transfer: kept for later
+ */
+void
+SlidePreprocessor::purgeRetired(const QSet<QString>& inUse) {
+    for(auto it=retiredFiles.begin(); it!=retiredFiles.end(); ) {
+        if(inUse.contains(*it)) {
+            ++it;
+            continue;
+        }
+        if(QFile::exists(*it) && !QFile::remove(*it))
+            logMessage(logFile,
+                       Q_FUNC_INFO,
+                       QString("Unable to remove %1").arg(*it));
+        it = retiredFiles.erase(it);
+    }
+}
+
+
+/*!
+ * \brief SlidePreprocessor::variant
+ * \param slideInfo The original slide
+ * \param resolution The panel resolution
+ * \param pVariant Where to store the scaled slide description
+ * \return true if a scaled version of the slide is ready
+ */
+bool
+SlidePreprocessor::variant(const QFileInfo& slideInfo, QSize resolution, SlideVariant* pVariant) const {
+    auto it = variants.constFind(slideInfo.absoluteFilePath());
+    if(it == variants.constEnd())
+        return false;
+    auto itVariant = it->constFind(resolutionKey(resolution));
+    if(itVariant == it->constEnd())
+        return false;
+    if(itVariant->sFilePath.isEmpty()                  ||
+       (itVariant->sourceSize != slideInfo.size())     ||
+       (itVariant->sourceModified != slideInfo.lastModified().toMSecsSinceEpoch()))
+        return false;
+    *pVariant = *itVariant;
+    return true;
+}
+
+
+/*!
+ * \brief SlidePreprocessor::schedule
+ * Queue the scaling of a slide to a resolution
+ */
+void
+SlidePreprocessor::schedule(const QString& sSlidePath, QSize resolution) {
+    int generation = generations.value(sSlidePath);
+    QFileInfo slideInfo(sSlidePath);
+    QString sTargetPath = QString("%1/%2/%3.%4")
+                          .arg(sCacheDirName, resolutionKey(resolution))
+                          .arg(variantKey(slideInfo))
+                          .arg(slideInfo.suffix().toLower());
+    QtConcurrent::run(&pool, [this, sSlidePath, resolution, sTargetPath, generation]() {
+        if(bStopping)
+            return;
+        SlideVariant slideVariant;
+        bool bSuccess = scaleSlide(sSlidePath, resolution, sTargetPath, &slideVariant);
+        QMetaObject::invokeMethod(this, [=]() {
+            onSlideScaled(sSlidePath, resolution, generation, bSuccess, slideVariant);
+        }, Qt::QueuedConnection);
+    });
+}
+
+
+/*!
+ * \brief SlidePreprocessor::onSlideScaled
+ * Invoked in the object thread when a scaling job is done
+ */
+void
+SlidePreprocessor::onSlideScaled(const QString& sSlidePath, QSize resolution, int generation,
+                                 bool bSuccess, const SlideVariant& slideVariant) {
+    auto it = generations.constFind(sSlidePath);
+    if((it == generations.constEnd()) || (*it != generation))
+        return; // The slide has changed in the meantime
+    if(!bSuccess) {
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("Unable to scale %1 to %2")
+                   .arg(sSlidePath, resolutionKey(resolution)));
+        return;
+    }
+    variants[sSlidePath].insert(resolutionKey(resolution), slideVariant);
+    if(slideVariant.sFilePath.isEmpty())
+        return; // The original slide already fits
+#ifdef LOG_VERBOSE
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               QString("%1 scaled to %2: %3 bytes")
+               .arg(sSlidePath, resolutionKey(resolution))
+               .arg(slideVariant.size));
+#endif
+    emit variantReady(sSlidePath, resolution);
+}
+
+
+/*!
+ * \brief SlidePreprocessor::scaleSlide
+ * Runs in a pool thread: decode, scale and encode a slide.
+ * The scaling is done by the image decoder itself when possible
+ * (e.g. the JPEG decoder can skip most of the work for big reductions).
+ * \param sSlidePath The original slide
+ * \param resolution The panel resolution
+ * \param sTargetPath Where to store the scaled slide
+ * \param pVariant Where to store the scaled slide description
+ * \return true on success
+ */
+bool
+SlidePreprocessor::scaleSlide(const QString& sSlidePath, QSize resolution,
+                              const QString& sTargetPath, SlideVariant* pVariant) {
+    QFileInfo slideInfo(sSlidePath);
+    pVariant->sFilePath      = QString();
+    pVariant->size           = slideInfo.size();
+    pVariant->lastModified   = slideInfo.lastModified().toMSecsSinceEpoch();
+    pVariant->hash           = 0;
+    pVariant->sourceSize     = slideInfo.size();
+    pVariant->sourceModified = pVariant->lastModified;
+
+    QByteArray encoded;
+    if(QFileInfo::exists(sTargetPath)) {// Scaled in a previous run
+        QFile file(sTargetPath);
+        if(!file.open(QIODevice::ReadOnly))
+            return false;
+        encoded = file.readAll();
+        file.close();
+    }
+    else {
+        QImageReader reader(sSlidePath);
+        reader.setAutoTransform(true);
+        QSize imageSize = reader.size();
+        if(!imageSize.isValid())
+            return false;
+        // The scaled size refers to the image before the EXIF rotation
+        bool bTransposed = reader.transformation() & QImageIOHandler::TransformationRotate90;
+        QSize fitSize = bTransposed ? resolution.transposed() : resolution;
+        bool bFits = (imageSize.width()  <= fitSize.width()) &&
+                     (imageSize.height() <= fitSize.height());
+        if(bFits && (reader.transformation() == QImageIOHandler::TransformationNone))
+            return true; // Nothing to do: serve the original
+        if(!bFits)
+            reader.setScaledSize(imageSize.scaled(fitSize, Qt::KeepAspectRatio));
+        QImage image = reader.read();
+        if(image.isNull())
+            return false;
+
+        QByteArray format = slideInfo.suffix().toLower().toLatin1();
+        if(format == "jpeg")
+            format = "jpg";
+        QBuffer buffer(&encoded);
+        buffer.open(QIODevice::WriteOnly);
+        QImageWriter writer(&buffer, format);
+        if(format == "jpg")
+            writer.setQuality(SLIDE_JPEG_QUALITY);
+        if(!writer.write(image))
+            return false;
+        buffer.close();
+
+        QDir().mkpath(QFileInfo(sTargetPath).absolutePath());
+        QSaveFile file(sTargetPath);
+        if(!file.open(QIODevice::WriteOnly))
+            return false;
+        file.write(encoded);
+        if(!file.commit())
+            return false;
+    }
+    pVariant->sFilePath    = sTargetPath;
+    pVariant->size         = encoded.size();
+    pVariant->lastModified = QFileInfo(sTargetPath).lastModified().toMSecsSinceEpoch();
+    pVariant->hash         = XxHash64::hash(encoded.constData(), encoded.size());
+    return true;
+}
+
+
+/*!
+ * \brief SlidePreprocessor::resolutionKey
+ * \return The resolution as "WxH"
+ */
+QString
+SlidePreprocessor::resolutionKey(QSize resolution) {
+    return QString("%1x%2").arg(resolution.width()).arg(resolution.height());
+}
+
+
+/*!
+ * \brief SlidePreprocessor::variantKey
+ * \param slideInfo The original slide
+ * \return The base name of its scaled versions: it changes with
+ * the path, the size and the modification time of the original
+ */
+QString
+SlidePreprocessor::variantKey(const QFileInfo& slideInfo) {
+    QByteArray path = slideInfo.filePath().toUtf8();
+    return QString("%1_%2_%3")
+           .arg(XxHash64::hash(path.constData(), path.size()), 16, 16, QChar('0'))
+           .arg(slideInfo.size())
+           .arg(slideInfo.lastModified().toMSecsSinceEpoch());
+}
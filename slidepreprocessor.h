@@ -0,0 +1,88 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef SLIDEPREPROCESSOR_H
+#define SLIDEPREPROCESSOR_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QSize>
+#include <QStringList>
+#include <QThreadPool>
+#include <atomic>
+
+QT_FORWARD_DECLARE_CLASS(QFile)
+QT_FORWARD_DECLARE_CLASS(QFileInfo)
+
+
+// A slide scaled to fit a panel resolution
+struct SlideVariant
+{
+    QString sFilePath;      // Empty when the original already fits
+    qint64  size;
+    qint64  lastModified;   // msecs since epoch
+    quint64 hash;
+    qint64  sourceSize;
+    qint64  sourceModified; // msecs since epoch
+};
+
+
+class SlidePreprocessor : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SlidePreprocessor(const QString& sCacheDir, QFile* _logFile = nullptr, QObject *parent = nullptr);
+    ~SlidePreprocessor();
+    void addResolution(QSize resolution);
+    void setSlides(const QStringList& slidePaths);
+    void updateSlides(const QStringList& slidePaths);
+    void removeSlide(const QString& sSlidePath);
+    bool hasRetired() const;
+    void purgeRetired(const QSet<QString>& inUse);
+    bool variant(const QFileInfo& slideInfo, QSize resolution, SlideVariant* pVariant) const;
+    void clear();
+
+signals:
+    void variantReady(QString sSlidePath, QSize resolution);
+
+private:
+    void schedule(const QString& sSlidePath, QSize resolution);
+    void sweepCache(const QStringList& slidePaths);
+    static QString variantKey(const QFileInfo& slideInfo);
+    void onSlideScaled(const QString& sSlidePath, QSize resolution, int generation,
+                       bool bSuccess, const SlideVariant& slideVariant);
+    static bool scaleSlide(const QString& sSlidePath, QSize resolution,
+                           const QString& sTargetPath, SlideVariant* pVariant);
+    static QString resolutionKey(QSize resolution);
+
+private:
+    QString                  sCacheDirName;
+    QFile*                   logFile;
+    QThreadPool              pool;
+    std::atomic<bool>        bStopping;
+    QList<QSize>             resolutions;
+    int                      lastGeneration;
+    QHash<QString, int>      generations; // Keyed by slide path
+    // Keyed by slide path and then by resolution
+    QHash<QString, QHash<QString, SlideVariant>> variants;
+    QSet<QString>            retiredFiles; // To delete when no more in use
+};
+
+#endif // SLIDEPREPROCESSOR_H
@@ -0,0 +1,13 @@
+# Unit tests of the parts of the server that do not need a network
+# or a display. Build and run them with:
+#   qmake tests.pro && make && make check
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    tst_binarydelta \
+    tst_chunkheader \
+    tst_httprange \
+    tst_manifestframe \
+    tst_mediacatalog \
+    tst_slidebundler \
+    tst_xxhash64
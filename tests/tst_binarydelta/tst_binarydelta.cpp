@@ -0,0 +1,157 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#include "binarydelta.h"
+
+#include <QtTest>
+#include <QtEndian>
+
+
+class TestBinaryDelta : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip_data();
+    void roundTrip();
+    void smallChange();
+    void wrongBase();
+    void corrupted();
+
+private:
+    static QByteArray randomBytes(int size, quint32 seed);
+};
+
+
+QByteArray
+TestBinaryDelta::randomBytes(int size, quint32 seed) {
+    QRandomGenerator generator(seed);
+    QByteArray bytes(size, Qt::Uninitialized);
+    for(int i=0; i<size; i++)
+        bytes[i] = char(generator.bounded(256));
+    return bytes;
+}
+
+
+/*!
+ * \brief TestBinaryDelta::roundTrip_data
+ * Pairs of builds: the delta must rebuild the target from the base
+ */
+void
+TestBinaryDelta::roundTrip_data() {
+    QTest::addColumn<QByteArray>("base");
+    QTest::addColumn<QByteArray>("target");
+
+    QByteArray base = randomBytes(100000, 1);
+    QByteArray inserted = base;
+    inserted.insert(50001, randomBytes(333, 2));
+    QByteArray removed = base;
+    removed.remove(1234, 4321);
+    QByteArray moved = base.mid(60000) + base.left(60000);
+    QByteArray patched = base;
+    for(int i=17; i<patched.size(); i+=997)
+        patched[i] = char(~patched.at(i));
+
+    QTest::newRow("identical")       << base << base;
+    QTest::newRow("inserted")        << base << inserted;
+    QTest::newRow("removed")         << base << removed;
+    QTest::newRow("moved")           << base << moved;
+    QTest::newRow("patched")         << base << patched;
+    QTest::newRow("unrelated")       << base << randomBytes(70000, 3);
+    QTest::newRow("empty base")      << QByteArray() << base;
+    QTest::newRow("empty target")    << base << QByteArray();
+    QTest::newRow("shorter than a block") << QByteArray("abc") << QByteArray("abcd");
+}
+
+
+void
+TestBinaryDelta::roundTrip() {
+    QFETCH(QByteArray, base);
+    QFETCH(QByteArray, target);
+    QByteArray delta = encodeBinaryDelta(base, target);
+    QVERIFY(delta.size() >= BINARY_DELTA_HEADER_SIZE);
+    QCOMPARE(qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(delta.constData())),
+             quint32(BINARY_DELTA_MAGIC));
+    QByteArray rebuilt;
+    QVERIFY(applyBinaryDelta(base, delta, &rebuilt));
+    QCOMPARE(rebuilt, target);
+}
+
+
+/*!
+ * \brief TestBinaryDelta::smallChange
+ * A small change gives a delta much smaller than the target
+ */
+void
+TestBinaryDelta::smallChange() {
+    QByteArray base = randomBytes(200000, 4);
+    QByteArray target = base;
+    target.replace(100000, 10, QByteArray("0123456789"));
+    QByteArray delta = encodeBinaryDelta(base, target);
+    QVERIFY2(delta.size() < target.size()/100,
+             qPrintable(QString("%1 bytes").arg(delta.size())));
+}
+
+
+/*!
+ * \brief TestBinaryDelta::wrongBase
+ * A delta is applied only to the base it was computed from
+ */
+void
+TestBinaryDelta::wrongBase() {
+    QByteArray base = randomBytes(10000, 5);
+    QByteArray target = base + QByteArray("tail");
+    QByteArray delta = encodeBinaryDelta(base, target);
+    QByteArray rebuilt;
+    QByteArray other = base;
+    other[5000] = char(~other.at(5000));
+    QVERIFY(!applyBinaryDelta(other, delta, &rebuilt));
+    QVERIFY(!applyBinaryDelta(base.left(base.size()-1), delta, &rebuilt));
+}
+
+
+/*!
+ * \brief TestBinaryDelta::corrupted
+ * The deltas not matching their header are refused
+ */
+void
+TestBinaryDelta::corrupted() {
+    QByteArray base = randomBytes(10000, 6);
+    QByteArray target = randomBytes(500, 7) + base;
+    QByteArray delta = encodeBinaryDelta(base, target);
+    QByteArray rebuilt;
+    QVERIFY(!applyBinaryDelta(base, delta.left(BINARY_DELTA_HEADER_SIZE-1), &rebuilt));
+    QByteArray wrong = delta;
+    wrong[0] = 'X';
+    QVERIFY(!applyBinaryDelta(base, wrong, &rebuilt));
+    // Another target size or hash
+    wrong = delta;
+    wrong[27] = char(wrong.at(27)+1);
+    QVERIFY(!applyBinaryDelta(base, wrong, &rebuilt));
+    wrong = delta;
+    wrong[35] = char(wrong.at(35)+1);
+    QVERIFY(!applyBinaryDelta(base, wrong, &rebuilt));
+    // A truncated zlib stream
+    QVERIFY(!applyBinaryDelta(base, delta.left(delta.size()-4), &rebuilt));
+}
+
+
+QTEST_APPLESS_MAIN(TestBinaryDelta)
+
+#include "tst_binarydelta.moc"
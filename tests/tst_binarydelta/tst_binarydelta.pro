@@ -0,0 +1,19 @@
+QT += testlib
+QT -= gui
+
+CONFIG += c++17
+CONFIG += testcase
+CONFIG += console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../binarydelta.cpp \
+    ../../xxhash64.cpp \
+    tst_binarydelta.cpp
+
+HEADERS += \
+    ../../binarydelta.h \
+    ../../varint.h \
+    ../../xxhash64.h
@@ -0,0 +1,178 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#include "chunkheader.h"
+#include "crc32c.h"
+#include "xxhash64.h"
+
+#include <QtTest>
+
+
+class TestChunkHeader : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void crcVectors_data();
+    void crcVectors();
+    void crcStreaming();
+    void headerV1();
+    void frameV2();
+    void frameV2Corrupted();
+    void fileId();
+
+private:
+    static ChunkHeader sampleHeader();
+};
+
+
+ChunkHeader
+TestChunkHeader::sampleHeader() {
+    ChunkHeader header;
+    header.flags     = CHUNK_FLAG_LAST;
+    header.requestId = 0x01020304;
+    header.offset    = Q_UINT64_C(0x0000000123456789);
+    header.length    = 5;
+    header.fileSize  = Q_UINT64_C(0x000000012345678e);
+    header.fileId    = 0xa1b2c3d4;
+    return header;
+}
+
+
+/*!
+ * \brief TestChunkHeader::crcVectors_data
+ * The check value of the CRC-32C and the vectors of RFC 3720 (B.4)
+ */
+void
+TestChunkHeader::crcVectors_data() {
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<quint32>("crc");
+    QByteArray ascending;
+    for(int i=0; i<32; i++)
+        ascending.append(char(i));
+    QTest::newRow("empty")     << QByteArray()                << quint32(0x00000000);
+    QTest::newRow("check")     << QByteArray("123456789")     << quint32(0xe3069283);
+    QTest::newRow("zeros")     << QByteArray(32, '\0')        << quint32(0x8a9136aa);
+    QTest::newRow("ones")      << QByteArray(32, '\xff')      << quint32(0x62a8ab43);
+    QTest::newRow("ascending") << ascending                   << quint32(0x46dd794e);
+}
+
+
+void
+TestChunkHeader::crcVectors() {
+    QFETCH(QByteArray, data);
+    QFETCH(quint32, crc);
+    QCOMPARE(crc32c(data.constData(), data.size()), crc);
+}
+
+
+/*!
+ * \brief TestChunkHeader::crcStreaming
+ * The CRC does not depend on how the data are split
+ */
+void
+TestChunkHeader::crcStreaming() {
+    QByteArray data;
+    for(int i=0; i<1000; i++)
+        data.append(char(i*7));
+    quint32 expected = crc32c(data.constData(), data.size());
+    const int blockSizes[] = { 1, 3, 8, 9, 64, 999 };
+    for(int blockSize : blockSizes) {
+        quint32 crc = 0;
+        for(int pos=0; pos<data.size(); pos+=blockSize)
+            crc = crc32c(data.constData()+pos, qMin(blockSize, data.size()-pos), crc);
+        QCOMPARE(crc, expected);
+    }
+}
+
+
+void
+TestChunkHeader::headerV1() {
+    ChunkHeader header = sampleHeader();
+    QByteArray frame = encodeChunkHeader(header);
+    QCOMPARE(frame.size(), CHUNK_HEADER_SIZE);
+    QCOMPARE(frame.left(4), QByteArray("VC\x01\x01", 4));
+    ChunkHeader decoded;
+    QVERIFY(!decodeChunkHeader(frame, &decoded)); // The payload is missing
+    frame.append("hello");
+    QVERIFY(decodeChunkHeader(frame, &decoded));
+    QCOMPARE(decoded.flags,     header.flags);
+    QCOMPARE(decoded.requestId, header.requestId);
+    QCOMPARE(decoded.offset,    header.offset);
+    QCOMPARE(decoded.length,    header.length);
+    QCOMPARE(decoded.fileSize,  header.fileSize);
+    frame[2] = char(CHUNK_HEADER_V2_VERSION);
+    QVERIFY(!decodeChunkHeader(frame, &decoded));
+    QVERIFY(!decodeChunkHeader(frame.left(CHUNK_HEADER_SIZE-1), &decoded));
+}
+
+
+void
+TestChunkHeader::frameV2() {
+    ChunkHeader header = sampleHeader();
+    QByteArray payload("hello");
+    QByteArray frame = encodeChunkFrameV2(header, payload);
+    QCOMPARE(frame.size(), CHUNK_HEADER_V2_SIZE+payload.size());
+    QCOMPARE(frame.left(4), QByteArray("VC\x02\x01", 4));
+    QCOMPARE(frame.mid(CHUNK_HEADER_V2_SIZE), payload);
+    ChunkHeader decoded;
+    QVERIFY(decodeChunkFrameV2(frame, &decoded));
+    QCOMPARE(decoded.flags,     header.flags);
+    QCOMPARE(decoded.requestId, header.requestId);
+    QCOMPARE(decoded.fileId,    header.fileId);
+    QCOMPARE(decoded.offset,    header.offset);
+    QCOMPARE(decoded.length,    quint32(payload.size()));
+    QCOMPARE(decoded.fileSize,  header.fileSize);
+    // An empty payload (e.g. the end of a multicast pass)
+    frame = encodeChunkFrameV2(header, QByteArray());
+    QVERIFY(decodeChunkFrameV2(frame, &decoded));
+    QCOMPARE(decoded.length, quint32(0));
+}
+
+
+/*!
+ * \brief TestChunkHeader::frameV2Corrupted
+ * A changed bit anywhere in the frame (or a truncated frame) is detected
+ */
+void
+TestChunkHeader::frameV2Corrupted() {
+    QByteArray frame = encodeChunkFrameV2(sampleHeader(), QByteArray("hello"));
+    ChunkHeader decoded;
+    for(int i=0; i<frame.size(); i++) {
+        QByteArray corrupted = frame;
+        corrupted[i] = char(corrupted.at(i) ^ 0x10);
+        QVERIFY2(!decodeChunkFrameV2(corrupted, &decoded), qPrintable(QString("byte %1").arg(i)));
+    }
+    QVERIFY(!decodeChunkFrameV2(frame.left(frame.size()-1), &decoded));
+    QVERIFY(!decodeChunkFrameV2(frame+'x', &decoded));
+}
+
+
+void
+TestChunkHeader::fileId() {
+    QByteArray name("slides/a.jpg");
+    QCOMPARE(chunkFileId(QString::fromUtf8(name)),
+             quint32(XxHash64::hash(name.constData(), name.size())));
+    QVERIFY(chunkFileId("a.jpg") != chunkFileId("b.jpg"));
+}
+
+
+QTEST_APPLESS_MAIN(TestChunkHeader)
+
+#include "tst_chunkheader.moc"
@@ -0,0 +1,20 @@
+QT += testlib
+QT -= gui
+
+CONFIG += c++17
+CONFIG += testcase
+CONFIG += console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../chunkheader.cpp \
+    ../../crc32c.cpp \
+    ../../xxhash64.cpp \
+    tst_chunkheader.cpp
+
+HEADERS += \
+    ../../chunkheader.h \
+    ../../crc32c.h \
+    ../../xxhash64.h
@@ -0,0 +1,79 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#include "httprange.h"
+
+#include <QtTest>
+
+
+class TestHttpRange : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void parse_data();
+    void parse();
+};
+
+
+/*!
+ * \brief TestHttpRange::parse_data
+ * The Range headers of RFC 7233 (section 2.1) for a 10000 bytes file
+ */
+void
+TestHttpRange::parse_data() {
+    QTest::addColumn<QByteArray>("range");
+    QTest::addColumn<int>("result");
+    QTest::addColumn<qint64>("startPos");
+    QTest::addColumn<qint64>("endPos");
+    QTest::newRow("none")         << QByteArray()                   << HTTP_RANGE_NONE          << qint64(0)    << qint64(10000);
+    QTest::newRow("first 500")    << QByteArray("bytes=0-499")      << HTTP_RANGE_PARTIAL       << qint64(0)    << qint64(500);
+    QTest::newRow("second 500")   << QByteArray("bytes=500-999")    << HTTP_RANGE_PARTIAL       << qint64(500)  << qint64(1000);
+    QTest::newRow("open end")     << QByteArray("bytes=9500-")      << HTTP_RANGE_PARTIAL       << qint64(9500) << qint64(10000);
+    QTest::newRow("suffix")       << QByteArray("bytes=-500")       << HTTP_RANGE_PARTIAL       << qint64(9500) << qint64(10000);
+    QTest::newRow("big suffix")   << QByteArray("bytes=-20000")     << HTTP_RANGE_PARTIAL       << qint64(0)    << qint64(10000);
+    QTest::newRow("past end")     << QByteArray("bytes=9999-20000") << HTTP_RANGE_PARTIAL       << qint64(9999) << qint64(10000);
+    QTest::newRow("spaces")       << QByteArray("bytes= 1 - 2 ")    << HTTP_RANGE_PARTIAL       << qint64(1)    << qint64(3);
+    QTest::newRow("multiple")     << QByteArray("bytes=0-0,-1")     << HTTP_RANGE_NONE          << qint64(0)    << qint64(10000);
+    QTest::newRow("other unit")   << QByteArray("items=0-1")        << HTTP_RANGE_NONE          << qint64(0)    << qint64(10000);
+    QTest::newRow("start beyond") << QByteArray("bytes=10000-")     << HTTP_RANGE_UNSATISFIABLE << qint64(0)    << qint64(10000);
+    QTest::newRow("zero suffix")  << QByteArray("bytes=-0")         << HTTP_RANGE_UNSATISFIABLE << qint64(0)    << qint64(10000);
+    QTest::newRow("reversed")     << QByteArray("bytes=500-499")    << HTTP_RANGE_UNSATISFIABLE << qint64(0)    << qint64(10000);
+    QTest::newRow("no dash")      << QByteArray("bytes=500")        << HTTP_RANGE_UNSATISFIABLE << qint64(0)    << qint64(10000);
+    QTest::newRow("garbage")      << QByteArray("bytes=a-b")        << HTTP_RANGE_UNSATISFIABLE << qint64(0)    << qint64(10000);
+    QTest::newRow("negative")     << QByteArray("bytes=-5-10")      << HTTP_RANGE_UNSATISFIABLE << qint64(0)    << qint64(10000);
+}
+
+
+void
+TestHttpRange::parse() {
+    QFETCH(QByteArray, range);
+    QFETCH(int, result);
+    QFETCH(qint64, startPos);
+    QFETCH(qint64, endPos);
+    qint64 start, end;
+    QCOMPARE(parseHttpRange(range, 10000, &start, &end), result);
+    QCOMPARE(start, startPos);
+    QCOMPARE(end, endPos);
+}
+
+
+QTEST_APPLESS_MAIN(TestHttpRange)
+
+#include "tst_httprange.moc"
@@ -0,0 +1,16 @@
+QT += testlib
+QT -= gui
+
+CONFIG += c++17
+CONFIG += testcase
+CONFIG += console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../httprange.cpp \
+    tst_httprange.cpp
+
+HEADERS += \
+    ../../httprange.h
@@ -0,0 +1,204 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#include "manifestframe.h"
+#include "varint.h"
+
+#include <QtTest>
+#include <QtEndian>
+
+
+class TestManifestFrame : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void varint_data();
+    void varint();
+    void varintInvalid();
+    void roundTrip();
+    void emptyManifest();
+    void sharedPrefix();
+    void corrupted();
+
+private:
+    static QVector<ManifestRecord> sampleRecords();
+    static ManifestRecord record(const QString& sName, qint64 size, bool bHashed, quint64 hash);
+};
+
+
+ManifestRecord
+TestManifestFrame::record(const QString& sName, qint64 size, bool bHashed, quint64 hash) {
+    ManifestRecord record;
+    record.sName   = sName;
+    record.size    = size;
+    record.bHashed = bHashed;
+    record.hash    = bHashed ? hash : 0;
+    return record;
+}
+
+
+QVector<ManifestRecord>
+TestManifestFrame::sampleRecords() {
+    QVector<ManifestRecord> records;
+    records.append(record("slides/2025/a.jpg", 123456, true, Q_UINT64_C(0x0123456789abcdef)));
+    records.append(record("slides/2025/b.jpg", 0, false, 0));
+    records.append(record(QString::fromUtf8("slides/2026/citt\xc3\xa0.png"), Q_INT64_C(5000000000), true, Q_UINT64_C(0xffffffffffffffff)));
+    records.append(record("spot.mp4", 127, true, 0));
+    records.append(record("spot.mp4.old", 128, false, 0)); // Longer than the previous one
+    records.append(record("s", 1, false, 0));               // Shorter than the previous one
+    return records;
+}
+
+
+/*!
+ * \brief TestManifestFrame::varint_data
+ * Unsigned LEB128 encodings
+ */
+void
+TestManifestFrame::varint_data() {
+    QTest::addColumn<quint64>("value");
+    QTest::addColumn<QByteArray>("encoded");
+    QTest::newRow("0")     << quint64(0)       << QByteArray::fromHex("00");
+    QTest::newRow("1")     << quint64(1)       << QByteArray::fromHex("01");
+    QTest::newRow("127")   << quint64(127)     << QByteArray::fromHex("7f");
+    QTest::newRow("128")   << quint64(128)     << QByteArray::fromHex("8001");
+    QTest::newRow("300")   << quint64(300)     << QByteArray::fromHex("ac02");
+    QTest::newRow("16384") << quint64(16384)   << QByteArray::fromHex("808001");
+    QTest::newRow("max")   << Q_UINT64_C(0xffffffffffffffff)
+                           << QByteArray::fromHex("ffffffffffffffffff01");
+}
+
+
+void
+TestManifestFrame::varint() {
+    QFETCH(quint64, value);
+    QFETCH(QByteArray, encoded);
+    QByteArray data("x");
+    appendVarint(&data, value);
+    QCOMPARE(data.mid(1), encoded);
+    data.append('y');
+    int pos = 1;
+    quint64 decoded;
+    QVERIFY(readVarint(data, &pos, &decoded));
+    QCOMPARE(decoded, value);
+    QCOMPARE(pos, 1+encoded.size());
+}
+
+
+void
+TestManifestFrame::varintInvalid() {
+    quint64 value;
+    int pos = 0;
+    QVERIFY(!readVarint(QByteArray(), &pos, &value));
+    pos = 0;
+    QVERIFY(!readVarint(QByteArray::fromHex("8080"), &pos, &value)); // Truncated
+    pos = 0;
+    QVERIFY(!readVarint(QByteArray(11, '\x80'), &pos, &value));      // Too long
+}
+
+
+void
+TestManifestFrame::roundTrip() {
+    QVector<ManifestRecord> records = sampleRecords();
+    QByteArray frame = encodeManifestFrame(Q_UINT64_C(0x0102030405060708), records);
+    auto* pData = reinterpret_cast<const uchar*>(frame.constData());
+    QCOMPARE(qFromBigEndian<quint16>(pData), quint16(MANIFEST_FRAME_MAGIC));
+    QCOMPARE(int(pData[2]), MANIFEST_FRAME_VERSION);
+    QCOMPARE(qFromBigEndian<quint32>(pData+12), quint32(records.count()));
+    quint64 version;
+    QVector<ManifestRecord> decoded;
+    QVERIFY(decodeManifestFrame(frame, &version, &decoded));
+    QCOMPARE(version, Q_UINT64_C(0x0102030405060708));
+    QCOMPARE(decoded.count(), records.count());
+    for(int i=0; i<records.count(); i++) {
+        QCOMPARE(decoded.at(i).sName,   records.at(i).sName);
+        QCOMPARE(decoded.at(i).size,    records.at(i).size);
+        QCOMPARE(decoded.at(i).bHashed, records.at(i).bHashed);
+        QCOMPARE(decoded.at(i).hash,    records.at(i).hash);
+    }
+}
+
+
+void
+TestManifestFrame::emptyManifest() {
+    QByteArray frame = encodeManifestFrame(7, QVector<ManifestRecord>());
+    quint64 version;
+    QVector<ManifestRecord> decoded;
+    decoded.append(record("stale", 1, false, 0));
+    QVERIFY(decodeManifestFrame(frame, &version, &decoded));
+    QCOMPARE(version, quint64(7));
+    QVERIFY(decoded.isEmpty());
+}
+
+
+/*!
+ * \brief TestManifestFrame::sharedPrefix
+ * A name is stored as the bytes shared with the previous one
+ * followed by the rest
+ */
+void
+TestManifestFrame::sharedPrefix() {
+    QVector<ManifestRecord> records;
+    records.append(record("slides/a.jpg", 1, false, 0));
+    records.append(record("slides/b.jpg", 2, false, 0));
+    QByteArray frame = encodeManifestFrame(1, records);
+    QByteArray body = qUncompress(frame.mid(MANIFEST_FRAME_HEADER_SIZE));
+    QByteArray expected;
+    expected.append(QByteArray::fromHex("000c"));
+    expected.append("slides/a.jpg");
+    expected.append(QByteArray::fromHex("0100"));   // Size and flags
+    expected.append(QByteArray::fromHex("0705"));
+    expected.append("b.jpg");
+    expected.append(QByteArray::fromHex("0200"));
+    QCOMPARE(body, expected);
+}
+
+
+/*!
+ * \brief TestManifestFrame::corrupted
+ * The frames not matching the header are refused
+ */
+void
+TestManifestFrame::corrupted() {
+    QVector<ManifestRecord> records = sampleRecords();
+    QByteArray frame = encodeManifestFrame(1, records);
+    quint64 version;
+    QVector<ManifestRecord> decoded;
+    QVERIFY(!decodeManifestFrame(frame.left(MANIFEST_FRAME_HEADER_SIZE-1), &version, &decoded));
+    QByteArray wrong = frame;
+    wrong[0] = 'X';
+    QVERIFY(!decodeManifestFrame(wrong, &version, &decoded));
+    wrong = frame;
+    wrong[2] = char(MANIFEST_FRAME_VERSION+1);
+    QVERIFY(!decodeManifestFrame(wrong, &version, &decoded));
+    // More or fewer entries than those in the body
+    for(int delta : { -1, 1 }) {
+        wrong = frame;
+        qToBigEndian(quint32(records.count()+delta), reinterpret_cast<uchar*>(wrong.data())+12);
+        QVERIFY(!decodeManifestFrame(wrong, &version, &decoded));
+    }
+    // A truncated zlib stream
+    QVERIFY(!decodeManifestFrame(frame.left(frame.size()-4), &version, &decoded));
+}
+
+
+QTEST_APPLESS_MAIN(TestManifestFrame)
+
+#include "tst_manifestframe.moc"
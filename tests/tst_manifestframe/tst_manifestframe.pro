@@ -0,0 +1,17 @@
+QT += testlib
+QT -= gui
+
+CONFIG += c++17
+CONFIG += testcase
+CONFIG += console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../manifestframe.cpp \
+    tst_manifestframe.cpp
+
+HEADERS += \
+    ../../manifestframe.h \
+    ../../varint.h
@@ -0,0 +1,171 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#include "mediacatalog.h"
+
+#include <QtTest>
+
+
+class TestMediaCatalog : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void ordering();
+    void indexOf();
+    void removeAndUpdate();
+    void paths();
+    void validNames_data();
+    void validNames();
+
+private:
+    static QStringList names(const MediaCatalog& catalog);
+};
+
+
+QStringList
+TestMediaCatalog::names(const MediaCatalog& catalog) {
+    QStringList result;
+    for(int i=0; i<catalog.count(); i++)
+        result.append(catalog.name(i));
+    return result;
+}
+
+
+/*!
+ * \brief TestMediaCatalog::ordering
+ * The files are kept sorted by name (case insensitive)
+ * whatever the order they are inserted
+ */
+void
+TestMediaCatalog::ordering() {
+    MediaCatalog catalog;
+    catalog.setRoot("/media");
+    QCOMPARE(catalog.insert("b.jpg", 2, 20), 0);
+    QCOMPARE(catalog.insert("A.jpg", 1, 10), 0);
+    QCOMPARE(catalog.insert("sub/a.jpg", 3, 30), 2);
+    QCOMPARE(catalog.insert("c.mp4", 4, 40), 2);
+    QCOMPARE(catalog.insert("a0.jpg", 5, 50), 1);
+    QCOMPARE(names(catalog), QStringList() << "A.jpg" << "a0.jpg" << "b.jpg" << "c.mp4" << "sub/a.jpg");
+    QCOMPARE(catalog.size(0), qint64(1));
+    QCOMPARE(catalog.lastModified(4), qint64(30));
+    QVERIFY(!catalog.isEmpty());
+    catalog.clear();
+    QVERIFY(catalog.isEmpty());
+    QCOMPARE(catalog.indexOf("A.jpg"), -1);
+}
+
+
+/*!
+ * \brief TestMediaCatalog::indexOf
+ * The same leaf name in several directories, and the rows moved
+ * by the insertions
+ */
+void
+TestMediaCatalog::indexOf() {
+    MediaCatalog catalog;
+    catalog.setRoot("/media/");
+    catalog.insert("x/slide.jpg", 1, 1);
+    catalog.insert("slide.jpg", 2, 2);
+    catalog.insert("y/z/slide.jpg", 3, 3);
+    QCOMPARE(catalog.indexOf("slide.jpg"), 0);
+    QCOMPARE(catalog.indexOf("x/slide.jpg"), 1);
+    QCOMPARE(catalog.indexOf("y/z/slide.jpg"), 2);
+    QCOMPARE(catalog.indexOf("y/slide.jpg"), -1);
+    QCOMPARE(catalog.indexOf("z/slide.jpg"), -1);
+    QCOMPARE(catalog.indexOf("Slide.jpg"), -1); // The lookup is exact
+    catalog.insert("a.jpg", 4, 4);
+    QCOMPARE(catalog.indexOf("a.jpg"), 0);
+    QCOMPARE(catalog.indexOf("y/z/slide.jpg"), 3);
+    for(int i=0; i<catalog.count(); i++)
+        QCOMPARE(catalog.indexOf(catalog.name(i)), i);
+}
+
+
+void
+TestMediaCatalog::removeAndUpdate() {
+    MediaCatalog catalog;
+    catalog.setRoot("/media");
+    catalog.insert("a.jpg", 1, 1);
+    catalog.insert("b.jpg", 2, 2);
+    catalog.insert("c.jpg", 3, 3);
+    catalog.setHash(1, Q_UINT64_C(0x1234));
+    catalog.setHash(2, Q_UINT64_C(0x5678));
+    QVERIFY(catalog.isHashed(1));
+    QCOMPARE(catalog.indexOfHash(Q_UINT64_C(0x5678)), 2);
+    catalog.removeAt(0);
+    QCOMPARE(catalog.indexOf("a.jpg"), -1);
+    QCOMPARE(catalog.indexOf("b.jpg"), 0);
+    QCOMPARE(catalog.indexOf("c.jpg"), 1);
+    QCOMPARE(catalog.hash(0), Q_UINT64_C(0x1234));
+    QCOMPARE(catalog.indexOfHash(Q_UINT64_C(0x5678)), 1);
+    catalog.update(1, 30, 300); // The hash is no more valid
+    QVERIFY(!catalog.isHashed(1));
+    QCOMPARE(catalog.size(1), qint64(30));
+    QCOMPARE(catalog.lastModified(1), qint64(300));
+    QCOMPARE(catalog.indexOfHash(Q_UINT64_C(0x5678)), -1);
+}
+
+
+void
+TestMediaCatalog::paths() {
+    MediaCatalog catalog;
+    catalog.setRoot("/media");
+    QCOMPARE(catalog.root(), QString("/media/"));
+    int i = catalog.insert("sub/a.jpg", 1, 1);
+    QCOMPARE(catalog.filePath(i), QString("/media/sub/a.jpg"));
+    QCOMPARE(catalog.nameOf("/media/sub/a.jpg"), QString("sub/a.jpg"));
+    QCOMPARE(catalog.nameOf("/other/sub/a.jpg"), QString());
+    QCOMPARE(catalog.indexOf(catalog.nameOf(catalog.filePath(i))), i);
+}
+
+
+void
+TestMediaCatalog::validNames_data() {
+    QTest::addColumn<QString>("name");
+    QTest::addColumn<bool>("valid");
+    QTest::newRow("plain")      << QString("a.jpg")          << true;
+    QTest::newRow("nested")     << QString("dir/sub/a.jpg")  << true;
+    QTest::newRow("dots")       << QString("a..b.jpg")       << true;
+    QTest::newRow("empty")      << QString()                 << false;
+    QTest::newRow("absolute")   << QString("/etc/passwd")    << false;
+    QTest::newRow("parent")     << QString("../a.jpg")       << false;
+    QTest::newRow("inner")      << QString("dir/../../a")    << false;
+    QTest::newRow("current")    << QString("./a.jpg")        << false;
+    QTest::newRow("double /")   << QString("dir//a.jpg")     << false;
+    QTest::newRow("trailing /") << QString("dir/")           << false;
+    QTest::newRow("backslash")  << QString("dir\\a.jpg")     << false;
+    QTest::newRow("comma")      << QString("a,b.jpg")        << false;
+    QTest::newRow("semicolon")  << QString("a;b.jpg")        << false;
+    QTest::newRow("tag")        << QString("<get>a.jpg")     << false;
+    QTest::newRow("control")    << QString("a\nb.jpg")       << false;
+}
+
+
+void
+TestMediaCatalog::validNames() {
+    QFETCH(QString, name);
+    QFETCH(bool, valid);
+    QCOMPARE(MediaCatalog::isValidName(name), valid);
+}
+
+
+QTEST_APPLESS_MAIN(TestMediaCatalog)
+
+#include "tst_mediacatalog.moc"
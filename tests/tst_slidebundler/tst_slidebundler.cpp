@@ -0,0 +1,253 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#include "slidebundler.h"
+#include "xxhash64.h"
+
+#include <QtTest>
+#include <QtEndian>
+#include <QTemporaryDir>
+
+
+class TestSlideBundler : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void build();
+    void append();
+    void compact();
+
+private:
+    struct Entry {
+        QString sName;
+        qint64  offset;
+        qint64  size;
+        quint64 hash;
+    };
+    void writeSlide(const QString& sName, int size, char fill);
+    QStringList slidePaths() const;
+    bool buildBundle(qint64* pTocOffset);
+    bool readToc(QVector<Entry>* pEntries, qint64* pTocOffset, quint64* pTocHash);
+    void checkSlides(const QVector<Entry>& entries);
+
+private:
+    QTemporaryDir* pDir;
+    QStringList    slideNames;
+};
+
+
+void
+TestSlideBundler::init() {
+    pDir = new QTemporaryDir();
+    QVERIFY(pDir->isValid());
+    QVERIFY(QDir(pDir->path()).mkdir("slides"));
+    slideNames.clear();
+    writeSlide("a.jpg", 1000, 'a');
+    writeSlide("b.png", 1, 'b');
+    writeSlide("c.jpg", 70000, 'c');
+}
+
+
+void
+TestSlideBundler::cleanup() {
+    delete pDir;
+    pDir = nullptr;
+}
+
+
+void
+TestSlideBundler::writeSlide(const QString& sName, int size, char fill) {
+    QFile file(pDir->filePath("slides/"+sName));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QByteArray data(size, fill);
+    data[0] = char(size); // The slides differ also in their first byte
+    QCOMPARE(file.write(data), qint64(size));
+    if(!slideNames.contains(sName))
+        slideNames.append(sName);
+}
+
+
+QStringList
+TestSlideBundler::slidePaths() const {
+    QStringList paths;
+    for(const QString& sName : slideNames)
+        paths.append(pDir->filePath("slides/"+sName));
+    return paths;
+}
+
+
+/*!
+ * \brief TestSlideBundler::buildBundle
+ * Build the bundle and check what bundleReady() tells
+ * about it against the bundle itself
+ */
+bool
+TestSlideBundler::buildBundle(qint64* pTocOffset) {
+    SlideBundler bundler(pDir->filePath("bundle"));
+    QSignalSpy spy(&bundler, SIGNAL(bundleReady(QString,qint64,quint64,qint64,int)));
+    bundler.onBuildBundle(pDir->filePath("slides"), slidePaths());
+    if(spy.count() != 1)
+        return false;
+    const QList<QVariant> arguments = spy.takeFirst();
+    QVector<Entry> entries;
+    quint64 tocHash;
+    if(!readToc(&entries, pTocOffset, &tocHash))
+        return false;
+    return (arguments.at(0).toString() == pDir->filePath("bundle"))                &&
+           (arguments.at(1).toLongLong() == QFileInfo(pDir->filePath("bundle")).size()) &&
+           (arguments.at(2).toULongLong() == tocHash)                             &&
+           (arguments.at(3).toLongLong() == *pTocOffset)                          &&
+           (arguments.at(4).toInt() == entries.count());
+}
+
+
+/*!
+ * \brief TestSlideBundler::readToc
+ * Parse the trailer and the table of contents as a panel does
+ * (see slidebundler.h)
+ */
+bool
+TestSlideBundler::readToc(QVector<Entry>* pEntries, qint64* pTocOffset, quint64* pTocHash) {
+    QFile file(pDir->filePath("bundle"));
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+    QByteArray data = file.readAll();
+    if(data.size() < BUNDLE_TRAILER_SIZE)
+        return false;
+    auto* pTrailer = reinterpret_cast<const uchar*>(data.constData()+data.size()-BUNDLE_TRAILER_SIZE);
+    if((qFromBigEndian<quint32>(pTrailer)   != BUNDLE_MAGIC)   ||
+       (qFromBigEndian<quint16>(pTrailer+4) != BUNDLE_VERSION))
+        return false;
+    quint32 count     = qFromBigEndian<quint32>(pTrailer+8);
+    quint32 tocLength = qFromBigEndian<quint32>(pTrailer+12);
+    qint64  tocOffset = qint64(qFromBigEndian<quint64>(pTrailer+16));
+    if(tocOffset+tocLength+BUNDLE_TRAILER_SIZE != data.size())
+        return false;
+    *pTocOffset = tocOffset;
+    *pTocHash = XxHash64::hash(data.constData()+tocOffset, tocLength);
+    auto* pData = reinterpret_cast<const uchar*>(data.constData()+tocOffset);
+    const uchar* pEnd = pData+tocLength;
+    pEntries->clear();
+    for(quint32 i=0; i<count; i++) {
+        if(pEnd-pData < 2)
+            return false;
+        int nameLength = qFromBigEndian<quint16>(pData);
+        pData += 2;
+        if(pEnd-pData < nameLength+32)
+            return false;
+        Entry entry;
+        entry.sName  = QString::fromUtf8(reinterpret_cast<const char*>(pData), nameLength);
+        pData += nameLength;
+        entry.offset = qint64(qFromBigEndian<quint64>(pData));
+        entry.size   = qint64(qFromBigEndian<quint64>(pData+8));
+        entry.hash   = qFromBigEndian<quint64>(pData+24);
+        pData += 32;
+        if(entry.offset+entry.size > tocOffset)
+            return false;
+        pEntries->append(entry);
+    }
+    return pData == pEnd;
+}
+
+
+/*!
+ * \brief TestSlideBundler::checkSlides
+ * Every current slide is in the bundle, at its offset, with its hash
+ */
+void
+TestSlideBundler::checkSlides(const QVector<Entry>& entries) {
+    QFile bundle(pDir->filePath("bundle"));
+    QVERIFY(bundle.open(QIODevice::ReadOnly));
+    QCOMPARE(entries.count(), slideNames.count());
+    for(const Entry& entry : entries) {
+        QVERIFY(slideNames.contains(entry.sName));
+        QFile slide(pDir->filePath("slides/"+entry.sName));
+        QVERIFY(slide.open(QIODevice::ReadOnly));
+        QByteArray data = slide.readAll();
+        QCOMPARE(entry.size, qint64(data.size()));
+        QCOMPARE(entry.hash, XxHash64::hash(data.constData(), data.size()));
+        QVERIFY(bundle.seek(entry.offset));
+        QCOMPARE(bundle.read(entry.size), data);
+    }
+}
+
+
+void
+TestSlideBundler::build() {
+    qint64 tocOffset;
+    QVERIFY(buildBundle(&tocOffset));
+    QVector<Entry> entries;
+    quint64 tocHash;
+    QVERIFY(readToc(&entries, &tocOffset, &tocHash));
+    checkSlides(entries);
+    QCOMPARE(tocOffset, qint64(1000+1+70000));
+}
+
+
+/*!
+ * \brief TestSlideBundler::append
+ * A new slide is appended: the others keep their offsets
+ */
+void
+TestSlideBundler::append() {
+    qint64 tocOffset;
+    QVERIFY(buildBundle(&tocOffset));
+    QVector<Entry> before;
+    quint64 tocHash;
+    QVERIFY(readToc(&before, &tocOffset, &tocHash));
+    writeSlide("d.jpg", 5000, 'd');
+    qint64 newTocOffset;
+    QVERIFY(buildBundle(&newTocOffset));
+    QCOMPARE(newTocOffset, tocOffset+5000);
+    QVector<Entry> after;
+    QVERIFY(readToc(&after, &newTocOffset, &tocHash));
+    checkSlides(after);
+    for(int i=0; i<before.count(); i++) {
+        QCOMPARE(after.at(i).sName, before.at(i).sName);
+        QCOMPARE(after.at(i).offset, before.at(i).offset);
+    }
+    QCOMPARE(after.last().offset, tocOffset);
+}
+
+
+/*!
+ * \brief TestSlideBundler::compact
+ * The space of the removed slides is reclaimed when it exceeds
+ * that of the slides in use
+ */
+void
+TestSlideBundler::compact() {
+    qint64 tocOffset;
+    QVERIFY(buildBundle(&tocOffset));
+    slideNames.removeAll("c.jpg");
+    QVERIFY(buildBundle(&tocOffset));
+    QCOMPARE(tocOffset, qint64(1000+1));
+    QVector<Entry> entries;
+    quint64 tocHash;
+    QVERIFY(readToc(&entries, &tocOffset, &tocHash));
+    checkSlides(entries);
+}
+
+
+QTEST_GUILESS_MAIN(TestSlideBundler)
+
+#include "tst_slidebundler.moc"
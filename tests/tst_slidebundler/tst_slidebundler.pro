@@ -0,0 +1,20 @@
+QT += testlib
+QT -= gui
+
+CONFIG += c++17
+CONFIG += testcase
+CONFIG += console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../slidebundler.cpp \
+    ../../utility.cpp \
+    ../../xxhash64.cpp \
+    tst_slidebundler.cpp
+
+HEADERS += \
+    ../../slidebundler.h \
+    ../../utility.h \
+    ../../xxhash64.h
@@ -0,0 +1,97 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#include "xxhash64.h"
+
+#include <QtTest>
+
+
+class TestXxHash64 : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void referenceVectors_data();
+    void referenceVectors();
+    void seed();
+    void streaming();
+};
+
+
+/*!
+ * \brief TestXxHash64::referenceVectors_data
+ * The values computed by the reference implementation (XXH64, seed 0)
+ */
+void
+TestXxHash64::referenceVectors_data() {
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<quint64>("hash");
+    QTest::newRow("empty")  << QByteArray()           << Q_UINT64_C(0xef46db3751d8e999);
+    QTest::newRow("a")      << QByteArray("a")        << Q_UINT64_C(0xd24ec4f1a98c6e5b);
+    QTest::newRow("abc")    << QByteArray("abc")      << Q_UINT64_C(0x44bc2cf5ad770999);
+    QTest::newRow("stripes")
+        << QByteArray("Nobody inspects the spammish repetition")
+        << Q_UINT64_C(0xfbcea83c8a378bf1);
+}
+
+
+void
+TestXxHash64::referenceVectors() {
+    QFETCH(QByteArray, data);
+    QFETCH(quint64, hash);
+    QCOMPARE(XxHash64::hash(data.constData(), data.size()), hash);
+}
+
+
+void
+TestXxHash64::seed() {
+    QByteArray data("abc");
+    QVERIFY(XxHash64::hash(data.constData(), data.size(), 1) !=
+            XxHash64::hash(data.constData(), data.size(), 0));
+    XxHash64 hasher(1);
+    hasher.update(data.constData(), data.size());
+    QCOMPARE(hasher.digest(), XxHash64::hash(data.constData(), data.size(), 1));
+}
+
+
+/*!
+ * \brief TestXxHash64::streaming
+ * The hash does not depend on how the data are split
+ */
+void
+TestXxHash64::streaming() {
+    QByteArray data;
+    for(int i=0; i<1000; i++)
+        data.append(char(i*31));
+    quint64 expected = XxHash64::hash(data.constData(), data.size());
+    const int blockSizes[] = { 1, 7, 31, 32, 33, 100, 999 };
+    for(int blockSize : blockSizes) {
+        XxHash64 hasher;
+        for(int pos=0; pos<data.size(); pos+=blockSize)
+            hasher.update(data.constData()+pos, qMin(blockSize, data.size()-pos));
+        QCOMPARE(hasher.digest(), expected);
+        hasher.reset();
+        QCOMPARE(hasher.digest(), XxHash64::hash(nullptr, 0));
+    }
+}
+
+
+QTEST_APPLESS_MAIN(TestXxHash64)
+
+#include "tst_xxhash64.moc"
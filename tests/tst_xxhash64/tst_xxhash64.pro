@@ -0,0 +1,16 @@
+QT += testlib
+QT -= gui
+
+CONFIG += c++17
+CONFIG += testcase
+CONFIG += console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../xxhash64.cpp \
+    tst_xxhash64.cpp
+
+HEADERS += \
+    ../../xxhash64.h
@@ -0,0 +1,139 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+
+#include "tokenbucket.h"
+
+#include <QMutexLocker>
+#include <cmath>
+
+
+// The bucket can hold this fraction of a second of traffic
+#define BUCKET_BURST_DIVIDER    4
+#define BUCKET_MIN_BURST        (64*1024)
+
+
+/*!
+ * \brief TokenBucket::TokenBucket
+ * \param bytesPerSecond The allowed rate (0 means unlimited)
+ */
+TokenBucket::TokenBucket(qint64 bytesPerSecond)
+    : bytesPerSecond(0)
+    , burst(0)
+    , tokens(0.0)
+{
+    clock.start();
+    setRate(bytesPerSecond);
+}
+
+
+/*!
+ * \brief TokenBucket::setRate
+ * \param newRate The allowed rate (0 means unlimited)
+ */
+void
+TokenBucket::setRate(qint64 newRate) {
+    QMutexLocker locker(&mutex);
+    refill();
+    bytesPerSecond = qMax(qint64(0), newRate);
+    burst  = qMax(bytesPerSecond/BUCKET_BURST_DIVIDER, qint64(BUCKET_MIN_BURST));
+    tokens = qMin(tokens, double(burst));
+    if(bytesPerSecond == 0)
+        tokens = 0.0;
+}
+
+
+qint64
+TokenBucket::rate() const {
+    QMutexLocker locker(&mutex);
+    return bytesPerSecond;
+}
+
+
+/*!
+ * \brief TokenBucket::isAvailable
+ * \return true if a transfer can start now
+ */
+bool
+TokenBucket::isAvailable() {
+    QMutexLocker locker(&mutex);
+    if(bytesPerSecond == 0)
+        return true;
+    refill();
+    return tokens > 0.0;
+}
+
+
+/*!
+ * \brief TokenBucket::tryConsume
+ * \param bytes The size of the transfer
+ * \return true if the transfer can start now (and has been charged)
+ */
+bool
+TokenBucket::tryConsume(qint64 bytes) {
+    QMutexLocker locker(&mutex);
+    if(bytesPerSecond == 0)
+        return true;
+    refill();
+    if(tokens <= 0.0)
+        return false;
+    tokens -= double(bytes);
+    return true;
+}
+
+
+/*!
+ * \brief TokenBucket::consume
+ * Charge a transfer unconditionally
+ */
+void
+TokenBucket::consume(qint64 bytes) {
+    QMutexLocker locker(&mutex);
+    if(bytesPerSecond == 0)
+        return;
+    refill();
+    tokens -= double(bytes);
+}
+
+
+/*!
+ * \brief TokenBucket::msecsToAvailable
+ * \return The time to wait before a transfer can start
+ */
+qint64
+TokenBucket::msecsToAvailable() {
+    QMutexLocker locker(&mutex);
+    if(bytesPerSecond == 0)
+        return 0;
+    refill();
+    if(tokens > 0.0)
+        return 0;
+    return qint64(std::ceil(-tokens*1000.0/double(bytesPerSecond))) + 1;
+}
+
+
+// To be called with the mutex locked
+void
+TokenBucket::refill() {
+    qint64 elapsed = clock.nsecsElapsed();
+    clock.restart();
+    if(bytesPerSecond == 0)
+        return;
+    tokens = qMin(double(burst), tokens + double(elapsed)*double(bytesPerSecond)/1.0e9);
+}
@@ -0,0 +1,55 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef TOKENBUCKET_H
+#define TOKENBUCKET_H
+
+#include <QtGlobal>
+#include <QMutex>
+#include <QElapsedTimer>
+
+
+// Token bucket rate limiter. A transfer may start as long as the bucket
+// is not empty and is then charged in full (the bucket can go in debt):
+// large chunks are never starved and the average rate is respected.
+// It can be shared by several threads.
+class TokenBucket
+{
+public:
+    explicit TokenBucket(qint64 bytesPerSecond = 0);
+
+    void   setRate(qint64 bytesPerSecond);
+    qint64 rate() const;
+    bool   isAvailable();
+    bool   tryConsume(qint64 bytes);
+    void   consume(qint64 bytes);
+    qint64 msecsToAvailable();
+
+private:
+    void   refill();
+
+private:
+    mutable QMutex mutex;
+    qint64         bytesPerSecond; // 0 means unlimited
+    qint64         burst;
+    double         tokens;
+    QElapsedTimer  clock;
+};
+
+#endif // TOKENBUCKET_H
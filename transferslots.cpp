@@ -0,0 +1,178 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#include "transferslots.h"
+#include "fileserver.h"
+
+#include <QMutexLocker>
+
+
+/*!
+ * \brief TransferSlots::TransferSlots
+ * \param maxSlots The clients transferring at the same time (0 = unlimited)
+ */
+TransferSlots::TransferSlots(int maxSlots)
+    : maxSlots(qMax(0, maxSlots))
+    , usedSlots(0)
+{
+}
+
+
+/*!
+ * \brief TransferSlots::setLimit
+ * \param newLimit The clients transferring at the same time (0 = unlimited).
+ * The slots already taken are kept: a lower limit is reached
+ * as the transfers end.
+ */
+void
+TransferSlots::setLimit(int newLimit) {
+    QMutexLocker locker(&mutex);
+    maxSlots = qMax(0, newLimit);
+    handOver(false);
+}
+
+
+int
+TransferSlots::limit() const {
+    QMutexLocker locker(&mutex);
+    return maxSlots;
+}
+
+
+/*!
+ * \brief TransferSlots::tryAcquire
+ * Take a slot for a client or queue it: nobody takes a free slot
+ * before the clients already waiting
+ * \param pServer The File Server of the client
+ * \param pClient The client
+ * \return true if a slot has been taken (it is always taken when unlimited
+ * so that the count stays right if a limit is set later). When false the
+ * client is in the queue: FileServer::onTransferSlotGranted() is invoked
+ * when its turn comes.
+ */
+bool
+TransferSlots::tryAcquire(FileServer* pServer, QWebSocket* pClient) {
+    QMutexLocker locker(&mutex);
+    for(const Waiter& waiter : qAsConst(waiters)) {
+        if((waiter.pServer == pServer) && (waiter.pClient == pClient))
+            return false; // Already waiting
+    }
+    if(waiters.isEmpty() && ((maxSlots == 0) || (usedSlots < maxSlots))) {
+        usedSlots++;
+        return true;
+    }
+    Waiter waiter;
+    waiter.pServer = pServer;
+    waiter.pClient = pClient;
+    waiters.append(waiter);
+    return false;
+}
+
+
+/*!
+ * \brief TransferSlots::release
+ * \param nSlots The slots given back: they go to the first waiting clients
+ */
+void
+TransferSlots::release(int nSlots) {
+    QMutexLocker locker(&mutex);
+    usedSlots = qMax(0, usedSlots-nSlots);
+    handOver(false);
+}
+
+
+/*!
+ * \brief TransferSlots::cancel
+ * Remove a client from the queue
+ * \param pServer The File Server of the client
+ * \param pClient The client (nullptr for all the clients of pServer)
+ */
+void
+TransferSlots::cancel(FileServer* pServer, QWebSocket* pClient) {
+    QMutexLocker locker(&mutex);
+    bool bRemoved = false;
+    for(int i=waiters.count()-1; i>=0; i--) {
+        if((waiters.at(i).pServer == pServer) &&
+           (!pClient || (waiters.at(i).pClient == pClient)))
+        {
+            waiters.removeAt(i);
+            bRemoved = true;
+        }
+    }
+    if(bRemoved)
+        handOver(true);
+}
+
+
+/*!
+ * \brief TransferSlots::position
+ * \return The position of the client in the queue (from 1),
+ * 0 if it is not waiting
+ */
+int
+TransferSlots::position(FileServer* pServer, QWebSocket* pClient) const {
+    QMutexLocker locker(&mutex);
+    for(int i=0; i<waiters.count(); i++) {
+        if((waiters.at(i).pServer == pServer) && (waiters.at(i).pClient == pClient))
+            return i+1;
+    }
+    return 0;
+}
+
+
+/*!
+ * \brief TransferSlots::handOver
+ * Give the free slots to the first waiting clients. Their File Servers,
+ * and those of the clients that moved up in the queue, are told with
+ * queued calls (they may live in another thread). Called with the
+ * mutex locked.
+ * \param bQueueChanged true if a waiting client has left the queue
+ */
+void
+TransferSlots::handOver(bool bQueueChanged) {
+    while(!waiters.isEmpty() && ((maxSlots == 0) || (usedSlots < maxSlots))) {
+        Waiter waiter = waiters.takeFirst();
+        usedSlots++;
+        bQueueChanged = true;
+        FileServer* pServer = waiter.pServer;
+        QWebSocket* pClient = waiter.pClient;
+        QMetaObject::invokeMethod(pServer, [pServer, pClient]() {
+            pServer->onTransferSlotGranted(pClient);
+        }, Qt::QueuedConnection);
+    }
+    if(!bQueueChanged)
+        return;
+    QList<FileServer*> servers;
+    for(const Waiter& waiter : qAsConst(waiters)) {
+        if(!servers.contains(waiter.pServer))
+            servers.append(waiter.pServer);
+    }
+    for(FileServer* pServer : qAsConst(servers)) {
+        QMetaObject::invokeMethod(pServer, [pServer]() {
+            pServer->sendQueuePositions();
+        }, Qt::QueuedConnection);
+    }
+}
+
+
+int
+TransferSlots::inUse() const {
+    QMutexLocker locker(&mutex);
+    return usedSlots;
+}
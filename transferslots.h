@@ -0,0 +1,64 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef TRANSFERSLOTS_H
+#define TRANSFERSLOTS_H
+
+#include <QMutex>
+#include <QList>
+
+QT_FORWARD_DECLARE_CLASS(FileServer)
+QT_FORWARD_DECLARE_CLASS(QWebSocket)
+
+
+// The places for the clients transferring at the same time.
+// The File Servers hosted by the same MediaServer share them so that
+// the limit holds for the whole server and not for each namespace.
+// The clients waiting for a place are kept in a single queue, in order
+// of arrival whatever their namespace: a place left is given to the
+// first one and its File Server is told with a queued call.
+// It can be shared by several threads.
+class TransferSlots
+{
+public:
+    explicit TransferSlots(int maxSlots = 0);
+
+    void setLimit(int maxSlots);
+    int  limit() const;
+    bool tryAcquire(FileServer* pServer, QWebSocket* pClient);
+    void release(int nSlots = 1);
+    void cancel(FileServer* pServer, QWebSocket* pClient = nullptr);
+    int  position(FileServer* pServer, QWebSocket* pClient) const;
+    int  inUse() const;
+
+private:
+    struct Waiter {
+        FileServer* pServer;
+        QWebSocket* pClient;
+    };
+    void handOver(bool bQueueChanged);
+
+private:
+    mutable QMutex mutex;
+    int            maxSlots; // 0 means unlimited
+    int            usedSlots;
+    QList<Waiter>  waiters;  // FIFO
+};
+
+#endif // TRANSFERSLOTS_H
@@ -0,0 +1,244 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+
+#include "updatedeltabuilder.h"
+#include "binarydelta.h"
+#include "xxhash64.h"
+#include "utility.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSaveFile>
+#include <QtConcurrent>
+
+
+// A delta bigger than this share of the target is not worth it (%)
+#define DELTA_MAX_RATIO         90
+// The builds are held by a QByteArray (less than 2 GB)
+#define DELTA_MAX_BUILD_SIZE    (qint64(1) << 30)
+
+
+/*!
+ * \brief UpdateDeltaBuilder::UpdateDeltaBuilder
+ * Builds the binary deltas between the builds of the panel application
+ * (see binarydelta.h) so that a panel downloads only what changed since
+ * the build it runs. A delta is built once for each pair of builds, in
+ * background, and is kept on disk keyed by the content hashes of the two
+ * builds, so that it survives a restart and needs no invalidation.
+ * \param sCacheDir The directory where the deltas are stored
+ * \param _logFile The File for message logging (if any)
+ * \param parent
+ */
+UpdateDeltaBuilder::UpdateDeltaBuilder(const QString& sCacheDir, QFile* _logFile, QObject *parent)
+    : QObject(parent)
+    , sCacheDirName(sCacheDir)
+    , logFile(_logFile)
+    , bStopping(false)
+{
+    // The builds are big: one at a time
+    pool.setMaxThreadCount(1);
+}
+
+
+UpdateDeltaBuilder::~UpdateDeltaBuilder() {
+    bStopping = true;
+    pool.clear();
+    pool.waitForDone();
+}
+
+
+/*!
+ * \brief UpdateDeltaBuilder::delta
+ * \param baseHash The xxHash64 of the build the panel runs
+ * \param targetHash The xxHash64 of the build the panel needs
+ * \param pDelta Where to store the delta
+ * \return false if the delta has not been built yet
+ */
+bool
+UpdateDeltaBuilder::delta(quint64 baseHash, quint64 targetHash, UpdateDelta* pDelta) {
+    QString sKey = deltaKey(baseHash, targetHash);
+    auto it = deltas.constFind(sKey);
+    if(it != deltas.constEnd()) {
+        *pDelta = it.value();
+        return true;
+    }
+    // Built before a restart?
+    QFileInfo deltaInfo(deltaPath(baseHash, targetHash));
+    if(deltaInfo.exists() && (deltaInfo.size() > 0)) {
+        pDelta->sFilePath = deltaInfo.absoluteFilePath();
+        pDelta->size      = deltaInfo.size();
+        deltas.insert(sKey, *pDelta);
+        return true;
+    }
+    return false;
+}
+
+
+/*!
+ * \brief UpdateDeltaBuilder::request
+ * Queue the build of a delta (if not already queued).
+ * deltaReady() is emitted when it is done.
+ */
+void
+UpdateDeltaBuilder::request(const QString& sBasePath, quint64 baseHash,
+                            const QString& sTargetPath, quint64 targetHash) {
+    QString sKey = deltaKey(baseHash, targetHash);
+    if(building.contains(sKey))
+        return;
+    building.insert(sKey);
+    QString sDeltaPath = deltaPath(baseHash, targetHash);
+    QtConcurrent::run(&pool, [this, sBasePath, baseHash, sTargetPath, targetHash, sDeltaPath]() {
+        if(bStopping)
+            return;
+        UpdateDelta delta;
+        bool bSuccess = buildDelta(sBasePath, baseHash, sTargetPath, targetHash, sDeltaPath, &delta);
+        QMetaObject::invokeMethod(this, [=]() {
+            onDeltaBuilt(baseHash, targetHash, bSuccess, delta);
+        }, Qt::QueuedConnection);
+    });
+}
+
+
+/*!
+ * \brief UpdateDeltaBuilder::forgetBuild
+ * Drop the deltas from or to a build that is no longer served
+ * \param hash The xxHash64 of the build
+ */
+void
+UpdateDeltaBuilder::forgetBuild(quint64 hash) {
+    QString sHash = QString("%1").arg(hash, 16, 16, QChar('0'));
+    QDir cacheDir(sCacheDirName);
+    const QStringList deltaFiles = cacheDir.entryList(QStringList(QString("*.vcdelta")), QDir::Files);
+    for(const QString& sDeltaFile : deltaFiles) {
+        QString sKey = QFileInfo(sDeltaFile).completeBaseName();
+        if(!sKey.split(QChar('-')).contains(sHash))
+            continue;
+        deltas.remove(sKey);
+        cacheDir.remove(sDeltaFile);
+    }
+    for(auto it=deltas.begin(); it!=deltas.end(); ) {
+        if(it.key().split(QChar('-')).contains(sHash))
+            it = deltas.erase(it);
+        else
+            ++it;
+    }
+}
+
+
+/*!
+ * \brief UpdateDeltaBuilder::onDeltaBuilt
+ * Invoked in the object thread when a delta is done
+ */
+void
+UpdateDeltaBuilder::onDeltaBuilt(quint64 baseHash, quint64 targetHash, bool bSuccess, const UpdateDelta& delta) {
+    QString sKey = deltaKey(baseHash, targetHash);
+    building.remove(sKey);
+    if(bSuccess) {
+        deltas.insert(sKey, delta);
+#ifdef LOG_VERBOSE
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("Delta %1: %2 bytes")
+                   .arg(sKey)
+                   .arg(delta.sFilePath.isEmpty() ? qint64(-1) : delta.size));
+#endif
+    }
+    else {
+        // Not remembered: a build may have changed while being read
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("Unable to build the delta %1").arg(sKey));
+    }
+    emit deltaReady(baseHash, targetHash);
+}
+
+
+/*!
+ * \brief UpdateDeltaBuilder::buildDelta
+ * Runs in a pool thread: read the two builds and store their delta.
+ * The builds are read and not mapped: a build replaced in place while
+ * the delta is encoded would raise SIGBUS on a mapping. Their size is
+ * bounded by DELTA_MAX_BUILD_SIZE.
+ * The builds are checked against their hashes since they may have
+ * been replaced after the request and the delta is applied to the
+ * base before being published: a delta that does not rebuild the
+ * target is never sent to the panels.
+ * \return true on success (also when the delta is not worth it)
+ */
+bool
+UpdateDeltaBuilder::buildDelta(const QString& sBasePath, quint64 baseHash,
+                               const QString& sTargetPath, quint64 targetHash,
+                               const QString& sDeltaPath, UpdateDelta* pDelta) {
+    pDelta->sFilePath = QString();
+    pDelta->size      = 0;
+    QFile baseFile(sBasePath);
+    QFile targetFile(sTargetPath);
+    if(!baseFile.open(QIODevice::ReadOnly) || !targetFile.open(QIODevice::ReadOnly))
+        return false;
+    qint64 baseSize   = baseFile.size();
+    qint64 targetSize = targetFile.size();
+    if((baseSize <= 0) || (targetSize <= 0) ||
+       (baseSize > DELTA_MAX_BUILD_SIZE) || (targetSize > DELTA_MAX_BUILD_SIZE))
+        return false;
+    const QByteArray base   = baseFile.readAll();
+    const QByteArray target = targetFile.readAll();
+    baseFile.close();
+    targetFile.close();
+    if((base.size() != baseSize) || (target.size() != targetSize))
+        return false; // Changed while being read
+    if((XxHash64::hash(base.constData(), base.size()) != baseHash) ||
+       (XxHash64::hash(target.constData(), target.size()) != targetHash))
+        return false;
+
+    QByteArray delta = encodeBinaryDelta(base, target);
+    if(delta.size() > targetSize*DELTA_MAX_RATIO/100)
+        return true; // The whole build will be sent
+    QByteArray rebuilt;
+    if(!applyBinaryDelta(base, delta, &rebuilt) ||
+       (XxHash64::hash(rebuilt.constData(), rebuilt.size()) != targetHash))
+        return false;
+    rebuilt.clear();
+
+    QDir().mkpath(QFileInfo(sDeltaPath).absolutePath());
+    QSaveFile file(sDeltaPath);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(delta);
+    if(!file.commit())
+        return false;
+    pDelta->sFilePath = sDeltaPath;
+    pDelta->size      = delta.size();
+    return true;
+}
+
+
+QString
+UpdateDeltaBuilder::deltaPath(quint64 baseHash, quint64 targetHash) const {
+    return QString("%1/%2.vcdelta").arg(sCacheDirName, deltaKey(baseHash, targetHash));
+}
+
+
+QString
+UpdateDeltaBuilder::deltaKey(quint64 baseHash, quint64 targetHash) {
+    return QString("%1-%2")
+           .arg(baseHash,   16, 16, QChar('0'))
+           .arg(targetHash, 16, 16, QChar('0'));
+}
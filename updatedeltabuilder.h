@@ -0,0 +1,71 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef UPDATEDELTABUILDER_H
+#define UPDATEDELTABUILDER_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QThreadPool>
+#include <atomic>
+
+QT_FORWARD_DECLARE_CLASS(QFile)
+
+
+// The binary delta between two builds of the panel application
+struct UpdateDelta
+{
+    QString sFilePath; // Empty when the whole build is cheaper to send
+    qint64  size;
+};
+
+
+class UpdateDeltaBuilder : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UpdateDeltaBuilder(const QString& sCacheDir, QFile* _logFile = nullptr, QObject *parent = nullptr);
+    ~UpdateDeltaBuilder();
+    bool delta(quint64 baseHash, quint64 targetHash, UpdateDelta* pDelta);
+    void request(const QString& sBasePath, quint64 baseHash,
+                 const QString& sTargetPath, quint64 targetHash);
+    void forgetBuild(quint64 hash);
+
+signals:
+    void deltaReady(quint64 baseHash, quint64 targetHash);
+
+private:
+    void onDeltaBuilt(quint64 baseHash, quint64 targetHash, bool bSuccess, const UpdateDelta& delta);
+    static bool buildDelta(const QString& sBasePath, quint64 baseHash,
+                           const QString& sTargetPath, quint64 targetHash,
+                           const QString& sDeltaPath, UpdateDelta* pDelta);
+    QString deltaPath(quint64 baseHash, quint64 targetHash) const;
+    static QString deltaKey(quint64 baseHash, quint64 targetHash);
+
+private:
+    QString                     sCacheDirName;
+    QFile*                      logFile;
+    QThreadPool                 pool;
+    std::atomic<bool>           bStopping;
+    QHash<QString, UpdateDelta> deltas;   // Keyed by base and target hashes
+    QSet<QString>               building;
+};
+
+#endif // UPDATEDELTABUILDER_H
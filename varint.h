@@ -0,0 +1,55 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef VARINT_H
+#define VARINT_H
+
+#include <QByteArray>
+
+// Unsigned LEB128 integers: 7 bits per byte, least significant first,
+// the high bit set on all the bytes but the last.
+
+
+inline void
+appendVarint(QByteArray* pData, quint64 value) {
+    while(value >= 0x80) {
+        pData->append(char(quint8(value) | 0x80));
+        value >>= 7;
+    }
+    pData->append(char(value));
+}
+
+
+inline bool
+readVarint(const QByteArray& data, int* pPos, quint64* pValue) {
+    quint64 value = 0;
+    for(int shift=0; shift<64; shift+=7) {
+        if(*pPos >= data.size())
+            return false;
+        quint8 byte = quint8(data.at((*pPos)++));
+        value |= quint64(byte & 0x7F) << shift;
+        if(!(byte & 0x80)) {
+            *pValue = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif // VARINT_H
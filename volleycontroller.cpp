@@ -40,10 +40,48 @@ VolleyController::VolleyController()
 
     prepareDirectories();
     prepareServices();
-    pSlideUpdaterServer->setDir(sSlideDir, "*.jpg *.jpeg *.png *.JPG *.JPEG *.PNG");
-    emit startSlideServer();
-    pSpotUpdaterServer->setDir(sSpotDir, "*.mp4 *.MP4");
-    emit startSpotServer();
+    // The chunk cache and the reader threads are shared by all the media
+    pMediaServer->setChunkCacheSize(qint64(generalSetupArguments.iChunkCacheMB)*1024*1024);
+    pMediaServer->setReaderThreads(generalSetupArguments.iReaderThreads);
+    pMediaServer->setMaxTransfers(generalSetupArguments.iMaxTransfers);
+    pSlideUpdaterServer->setChunkBounds(qint64(generalSetupArguments.iMinChunkKB)*1024,
+                                        qint64(generalSetupArguments.iMaxChunkKB)*1024);
+    pSpotUpdaterServer->setChunkBounds(qint64(generalSetupArguments.iMinChunkKB)*1024,
+                                       qint64(generalSetupArguments.iMaxChunkKB)*1024);
+    pSlideUpdaterServer->setPrefetchDepth(generalSetupArguments.iPrefetchChunks);
+    pSpotUpdaterServer->setPrefetchDepth(generalSetupArguments.iPrefetchChunks);
+    pSlideUpdaterServer->setMaxOpenFiles(generalSetupArguments.iMaxOpenFiles);
+    pSpotUpdaterServer->setMaxOpenFiles(generalSetupArguments.iMaxOpenFiles);
+    pAppUpdaterServer->setChunkBounds(qint64(generalSetupArguments.iMinChunkKB)*1024,
+                                      qint64(generalSetupArguments.iMaxChunkKB)*1024);
+    pAppUpdaterServer->setPrefetchDepth(generalSetupArguments.iPrefetchChunks);
+    pAppUpdaterServer->setMaxOpenFiles(generalSetupArguments.iMaxOpenFiles);
+    pSlideUpdaterServer->setPeerRedirects(generalSetupArguments.iPeerRedirects);
+    pSpotUpdaterServer->setPeerRedirects(generalSetupArguments.iPeerRedirects);
+    pAppUpdaterServer->setPeerRedirects(generalSetupArguments.iPeerRedirects);
+    pSlideUpdaterServer->setPeerLoopback(generalSetupArguments.bPeerLoopback);
+    pSpotUpdaterServer->setPeerLoopback(generalSetupArguments.bPeerLoopback);
+    pAppUpdaterServer->setPeerLoopback(generalSetupArguments.bPeerLoopback);
+    pSlideUpdaterServer->setSlideScaling(generalSetupArguments.bScaleSlides);
+    pSlideUpdaterServer->setSlideBundle(generalSetupArguments.bSlideBundle);
+    setMediaRates(qint64(generalSetupArguments.iPlayRateKB)*1024,
+                  qint64(generalSetupArguments.iPlayClientRateKB)*1024);
+    if(generalSetupArguments.bHttpServer) {
+        pSlideUpdaterServer->setHttpPort(slideHttpPort);
+        pSpotUpdaterServer->setHttpPort(spotHttpPort);
+    }
+    if(generalSetupArguments.bMulticast) {
+        qint64 multicastRate = qint64(generalSetupArguments.iMulticastRateKB)*1024;
+        pSlideUpdaterServer->setMulticast(multicastGroup, slideMulticastPort, multicastRate);
+        pSpotUpdaterServer->setMulticast(multicastGroup, spotMulticastPort, multicastRate);
+    }
+    // The servers live in the Media Server thread: the directories
+    // (and their watchers) are set there.
+    emit setSlideDir(sSlideDir, "*.jpg *.jpeg *.png *.JPG *.JPEG *.PNG");
+    emit setSpotDir(sSpotDir, "*.mp4 *.MP4");
+    QDir().mkpath(generalSetupArguments.sUpdateDir); // To be watched even when empty
+    emit setUpdateDir(generalSetupArguments.sUpdateDir, "*.apk *.elf");
+    emit startMediaServer();
 
     buildControls();
     setWindowLayout();
@@ -59,6 +97,7 @@ VolleyController::VolleyController()
 void
 VolleyController::closeEvent(QCloseEvent *event) {
     SaveSettings();
+    closeMediaService();
     event->accept();
 }
 
@@ -114,6 +153,8 @@ VolleyController::GetGeneralSetup() {
                    QString("Found %1 spots")
                    .arg(spotList.count()));
 #endif
+        emit setSlideDir(sSlideDir, "*.jpg *.jpeg *.png *.JPG *.JPEG *.PNG");
+        emit setSpotDir(sSpotDir, "*.mp4 *.MP4");
         SaveSettings();
     }
 }
@@ -268,6 +309,23 @@ VolleyController::GetSettings() {
     generalSetupArguments.iTimeoutDuration = pSettings->value("volley/TimeoutDuration", 30).toInt();
     generalSetupArguments.sSlideDir        = pSettings->value("directories/slides", sSlideDir).toString();
     generalSetupArguments.sSpotDir         = pSettings->value("directories/spots",  sSpotDir).toString();
+    generalSetupArguments.sUpdateDir       = pSettings->value("directories/updates", generalSetupArguments.sUpdateDir).toString();
+    generalSetupArguments.iChunkCacheMB    = pSettings->value("fileserver/chunkCacheMB", 64).toInt();
+    generalSetupArguments.iReaderThreads   = pSettings->value("fileserver/readerThreads", 2).toInt();
+    generalSetupArguments.bScaleSlides     = pSettings->value("fileserver/scaleSlides", true).toBool();
+    generalSetupArguments.bSlideBundle     = pSettings->value("fileserver/slideBundle", true).toBool();
+    generalSetupArguments.bHttpServer      = pSettings->value("fileserver/httpServer", false).toBool();
+    generalSetupArguments.bMulticast       = pSettings->value("fileserver/multicast", false).toBool();
+    generalSetupArguments.iMulticastRateKB = pSettings->value("fileserver/multicastRateKB", 2048).toInt();
+    generalSetupArguments.iMinChunkKB      = pSettings->value("fileserver/minChunkKB", 16).toInt();
+    generalSetupArguments.iMaxChunkKB      = pSettings->value("fileserver/maxChunkKB", 4096).toInt();
+    generalSetupArguments.iPrefetchChunks  = pSettings->value("fileserver/prefetchChunks", 2).toInt();
+    generalSetupArguments.iMaxTransfers    = pSettings->value("fileserver/maxTransfers", 4).toInt();
+    generalSetupArguments.iMaxOpenFiles    = pSettings->value("fileserver/maxOpenFiles", 0).toInt();
+    generalSetupArguments.iPeerRedirects   = pSettings->value("fileserver/peerRedirects", 8).toInt();
+    generalSetupArguments.bPeerLoopback    = pSettings->value("fileserver/peerLoopback", false).toBool();
+    generalSetupArguments.iPlayRateKB      = pSettings->value("fileserver/playRateKB", 1024).toInt();
+    generalSetupArguments.iPlayClientRateKB= pSettings->value("fileserver/playClientRateKB", 512).toInt();
 
     sTeam[0]    = pSettings->value("team1/name", QString(tr("Locali"))).toString();
     sTeam[1]    = pSettings->value("team2/name", QString(tr("Ospiti"))).toString();
@@ -313,9 +371,26 @@ void
 VolleyController::SaveSettings() { // Save General Setup Values
     pSettings->setValue("directories/slides",     generalSetupArguments.sSlideDir);
     pSettings->setValue("directories/spots",      generalSetupArguments.sSpotDir);
+    pSettings->setValue("directories/updates",    generalSetupArguments.sUpdateDir);
     pSettings->setValue("volley/maxTimeout",      generalSetupArguments.maxTimeout);
     pSettings->setValue("volley/maxSet",          generalSetupArguments.maxSet);
     pSettings->setValue("volley/TimeoutDuration", generalSetupArguments.iTimeoutDuration);
+    pSettings->setValue("fileserver/chunkCacheMB", generalSetupArguments.iChunkCacheMB);
+    pSettings->setValue("fileserver/readerThreads", generalSetupArguments.iReaderThreads);
+    pSettings->setValue("fileserver/scaleSlides", generalSetupArguments.bScaleSlides);
+    pSettings->setValue("fileserver/slideBundle", generalSetupArguments.bSlideBundle);
+    pSettings->setValue("fileserver/httpServer", generalSetupArguments.bHttpServer);
+    pSettings->setValue("fileserver/multicast", generalSetupArguments.bMulticast);
+    pSettings->setValue("fileserver/multicastRateKB", generalSetupArguments.iMulticastRateKB);
+    pSettings->setValue("fileserver/minChunkKB", generalSetupArguments.iMinChunkKB);
+    pSettings->setValue("fileserver/maxChunkKB", generalSetupArguments.iMaxChunkKB);
+    pSettings->setValue("fileserver/prefetchChunks", generalSetupArguments.iPrefetchChunks);
+    pSettings->setValue("fileserver/maxTransfers", generalSetupArguments.iMaxTransfers);
+    pSettings->setValue("fileserver/maxOpenFiles", generalSetupArguments.iMaxOpenFiles);
+    pSettings->setValue("fileserver/peerRedirects", generalSetupArguments.iPeerRedirects);
+    pSettings->setValue("fileserver/peerLoopback", generalSetupArguments.bPeerLoopback);
+    pSettings->setValue("fileserver/playRateKB", generalSetupArguments.iPlayRateKB);
+    pSettings->setValue("fileserver/playClientRateKB", generalSetupArguments.iPlayClientRateKB);
 
 }
 
@@ -524,6 +599,8 @@ VolleyController::onTimeOutIncrement(int iTeam) {
     sMessage = QString("<startTimeout>%1</startTimeout>")
                .arg(generalSetupArguments.iTimeoutDuration);
     SendToAll(sMessage);
+    // The media can be transferred at full speed during the timeout
+    matchPaused(generalSetupArguments.iTimeoutDuration);
     QString sText;
     sText = QString("%1").arg(iTimeout[iTeam]);
     timeoutEdit[iTeam]->setText(sText);
@@ -545,6 +622,7 @@ VolleyController::onTimeOutDecrement(int iTeam) {
     SendToAll(sMessage);
     sMessage = QString("<stopTimeout>1</stopTimeout>");
     SendToAll(sMessage);
+    matchPlaying();
     QString sText;
     sText = QString("%1").arg(iTimeout[iTeam], 1);
     timeoutEdit[iTeam]->setText(sText);
@@ -621,6 +699,7 @@ VolleyController::onScoreIncrement(int iTeam) {
                .arg(iTeam, 1)
                .arg(iServizio, 1);
     SendToAll(sMessage);
+    matchPlaying();
     QString sText;
     sText = QString("%1").arg(iScore[iTeam], 2);
     scoreEdit[iTeam]->setText(sText);
@@ -646,6 +725,7 @@ VolleyController::onScoreDecrement(int iTeam) {
                .arg(iTeam, 1)
                .arg(iServizio, 1);
     SendToAll(sMessage);
+    matchPlaying();
     QString sText;
     sText = QString("%1").arg(iScore[iTeam], 2);
     scoreEdit[iTeam]->setText(sText);
@@ -789,6 +869,8 @@ VolleyController::onButtonNewSetClicked() {
     service[iServizio ? 0 : 1]->setChecked(false);
     SendToAll(FormatStatusMsg());
     SaveStatus();
+    // No limits on the media transfers until the first point of the set
+    matchPaused(0);
 }
 
 
@@ -827,5 +909,6 @@ VolleyController::onButtonNewGameClicked() {
     service[iServizio ? 0 : 1]->setChecked(false);
     SendToAll(FormatStatusMsg());
     SaveStatus();
+    matchPaused(0);
 }
 
@@ -0,0 +1,186 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#include "xxhash64.h"
+
+#include <cstring>
+
+
+static const quint64 PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const quint64 PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const quint64 PRIME64_3 = 0x165667B19E3779F9ULL;
+static const quint64 PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const quint64 PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+
+static inline quint64
+rotl64(quint64 x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+
+static inline quint64
+read64(const quint8* p) {
+    quint64 value = 0;
+    for(int i=7; i>=0; i--)
+        value = (value << 8) | p[i];
+    return value;
+}
+
+
+static inline quint32
+read32(const quint8* p) {
+    return quint32(p[0])        |
+           (quint32(p[1]) << 8)  |
+           (quint32(p[2]) << 16) |
+           (quint32(p[3]) << 24);
+}
+
+
+static inline quint64
+round64(quint64 acc, quint64 input) {
+    acc += input * PRIME64_2;
+    acc  = rotl64(acc, 31);
+    acc *= PRIME64_1;
+    return acc;
+}
+
+
+static inline quint64
+mergeRound64(quint64 acc, quint64 val) {
+    val  = round64(0, val);
+    acc ^= val;
+    acc  = acc * PRIME64_1 + PRIME64_4;
+    return acc;
+}
+
+
+XxHash64::XxHash64(quint64 seed) {
+    reset(seed);
+}
+
+
+void
+XxHash64::reset(quint64 seed) {
+    seedValue   = seed;
+    v[0]        = seed + PRIME64_1 + PRIME64_2;
+    v[1]        = seed + PRIME64_2;
+    v[2]        = seed;
+    v[3]        = seed - PRIME64_1;
+    totalLength = 0;
+    bufferSize  = 0;
+}
+
+
+/*!
+ * \brief XxHash64::update Add data to the hash
+ * \param pData The data
+ * \param length The number of bytes
+ */
+void
+XxHash64::update(const void* pData, qint64 length) {
+    if(!pData || length <= 0)
+        return;
+    auto* p = static_cast<const quint8*>(pData);
+    const quint8* const pEnd = p + length;
+    totalLength += quint64(length);
+
+    if(bufferSize + length < 32) {
+        memcpy(buffer + bufferSize, p, size_t(length));
+        bufferSize += int(length);
+        return;
+    }
+    if(bufferSize > 0) {
+        int fill = 32 - bufferSize;
+        memcpy(buffer + bufferSize, p, size_t(fill));
+        v[0] = round64(v[0], read64(buffer));
+        v[1] = round64(v[1], read64(buffer+8));
+        v[2] = round64(v[2], read64(buffer+16));
+        v[3] = round64(v[3], read64(buffer+24));
+        p += fill;
+        bufferSize = 0;
+    }
+    while(p + 32 <= pEnd) {
+        v[0] = round64(v[0], read64(p));
+        v[1] = round64(v[1], read64(p+8));
+        v[2] = round64(v[2], read64(p+16));
+        v[3] = round64(v[3], read64(p+24));
+        p += 32;
+    }
+    if(p < pEnd) {
+        bufferSize = int(pEnd - p);
+        memcpy(buffer, p, size_t(bufferSize));
+    }
+}
+
+
+/*!
+ * \brief XxHash64::digest
+ * \return The hash of all the data added so far
+ */
+quint64
+XxHash64::digest() const {
+    quint64 h64;
+    if(totalLength >= 32) {
+        h64 = rotl64(v[0], 1) + rotl64(v[1], 7) + rotl64(v[2], 12) + rotl64(v[3], 18);
+        h64 = mergeRound64(h64, v[0]);
+        h64 = mergeRound64(h64, v[1]);
+        h64 = mergeRound64(h64, v[2]);
+        h64 = mergeRound64(h64, v[3]);
+    }
+    else {
+        h64 = seedValue + PRIME64_5;
+    }
+    h64 += totalLength;
+
+    const quint8* p = buffer;
+    const quint8* const pEnd = buffer + bufferSize;
+    while(p + 8 <= pEnd) {
+        h64 ^= round64(0, read64(p));
+        h64  = rotl64(h64, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+    }
+    if(p + 4 <= pEnd) {
+        h64 ^= quint64(read32(p)) * PRIME64_1;
+        h64  = rotl64(h64, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    while(p < pEnd) {
+        h64 ^= quint64(*p) * PRIME64_5;
+        h64  = rotl64(h64, 11) * PRIME64_1;
+        p++;
+    }
+    h64 ^= h64 >> 33;
+    h64 *= PRIME64_2;
+    h64 ^= h64 >> 29;
+    h64 *= PRIME64_3;
+    h64 ^= h64 >> 32;
+    return h64;
+}
+
+
+/*!
+ * \brief XxHash64::hash One shot hash of a memory block
+ */
+quint64
+XxHash64::hash(const void* pData, qint64 length, quint64 seed) {
+    XxHash64 hasher(seed);
+    hasher.update(pData, length);
+    return hasher.digest();
+}
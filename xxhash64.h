@@ -0,0 +1,45 @@
+/*
+ *
+Copyright (C) 2026  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef XXHASH64_H
+#define XXHASH64_H
+
+#include <QtGlobal>
+
+// Streaming implementation of the xxHash64 algorithm
+// (https://github.com/Cyan4973/xxHash, XXH64 specification).
+class XxHash64
+{
+public:
+    explicit XxHash64(quint64 seed = 0);
+    void    reset(quint64 seed = 0);
+    void    update(const void* pData, qint64 length);
+    quint64 digest() const;
+
+    static quint64 hash(const void* pData, qint64 length, quint64 seed = 0);
+
+private:
+    quint64 v[4];
+    quint64 totalLength;
+    quint64 seedValue;
+    quint8  buffer[32];
+    int     bufferSize;
+};
+
+#endif // XXHASH64_H